@@ -15,7 +15,7 @@
 # You should have received a copy of the GNU General Public License along with
 # this program. If not, see <https://www.gnu.org/licenses/>.
 
-set(BHC_RUN_DATABASE "TL:C;EIGENRAYS:E;ARRIVALS:A")
+set(BHC_RUN_DATABASE "TL:C;TL_REAL:I;EIGENRAYS:E;ARRIVALS:A")
 set(BHC_INFL_DATABASE "CERVENY_RAYCEN:R;CERVENY_CART:C;GEOM_RAYCEN:g;GEOM_CART:G;SGB:S")
 set(BHC_SSP_DATABASE "N2LINEAR:N;CLINEAR:C;CUBIC:S;PCHIP:P;QUAD:Q;HEXAHEDRAL:H;ANALYTIC:A")
 
@@ -104,6 +104,13 @@ function(gen_templates_inner EXTENSION SOURCE_LIST_INNER_VAR)
                     "${CMAKE_SOURCE_DIR}/src/mode/fieldimpl.${EXTENSION}.in"
                     "${OUT_FILE}"
                 )
+                if(DIM_NAME STREQUAL "2D" AND CMAKE_COMPILER_IS_GNUCXX)
+                    # No FMA contraction: the packet tracer is also compiled for
+                    # instruction sets with FMA (see src/packet.hpp), and must
+                    # give the same results.
+                    set_source_files_properties("${OUT_FILE}"
+                        PROPERTIES COMPILE_OPTIONS "-ffp-contract=off")
+                endif()
                 list(APPEND SOURCE_LIST_INNER "${OUT_FILE}")
             endforeach()
         endforeach()
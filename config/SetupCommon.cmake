@@ -70,6 +70,8 @@ set(common_source
     mode/field.hpp
     mode/fieldimpl.hpp
     mode/modemodule.hpp
+    mode/raycache.cpp
+    mode/raycache.hpp
     mode/ray.cpp
     mode/ray.hpp
     mode/tl.cpp
@@ -82,6 +84,7 @@ set(common_source
     module/boundary.hpp
     module/freq0.hpp
     module/freqvec.hpp
+    module/hsrefl.hpp
     module/nmedia.hpp
     module/paramsmodule.hpp
     module/rayangles.hpp
@@ -101,6 +104,12 @@ set(common_source
     util/errors.hpp
     util/ldio.hpp
     util/prtfileemu.hpp
+    util/scheduler.cpp
+    util/scheduler.hpp
+    util/streamwriter.cpp
+    util/streamwriter.hpp
+    util/threadpool.cpp
+    util/threadpool.hpp
     util/timing.cpp
     util/timing.hpp
     util/unformattedio.hpp
@@ -113,6 +122,7 @@ set(common_source
     curves.hpp
     eigenrays.hpp
     influence.hpp
+    packet.hpp
     reflect.hpp
     runtype.hpp
     ssp.hpp
@@ -0,0 +1,199 @@
+/*
+bellhopcxx / bellhopcuda - C++/CUDA port of BELLHOP(3D) underwater acoustics simulator
+Copyright (C) 2021-2023 The Regents of the University of California
+Marine Physical Lab at Scripps Oceanography, c/o Jules Jaffe, jjaffe@ucsd.edu
+Based on BELLHOP / BELLHOP3D, which is Copyright (C) 1983-2022 Michael B. Porter
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Benchmark of the TL field accumulation modes (see bhc::FieldAccumulation).
+// Runs the given TL environment file several times in each mode, reports the
+// best run time, and checks whether the results are bit-identical between
+// repeated runs and against a single-threaded run in the same mode.
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// This define must be set before including the header if you're using the DLL
+// version on Windows, and it must NOT be set if you're using the static library
+// version on Windows. If you're not on Windows, it doesn't matter either way.
+#define BHC_DLL_IMPORT 1
+#include <bhc/bhc.hpp>
+
+void OutputCallback(const char *) {}
+
+void PrtCallback(const char *) {}
+
+static std::string FileRoot;
+static int32_t numThreads = -1;
+static int32_t numReps    = 3;
+
+template<bool O3D, bool R3D> bool RunOnce(
+    bhc::FieldAccumulation mode, int32_t threads, std::vector<bhc::cpxf> &field,
+    double &ms)
+{
+    bhc::bhcInit init;
+    init.FileRoot          = FileRoot.c_str();
+    init.numThreads        = threads;
+    init.fieldAccumulation = mode;
+    init.prtCallback       = PrtCallback;
+    init.outputCallback    = OutputCallback;
+    bhc::bhcParams<O3D> params;
+    bhc::bhcOutputs<O3D, R3D> outputs;
+    if(!bhc::setup<O3D, R3D>(init, params, outputs)) return false;
+    if(params.Beam->RunType[0] != 'C' && params.Beam->RunType[0] != 'S'
+       && params.Beam->RunType[0] != 'I') {
+        std::cout << "Environment file is not a TL run\n";
+        bhc::finalize<O3D, R3D>(params, outputs);
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    bool ok    = bhc::run<O3D, R3D>(params, outputs);
+    ms         = std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+             .count();
+    if(ok) {
+        const bhc::Position *Pos = params.Pos;
+        size_t n = (size_t)Pos->NSz * Pos->NSx * Pos->NSy * Pos->Ntheta
+            * Pos->NRz_per_range * Pos->NRr;
+        if(outputs.uAllSourcesReal != nullptr) {
+            // Incoherent / semi-coherent with realTLField: compare it as (p, 0)
+            field.resize(n);
+            for(size_t i = 0; i < n; ++i) {
+                field[i] = bhc::cpxf(outputs.uAllSourcesReal[i], 0.0f);
+            }
+        } else {
+            field.assign(outputs.uAllSources, outputs.uAllSources + n);
+        }
+    }
+    bhc::finalize<O3D, R3D>(params, outputs);
+    return ok;
+}
+
+static size_t NumDiffering(
+    const std::vector<bhc::cpxf> &a, const std::vector<bhc::cpxf> &b)
+{
+    if(a.size() != b.size()) return a.size() + b.size();
+    size_t n = 0;
+    for(size_t i = 0; i < a.size(); ++i) {
+        if(memcmp(&a[i], &b[i], sizeof(bhc::cpxf)) != 0) ++n;
+    }
+    return n;
+}
+
+template<bool O3D, bool R3D> int mainmain()
+{
+    const bhc::FieldAccumulation modes[4] = {
+        bhc::FieldAccumulation::Atomic, bhc::FieldAccumulation::Auto,
+        bhc::FieldAccumulation::Deterministic, bhc::FieldAccumulation::PerThread};
+    const char *names[4] = {"atomic", "auto", "deterministic", "perthread"};
+    std::vector<bhc::cpxf> reference, first, field;
+    double atomicMs = 0.0;
+    std::cout << std::left << std::setw(15) << "mode" << std::right << std::setw(12)
+              << "best ms" << std::setw(10) << "vs atomic" << std::setw(16)
+              << "diff repeats" << std::setw(16) << "diff 1 thread"
+              << "\n";
+    for(int32_t m = 0; m < 4; ++m) {
+        double ms, best = 1e30;
+        size_t diffRepeats = 0;
+        for(int32_t r = 0; r < numReps; ++r) {
+            if(!RunOnce<O3D, R3D>(modes[m], numThreads, r == 0 ? first : field, ms))
+                return 1;
+            if(r > 0) diffRepeats = std::max(diffRepeats, NumDiffering(first, field));
+            best = std::min(best, ms);
+        }
+        if(!RunOnce<O3D, R3D>(modes[m], 1, reference, ms)) return 1;
+        if(m == 0) atomicMs = best;
+        std::cout << std::left << std::setw(15) << names[m] << std::right
+                  << std::setw(12) << std::fixed << std::setprecision(2) << best
+                  << std::setw(9) << std::setprecision(3) << best / atomicMs << "x"
+                  << std::setw(16) << diffRepeats << std::setw(16)
+                  << NumDiffering(first, reference) << "\n";
+    }
+    std::cout << "(diff columns are the number of field values which are not "
+                 "bit-identical)\n";
+    return 0;
+}
+
+void showhelp(const char *argv0)
+{
+    std::cout
+        << "Usage: " << argv0
+        << " [options] FileRoot\n"
+           "Benchmarks the TL field accumulation modes on the given TL environment\n"
+           "file (path minus the .env extension).\n"
+           "\n"
+           "-?, -h, -help: Shows this help message\n"
+           "-2, -2D: Does a 2D run. The environment file must also be 2D\n"
+           "-3, -3D: Does a 3D run. The environment file must also be 3D\n"
+           "-4, -Nx2D, -2D3D, -2.5D: Does a Nx2D run. The environment file must also be "
+           "Nx2D\n"
+           "-threads=N: Number of worker threads. Default: all logical cores\n"
+           "-reps=N: Number of timed runs per mode. Default: 3\n";
+}
+
+int main(int argc, char **argv)
+{
+    int dimmode = 0;
+    for(int32_t i = 1; i < argc; ++i) {
+        std::string s = argv[i];
+        if(argv[i][0] == '-') {
+            if(s.length() >= 2 && argv[i][1] == '-') { // two dashes
+                s = s.substr(1);
+            }
+            if(s == "-2" || s == "-2D") {
+                dimmode = 2;
+            } else if(s == "-Nx2D" || s == "-2D3D" || s == "-2.5D" || s == "-4") {
+                dimmode = 4;
+            } else if(s == "-3" || s == "-3D") {
+                dimmode = 3;
+            } else if(s.rfind("-threads=", 0) == 0) {
+                numThreads = std::stoi(s.substr(9));
+            } else if(s.rfind("-reps=", 0) == 0) {
+                numReps = std::max(std::stoi(s.substr(6)), 2);
+            } else if(s == "-?" || s == "-h" || s == "-help") {
+                showhelp(argv[0]);
+                return 0;
+            } else {
+                std::cout << "Unknown command-line option \"-" << s << "\", try "
+                          << argv[0] << " --help\n";
+                return 1;
+            }
+        } else if(FileRoot.empty()) {
+            FileRoot = s;
+        } else {
+            std::cout << "Error, received another command-line argument \"" << s
+                      << "\", already have FileRoot = \"" << FileRoot << "\"\n";
+            return 1;
+        }
+    }
+    if(FileRoot.empty()) {
+        std::cout << "Must provide FileRoot as command-line parameter, try " << argv[0]
+                  << " --help\n";
+        return 1;
+    }
+    if(dimmode < 2 || dimmode > 4) {
+        std::cout << "No dimensionality specified (--2D, --Nx2D, --3D), assuming 2D\n";
+        dimmode = 2;
+    }
+    if(dimmode == 2) { return mainmain<false, false>(); }
+    if(dimmode == 3) { return mainmain<true, true>(); }
+    if(dimmode == 4) { return mainmain<true, false>(); }
+    return 1;
+}
@@ -68,6 +68,25 @@ extern template BHC_API bool setup<true, false>(
 extern template BHC_API bool setup<true, true>(
     const bhcInit &init, bhcParams<true> &params, bhcOutputs<true, true> &outputs);
 
+/**
+ * Create a pool of worker threads which several instances (params) can share,
+ * by passing it as bhcInit::threadPool to setup(). Normally each instance
+ * creates its own pool in setup() and destroys it in finalize(); in both cases,
+ * the threads are kept between runs.
+ *
+ * numThreads: number of threads, -1 means "all logical cores".
+ * pinThreads: bind each thread to one logical core (Linux and Windows only).
+ *
+ * returns: the pool, to be freed with destroy_thread_pool().
+ */
+BHC_API bhcThreadPool *create_thread_pool(int32_t numThreads, bool pinThreads);
+
+/**
+ * Stop the threads and free the pool. All instances using it must have been
+ * finalized already.
+ */
+BHC_API void destroy_thread_pool(bhcThreadPool *pool);
+
 /*
  * You can generally modify params as desired before run. There are two main
  * restrictions on this.
@@ -86,6 +105,13 @@ extern template BHC_API bool setup<true, true>(
  *    case, the data will be converted to meters (and the flag cleared) when
  *    run() or other API calls are made. So, you may have written the data
  *    originally in kilometers, but it may be in meters now.
+ * 3. Each of the structures Bdry, bdinfo->top / bot, refl->top / bot, ssp,
+ *    atten, Pos, Angles, freqinfo, Beam, and sbp has a dirty flag. With
+ *    bhcInit::preprocessDirtyOnly, runs after the first only validate and
+ *    preprocess the parts of params whose inputs are marked dirty (and the
+ *    print file lists which ones were redone), so then set the dirty flag of
+ *    each structure you modify before calling run(). The extsetup functions
+ *    below set the relevant flag.
  * Also, most arrays must be monotonically increasing along relevant axes (e.g.
  * bathymetry X and Y values must be monotonic but Z values can be arbitrary).
  */
@@ -171,11 +197,11 @@ extern template BHC_API void extsetup_sbp<false>(
     bhcParams<false> &params, int32_t NSBPPts);
 extern template BHC_API void extsetup_sbp<true>(bhcParams<true> &params, int32_t NSBPPts);
 /**
- * Reallocate the broadband frequency vector to the given size. FreqVec
- * (broadband mode) is not properly supported in BELLHOP(3D)--these values have
- * no impact on the physics model--but this feature cannot be removed from
- * bellhopcxx / bellhopcuda because the frequency vector is written to the
- * SHDFile.
+ * Reallocate the broadband frequency vector to the given size. With Nfreq > 1,
+ * TL runs trace each ray once and compute the field for every frequency in
+ * the vector (see bhcOutputs::uAllSources); boundary reflection and volume
+ * attenuation along the ray path are still evaluated at freq0. Other run
+ * types only use freq0. This is not supported in BELLHOP(3D).
  */
 template<bool O3D> void extsetup_freqvec(bhcParams<O3D> &params, int32_t Nfreq);
 extern template BHC_API void extsetup_freqvec<false>(
@@ -194,6 +220,9 @@ extern template BHC_API void extsetup_freqvec<true>(
  * 3D: Access the boundary array as params.bdinfo->top.bd[ix * NPts.y + iy].
  * The X and Y coordinates must be on a Cartesian grid and filled in into x.x
  * and x.y of each point (even though this duplicates the values many times).
+ * If bhcInit::compactBdry is set, bd is not allocated; instead fill in the
+ * coordinates in params.bdinfo->top.gridx[ix] and gridy[iy] and the depths in
+ * params.bdinfo->top.depth[ix * NPts.y + iy].
  *
  * This function sets params.bdinfo->top.dirty, but if you change the altimetry
  * data later (not immediately after calling this function), you'll need to set
@@ -309,6 +338,119 @@ extern template BHC_API bool run<true, false>(
 extern template BHC_API bool run<true, true>(
     bhcParams<true> &params, bhcOutputs<true, true> &outputs);
 
+/**
+ * Run many independent scenarios (e.g. Monte Carlo variants of an environment)
+ * concurrently on one pool of threads. Each scenario is run by one thread of
+ * the pool with one worker thread, as if numThreads were 1, so scenarios which
+ * are too small to keep all cores busy on their own are run side by side
+ * instead of one after the other.
+ *
+ * params, outputs: arrays of numScenarios instances, each already set up with
+ * setup(). Each is run as if run() had been called on it with numThreads = 1,
+ * so its results are the same as run()'s for an instance set up with one
+ * thread; with more threads and atomic or per-thread field accumulation, run()
+ * may order the contributions to the field differently and so differ in the
+ * last bits (see bhcInit::fieldAccumulation).
+ *
+ * pool: threads to run the scenarios on, or nullptr to use the pool of
+ * params[0]. See create_thread_pool(). The instances' own pools are not used.
+ *
+ * completed: if not null, called by the thread which ran the scenario as soon
+ * as it is finished (so, from multiple threads in parallel), with the scenario
+ * index, whether run() succeeded, and user.
+ *
+ * returns: false if any scenario failed, true if all succeeded.
+ */
+template<bool O3D, bool R3D> bool run_batch(
+    bhcParams<O3D> *params, bhcOutputs<O3D, R3D> *outputs, int32_t numScenarios,
+    bhcThreadPool *pool, void (*completed)(int32_t scenario, bool success, void *user),
+    void *user);
+
+/// 2D version, see template.
+extern template BHC_API bool run_batch<false, false>(
+    bhcParams<false> *params, bhcOutputs<false, false> *outputs, int32_t numScenarios,
+    bhcThreadPool *pool, void (*completed)(int32_t scenario, bool success, void *user),
+    void *user);
+/// Nx2D version, see template.
+extern template BHC_API bool run_batch<true, false>(
+    bhcParams<true> *params, bhcOutputs<true, false> *outputs, int32_t numScenarios,
+    bhcThreadPool *pool, void (*completed)(int32_t scenario, bool success, void *user),
+    void *user);
+/// 3D version, see template.
+extern template BHC_API bool run_batch<true, true>(
+    bhcParams<true> *params, bhcOutputs<true, true> *outputs, int32_t numScenarios,
+    bhcThreadPool *pool, void (*completed)(int32_t scenario, bool success, void *user),
+    void *user);
+
+/**
+ * Run many variants of one environment concurrently, where each variant is
+ * produced by a callback which modifies the params. Each thread of the pool
+ * sets up one instance from init (only when it first gets a scenario) and
+ * reuses it for all the scenarios it runs, so the environment files are only
+ * read once per thread and any data the callback does not change (e.g. the
+ * bathymetry) is shared by all the scenarios run on that thread.
+ *
+ * init: as for setup(). numThreads and threadPool are ignored. maxMemory
+ * applies to each thread's instance. prtCallback should be set, as otherwise
+ * all the instances would write to the same PRTFile.
+ *
+ * pool: threads to run the scenarios on, or nullptr to create a temporary
+ * pool with init.numThreads and init.pinThreads.
+ *
+ * perturb: called before each scenario is run, with the scenario index, the
+ * thread's params, and user. The params still hold whatever the previous
+ * scenario on this thread set, so the callback must set every value it
+ * changes in any scenario (not modify them relative to the current state).
+ * Follow the rules above about modifying params, e.g. reallocate with the
+ * extsetup functions and set dirty flags. Return false to skip the scenario
+ * (counts as failed).
+ *
+ * completed: called after each scenario has been run, with the scenario index,
+ * whether it succeeded, the params and outputs, and user. If the scenario
+ * failed, including when perturb returned false and the scenario was not run,
+ * the outputs are not valid: they may still hold the results of the previous
+ * scenario on this thread, or be partially written. Otherwise, this is the only
+ * time the outputs of the scenario are available (e.g. call writeout() here
+ * with a per-scenario FileRoot, or copy the results); they are overwritten by
+ * the next scenario on the same thread. Called from multiple threads in
+ * parallel.
+ *
+ * returns: false if any scenario failed or could not be run, true if all
+ * succeeded.
+ */
+template<bool O3D, bool R3D> bool run_batch(
+    const bhcInit &init, int32_t numScenarios, bhcThreadPool *pool,
+    bool (*perturb)(int32_t scenario, bhcParams<O3D> &params, void *user),
+    void (*completed)(
+        int32_t scenario, bool success, bhcParams<O3D> &params,
+        bhcOutputs<O3D, R3D> &outputs, void *user),
+    void *user);
+
+/// 2D version, see template.
+extern template BHC_API bool run_batch<false, false>(
+    const bhcInit &init, int32_t numScenarios, bhcThreadPool *pool,
+    bool (*perturb)(int32_t scenario, bhcParams<false> &params, void *user),
+    void (*completed)(
+        int32_t scenario, bool success, bhcParams<false> &params,
+        bhcOutputs<false, false> &outputs, void *user),
+    void *user);
+/// Nx2D version, see template.
+extern template BHC_API bool run_batch<true, false>(
+    const bhcInit &init, int32_t numScenarios, bhcThreadPool *pool,
+    bool (*perturb)(int32_t scenario, bhcParams<true> &params, void *user),
+    void (*completed)(
+        int32_t scenario, bool success, bhcParams<true> &params,
+        bhcOutputs<true, false> &outputs, void *user),
+    void *user);
+/// 3D version, see template.
+extern template BHC_API bool run_batch<true, true>(
+    const bhcInit &init, int32_t numScenarios, bhcThreadPool *pool,
+    bool (*perturb)(int32_t scenario, bhcParams<true> &params, void *user),
+    void (*completed)(
+        int32_t scenario, bool success, bhcParams<true> &params,
+        bhcOutputs<true, true> &outputs, void *user),
+    void *user);
+
 /**
  * Write results for the past run to BELLHOP-formatted files, i.e. a ray file,
  * a shade file, or an arrivals file. If you only want to use the results in
@@ -336,6 +478,34 @@ extern template BHC_API bool writeout<true, true>(
     const bhcParams<true> &params, const bhcOutputs<true, true> &outputs,
     const char *FileRoot);
 
+/**
+ * Write the metrics of the past run (bhcOutputs::metrics, see RunMetrics) to
+ * FileRoot.metrics.json, as one JSON object with a key for each member of
+ * RunMetrics, plus "program", "dim", and "runType". "threads" is an array of
+ * objects with the members of ThreadMetrics.
+ *
+ * You can pass nullptr for FileRoot to use the same FileRoot that the
+ * environment file was originally loaded from.
+ *
+ * returns: false if an error occurred, true if no errors.
+ */
+template<bool O3D, bool R3D> bool writemetrics(
+    const bhcParams<O3D> &params, const bhcOutputs<O3D, R3D> &outputs,
+    const char *FileRoot);
+
+/// 2D version, see template.
+extern template BHC_API bool writemetrics<false, false>(
+    const bhcParams<false> &params, const bhcOutputs<false, false> &outputs,
+    const char *FileRoot);
+/// Nx2D version, see template.
+extern template BHC_API bool writemetrics<true, false>(
+    const bhcParams<true> &params, const bhcOutputs<true, false> &outputs,
+    const char *FileRoot);
+/// 3D version, see template.
+extern template BHC_API bool writemetrics<true, true>(
+    const bhcParams<true> &params, const bhcOutputs<true, true> &outputs,
+    const char *FileRoot);
+
 /**
  * Read saved results from a past run (a ray file, TL / shade file, or arrivals
  * file) to memory (the outputs struct). params should have already been
@@ -116,6 +116,9 @@ struct HSInfo {
     real rho, Depth;                   // density, depth
     char bc;                           // Boundary condition type
     char Opt[6];
+    // LP: Index of this halfspace's table in ReflectionInfo::hs, or -1 if its
+    // reflection coefficient is computed exactly (see bhcInit::hsReflTableRes).
+    int32_t iTable;
 };
 
 struct HSExtra {
@@ -135,6 +138,7 @@ struct BdryPtSmall {
  */
 struct BdryType {
     BdryPtSmall Top, Bot;
+    bool dirty; // Set to indicate that modules using these values must be rerun
 };
 
 template<bool O3D> struct ReflCurvature {};
@@ -175,6 +179,12 @@ template<bool O3D> struct BdryInfoTopBot {
     bool dirty;          // Set to indicate that derived values need updating
     bool rangeInKm;      // R, X, Y values in km; automatically converted to meters
     BdryPtFull<O3D> *bd; // 2D: 1D array / 3D: 2D array
+    // LP: Nx2D/3D compact boundary (see bhcInit::compactBdry): bd is nullptr, and
+    // only the grid coordinates gridx[ix], gridy[iy] and the depths
+    // depth[ix * NPts.y + iy] are stored. The normals and curvatures are computed
+    // from these where they are needed. Unused in 2D.
+    real *gridx, *gridy;
+    float *depth;
 };
 /**
  * LP: There are three boundary structures. This one represents static/global
@@ -244,10 +254,27 @@ struct ReflectionCoef {
 struct ReflectionInfoTopBot {
     int32_t NPts;
     bool inDegrees; // Angles in degrees, converted to radians at preprocess
+    bool dirty;     // Set to indicate that derived values need updating
     ReflectionCoef *r;
 };
+/**
+ * LP: Tabulated factors of the acousto-elastic halfspace ('A' / 'G')
+ * reflection coefficient, see bhcInit::hsReflTableRes and HalfspaceFactors.
+ * There is one table of NPts points for each distinct halfspace (top, bottom,
+ * and the segments of range-dependent bottoms), stored one after the other.
+ * The abscissa is u = cRef * |Tg|, where Tg is the ray slowness along the
+ * boundary and cRef is the minimum sound speed of the SSP, sampled from u = 0
+ * in steps of du.
+ */
+struct HSReflTable {
+    int32_t NTables, NPts;
+    real cRef, du;
+    cpx *f, *g;
+};
+
 struct ReflectionInfo {
     ReflectionInfoTopBot bot, top;
+    HSReflTable hs;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -266,6 +293,7 @@ struct AttenInfo {
     real t, Salinity, pH, z_bar, fg; // Francois-Garrison volume attenuation; temperature,
                                      // salinity, ...
     int32_t NMedia;
+    bool dirty; // Set to indicate that modules using these values must be rerun
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -280,6 +308,7 @@ struct Position {
     /// while reading the environment file. If manually setting theta, set this
     /// to false and do not include any duplicate angles.
     bool thetaDuplRemoved;
+    bool dirty; // Set to indicate that derived values need updating
     real Delta_r, Delta_theta;
     // int32_t *iSz, *iRz; // LP: Not used.
     // LP: These are really floats, not reals.
@@ -288,6 +317,22 @@ struct Position {
     // float *ws, *wr; // weights for interpolation LP: Not used.
     float *theta; // Receiver bearings
     vec2 *t_rcvr; // Receiver directions (cos(theta), sin(theta))
+    /// LP: Angular index of the bearings for the 3D geometric Cartesian
+    /// influence function, set in preprocessing: thetaIndex[k] is the first
+    /// itheta whose bearing, measured counterclockwise from theta[0], is at
+    /// least k * 2 pi / NthetaIndex (thetaIndex[NthetaIndex] == Ntheta).
+    /// NthetaIndex is 0 if the bearings are not increasing within one turn, in
+    /// which case it tests every bearing. Only hat beams are pruned to the
+    /// beam's footprint; Gaussian beams are pruned to the half of the bearings
+    /// on the ray's side of the source, and the ray-centered influence
+    /// functions do not use the index.
+    int32_t NthetaIndex;
+    int32_t *thetaIndex;
+    /// LP: Whether Rz[0 .. NRz_per_range - 1] is nondecreasing, set in
+    /// preprocessing. If so, the influence functions find the receiver depths
+    /// within a beam's depth window by binary search; otherwise they test
+    /// every depth.
+    bool RzSorted;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -304,6 +349,7 @@ struct AngleInfo {
 struct AnglesStructure {
     AngleInfo alpha; // LP: elevation angles
     AngleInfo beta;  // LP: azimuth angles
+    bool dirty;      // Set to indicate that derived values need updating
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -314,6 +360,7 @@ struct FreqInfo {
     real freq0;    // Nominal or carrier frequency
     int32_t Nfreq; // number of frequencies
     real *freqVec; // frequency vector for broadband runs
+    bool dirty;    // Set to indicate that modules using these values must be rerun
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -332,6 +379,7 @@ template<bool O3D> struct BeamStructure {
     char RunType[7];
     bool rangeInKm;  // Box R, X, Y specified in km, converted to meters in preprocess
     bool autoDeltas; // stores whether deltas was automatically computed, for echo
+    bool dirty;      // Set to indicate that derived values need updating
     real deltas, epsMultiplier, rLoop;
     VEC23<O3D> Box;
 };
@@ -344,6 +392,7 @@ struct SBPInfo {
     bool SBPIndB; // SrcBmPat values in dB, auto converted to linear in preprocess
     int32_t NSBPPts;
     real *SrcBmPat;
+    bool dirty; // Set to indicate that derived values need updating
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -375,14 +424,50 @@ struct Arrival {
     cpxf delay;
 };
 
+/**
+ * LP: Information kept with each arrival in multithreaded or packet-traced
+ * runs, where arrivals are merged after the run (see ArrInfo::AllowMerging).
+ */
+struct ArrivalMergeInfo {
+    /// Full-precision delay and phase, as compared in IsSecondStepOfPair
+    cpx delay;
+    real Phase;
+    /// Position of the ray within the rays for its source, in tracing order
+    int32_t ray;
+};
+
 /**
  * LP: Arrival setup and results.
  */
 struct ArrInfo {
+    /// After the run, the arrivals grouped by receiver: the NArr[i] arrivals at
+    /// receiver i (field address, see GetFieldAddr) are Arr[ArrOffset[i]] onward.
+    /// During the run, this is a pool which arrivals for any receiver are taken
+    /// from, so there is no fixed limit on the number of arrivals per receiver.
     Arrival *Arr;
     int32_t *NArr;
+    size_t *ArrOffset;
+    /// During the run only: for each receiver, the index in Arr of the most
+    /// recently added arrival (-1 if none), and for each entry of Arr, the index
+    /// of the previous arrival at the same receiver (-1 if none).
+    int32_t *ArrLast;
+    int32_t *ArrPrev;
+    /// During the run only: [0] number of entries of Arr used, [1] number of
+    /// arrivals dropped (or, with AllowMerging, replaced by a stronger one)
+    /// because Arr was full.
+    int32_t *PoolCounters;
+    /// During the run only, if !AllowMerging: ArrivalMergeInfo for each entry of Arr
+    ArrivalMergeInfo *ArrMerge;
     int32_t *MaxNPerSource;
+    /// Number of entries allocated in Arr
+    int32_t ArrCapacity;
+    /// Maximum number of arrivals at any receiver (set after the run)
     int32_t MaxNArr;
+    /// Number of declination angles, for ordering rays (see ArrivalMergeInfo)
+    int32_t Nalpha;
+    /// If true, AddArr merges the two steps of a pair as it goes (single
+    /// thread, one ray at a time). Otherwise, this is done after the run in PostProcessArrivals,
+    /// in the same order, so the results are the same.
     bool AllowMerging;
 };
 
@@ -428,9 +513,16 @@ template<> struct StepPartials<true> {
 };
 
 template<bool O3D, bool R3D> struct RayResult {
+    /// Full ray points, or nullptr in compact mode (or if the ray is missing).
     rayPt<R3D> *ray;
+    /// Compact mode (bhcInit::compactRays) only: ray coordinates in
+    /// structure-of-arrays layout, i.e. coordinate k (r/z in 2D, x/y/z in 3D,
+    /// as in rayPt::x) of step is is compactX[k * Nsteps + is].
+    float *compactX;
+    /// Compact mode only: bounce counts at the end of the ray.
+    int32_t NumTopBnc, NumBotBnc;
     Origin<O3D, R3D> org;
-    real SrcDeclAngle;
+    real SrcDeclAngle, SrcAzimAngle; // LP: degrees; azimuth is NAN in 2D
     int32_t Nsteps;
 };
 
@@ -443,8 +535,58 @@ template<bool O3D, bool R3D> struct RayInfo {
     int32_t MaxPointsPerRay;
     int32_t NRays;
     bool isCopyMode;
+    bool isCompact;
+    bool isStreamed;
 };
 
+/**
+ * Binary ray file (FileRoot.rayb, see bhcInit::binaryRayFile). Everything is
+ * in the native byte order of the machine which wrote the file, and aligned,
+ * so the file can be memory-mapped and any ray read in place without looking
+ * at the others. The file consists of:
+ *
+ * - RayFileHeader
+ * - The source and launch angle grid, as float: Sx[NSx], Sy[NSy], Sz[NSz] (m),
+ *   alpha[Nalpha], beta[Nbeta] (degrees), padded with a zero to an even count
+ * - The index, RayFileEntry[NRays], at RayFileHeader::indexOffset
+ * - The ray points, as float: for each ray, Nsteps points of dim coordinates,
+ *   (r,z) in 2D or (x,y,z) in Nx2D/3D, the same as in the text ray file
+ */
+struct RayFileHeader {
+    /// RayFileMagic
+    char magic[8];
+    /// RayFileVersion
+    int32_t version;
+    /// Number of coordinates per ray point, 2 or 3
+    int32_t dim;
+    char title[80];
+    double freq0;
+    double TopDepth, BotDepth;
+    int32_t NSx, NSy, NSz, Nalpha, Nbeta;
+    /// Number of rays in the index
+    int32_t NRays;
+    /// Byte offset of the index from the start of the file
+    uint64_t indexOffset;
+    /// Total number of points in all rays
+    uint64_t totalPoints;
+};
+static_assert(sizeof(RayFileHeader) == 160, "RayFileHeader must have no padding");
+
+struct RayFileEntry {
+    /// Byte offset of the first point of this ray from the start of the file
+    uint64_t offset;
+    int32_t Nsteps;
+    /// Number of surface and bottom bounces at the end of the ray
+    int32_t NumTopBnc, NumBotBnc;
+    /// Launch angles in degrees; azimuth is NAN in 2D
+    float SrcDeclAngle, SrcAzimAngle;
+    int32_t reserved;
+};
+static_assert(sizeof(RayFileEntry) == 32, "RayFileEntry must have no padding");
+
+constexpr const char RayFileMagic[8] = "BHCRAYB";
+constexpr int32_t RayFileVersion     = 1;
+
 struct RayInitInfo {
     int32_t isx, isy, isz, ialpha, ibeta;
     real alpha, beta;
@@ -468,6 +610,11 @@ template<bool R3D> struct InfluenceRayInfo {
     int32_t iBeamWindow2;
     real Ratio1; // scale factor (point source vs. line source)
     real rcp_q0, rcp_qhat0;
+    // LP: Whether the field being written to is a thread-private tile, in which
+    // case no atomics are needed, and whether the contributions are evaluated
+    // in float (Precision::Mixed). Set by MainFieldModes, not Init_Influence.
+    bool privateField;
+    bool mixedPrecision;
     // LP: Variables carried over between iterations.
     real phase;
     real qOld;               // LP: Det_QOld in 3D
@@ -477,15 +624,125 @@ template<bool R3D> struct InfluenceRayInfo {
     bool lastValid;
     int32_t kmah;
     int32_t ir;
+    // LP: Work counters for RunMetrics: calls to Step_Influence, and
+    // contributions added to the field / eigenrays / arrivals.
+    int32_t numEvals;
+    int64_t numHits;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Metrics
+////////////////////////////////////////////////////////////////////////////////
+
+struct ThreadMetrics {
+    /// Number of jobs (rays, or field tiles) this thread ran.
+    int32_t jobs;
+    /// Time (ms) this thread spent running jobs, and waiting for the other
+    /// threads to finish after it ran out of jobs.
+    double busyTime, idleTime;
+};
+
+/**
+ * Machine-readable statistics about the last run, for tracking performance;
+ * see bhcOutputs::metrics and bhc::writemetrics(). All times are wall clock
+ * times in ms. The work counters are only collected for rays traced on the
+ * CPU, and are zero in CUDA mode.
+ */
+struct RunMetrics {
+    /// Times of the last setup(), the three phases of the last run(), and the
+    /// last writeout().
+    double setupTime, preprocessTime, runTime, postprocessTime, writeoutTime;
+    /// Number of rays traced, including eigenrays traced again for the ray
+    /// file. Rays replayed from the ray cache (bhcInit::cacheRays) are not
+    /// traced, but their influence evaluations and receiver hits are counted.
+    int64_t rays;
+    /// Number of ray steps.
+    int64_t steps;
+    /// Number of surface and bottom reflections.
+    int64_t reflections;
+    /// Number of steps which had to be increased to the minimum step size (the
+    /// small step counter); many of these in a row terminate a 3D/Nx2D ray.
+    int64_t smallSteps;
+    /// Number of ray steps evaluated by the influence function (once per
+    /// frequency for broadband TL).
+    int64_t influenceEvals;
+    /// Number of contributions of a ray step to a receiver: additions to the
+    /// TL field, eigenray hits, or arrivals.
+    int64_t receiverHits;
+    /// Maximum memory in use since setup(), in bytes, as counted against
+    /// bhcInit::maxMemory.
+    uint64_t peakMemory;
+    /// Jobs and busy and idle times of each worker thread, summed over the
+    /// parallel parts of the run (tracing, and for eigenray runs, tracing the
+    /// eigenrays again). Zero for work done on the GPU.
+    int32_t numThreads;
+    ThreadMetrics *threads;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 // Meta-structures
 ////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * How contributions from different rays are summed into the TL field on the
+ * CPU. Floating-point addition is not associative, so if the order of these
+ * additions depends on how the threads happen to be scheduled, the results
+ * may differ in the last bits from run to run.
+ */
+enum class FieldAccumulation {
+    /// Sum contributions in a fixed ray order like Deterministic, but with
+    /// fewer tiles if not all bhcInit::deterministicTiles fit in half of the
+    /// free memory, instead of failing. The results are the same for any
+    /// number of threads, but may depend on maxMemory for very large fields.
+    Auto,
+    /// Always atomically add into one shared field. Uses the least memory, but
+    /// the results depend on thread scheduling.
+    Atomic,
+    /// Always sum contributions in a fixed ray order, so that the results are
+    /// bit-identical for any number of threads and across repeated runs (for
+    /// the same inputs and bhcInit::deterministicTiles). If there are fewer
+    /// tiles than threads, only that many threads can work in parallel.
+    Deterministic,
+    /// Give each thread a private field tile for the run, with the rays
+    /// scheduled dynamically as usual, if there is memory for one per thread;
+    /// otherwise atomic adds. Balances the load best, but the results depend
+    /// on thread scheduling.
+    PerThread,
+};
+
+/**
+ * Precision of the arithmetic in TL runs. real is double unless the library was
+ * built with BHC_USE_FLOATS, in which case everything is float regardless of
+ * this setting.
+ */
+enum class Precision {
+    /// All of the computation is done in real.
+    Full,
+    /// The rays are traced (step, reflection, beam state along the ray) in
+    /// real, but the contribution of each ray to each receiver is evaluated
+    /// in float: the phase factor (after the phase is reduced to one cycle in
+    /// real) and the Gaussian beam weight. The field is stored in float in
+    /// both modes. TL typically differs from Full by a few times 1e-7
+    /// relative. No effect on eigenray or arrivals runs.
+    Mixed,
+};
+
+/// Pool of worker threads; see bhc::create_thread_pool().
+struct bhcThreadPool;
+
 struct bhcInit {
-    /// Number of worker threads to run. -1 means "all logical cores".
+    /// Number of worker threads to run. -1 means "all logical cores". Ignored
+    /// if threadPool is set.
     int32_t numThreads = -1;
+    /// Bind each worker thread to one logical core (Linux and Windows only).
+    /// Ignored if threadPool is set.
+    bool pinThreads = false;
+    /// If not null, this instance uses this pool of worker threads instead of
+    /// creating its own. This way several instances in the same process can
+    /// share one set of threads; runs of different instances then take turns
+    /// using it. The pool must be destroyed after all instances using it have
+    /// been finalized. See bhc::create_thread_pool().
+    bhcThreadPool *threadPool = nullptr;
     /// Maximum amount of memory (in bytes) this instance should use.
     size_t maxMemory = 4ull * 1024ull * 1024ull * 1024ull; // 4 GiB
     /// If there is not enough memory to hold the requested number of rays
@@ -494,6 +751,115 @@ struct bhcInit {
     /// more ray data in memory but is slower. This only affects ray and
     /// eigenray runs (no effect on TL or arrivals).
     bool useRayCopyMode = false;
+    /// Store ray and eigenray results compactly: only the ray coordinates (as
+    /// float) and the bounce counts at the end of the ray, which is all that is
+    /// written to the ray file. This fits about an order of magnitude more ray
+    /// points in maxMemory than full storage, and memory is allocated as rays
+    /// are produced rather than reserving the maximum length for every ray. See
+    /// RayResult. When set, useRayCopyMode has no effect.
+    bool compactRays = false;
+    /// TL (single frequency), eigenray, and arrivals runs: keep the paths of
+    /// the rays traced by a run in memory, and if the next run differs only
+    /// in the receivers (Pos->Rr, Rz, theta, and their counts), apply the
+    /// stored rays to the new receivers instead of tracing them again. The
+    /// results are the same as from tracing. Whether anything else changed is
+    /// detected by comparing all the other inputs after preprocessing. The
+    /// rays use at most half of the memory which is free when the run starts;
+    /// rays which do not fit are traced again. Not supported with Cerveny
+    /// beams or in CUDA mode.
+    bool cacheRays = false;
+    /// After the first run(), only validate and preprocess the parts of params
+    /// whose inputs are marked dirty (see the notes on modifying params in
+    /// bhc.hpp), and list the ones which were redone in the print file. This
+    /// saves time when only some of the inputs change between runs, but the
+    /// dirty flag of each structure modified must be set correctly. If false,
+    /// every run() validates and preprocesses everything.
+    bool preprocessDirtyOnly = false;
+    /// Ray runs only (not eigenrays): write the ray file while the rays are
+    /// being traced, instead of storing all the rays and writing them in
+    /// bhc::writeout(). The rays are formatted by the worker threads and
+    /// written in order by a separate writer thread, and only a bounded number
+    /// of finished rays is held in memory. The ray file is written to
+    /// FileRoot.ray during bhc::run(), so FileRoot must be set; the ray results
+    /// in bhcOutputs are left empty and bhc::writeout() does nothing. When set,
+    /// useRayCopyMode and compactRays have no effect on ray runs.
+    bool streamRays = false;
+    /// Write (bhc::writeout()) and read (bhc::readout()) the ray file for ray
+    /// and eigenray runs in a binary format with an index, FileRoot.rayb,
+    /// instead of the text FileRoot.ray. This is much faster to write and
+    /// read, and individual rays can be read directly. Coordinates are
+    /// stored as float. See RayFileHeader. streamRays has no effect when this
+    /// is set.
+    bool binaryRayFile = false;
+    /// TL runs: write the shade file while the run is going on, instead of
+    /// storing the field of all the sources and writing it in bhc::writeout().
+    /// The sources are processed in tiles (boxes of source x, y, and depth
+    /// positions) which fit in a quarter of the memory free at the start of
+    /// the run, and each tile is written to its records of FileRoot.shd by a
+    /// separate thread while the next tile is traced. Peak memory is therefore
+    /// independent of the number of sources. FileRoot must be set, the TL
+    /// fields in bhcOutputs are left empty, and bhc::writeout() does nothing
+    /// for TL. Results may differ in the last bits from a run without
+    /// streaming, as ray packets and field tiles do not span tiles of sources.
+    /// Not used with cacheRays.
+    bool streamTL = false;
+    /// TL runs: also compute the transmission loss in dB, -20 log10 |p|, as
+    /// float during postprocessing (bhcOutputs::tlDB), and write it to
+    /// FileRoot.tl in bhc::writeout(). FileRoot.tl has the same header and
+    /// records as FileRoot.shd, but each record holds NRr floats of TL instead
+    /// of NRr complex pressures. As in plotshd.m, |p| is clamped to at least
+    /// 1e-37 (740 dB). Not supported with streamTL.
+    bool tlDB = false;
+    /// With tlDB, also store the phase of the pressure in radians
+    /// (bhcOutputs::tlPhase), in the second NRr floats of each record of
+    /// FileRoot.tl.
+    bool tlPhase = false;
+    /// How the TL field is accumulated on the CPU; see FieldAccumulation. No
+    /// effect in CUDA mode or for runs other than TL.
+    FieldAccumulation fieldAccumulation = FieldAccumulation::Auto;
+    /// Number of field tiles for FieldAccumulation::Deterministic and Auto
+    /// (fewer if there are fewer rays). Each tile gets every numTiles'th ray,
+    /// so the results depend on this number, but not on the number of threads.
+    /// If there is not enough memory for the tiles, Deterministic fails in
+    /// setup or run and Auto uses fewer tiles. At most this many threads trace
+    /// rays at once. Every tile costs clearing and reducing a full copy of the
+    /// field, which with 256 tiles was slower than atomics.
+    int32_t deterministicTiles = 64;
+    /// 2D TL (single frequency), eigenray, and arrivals runs with a 1D SSP
+    /// (N2-linear, C-linear, cubic spline, or PCHIP) on the CPU: trace several
+    /// rays together, taking each step of all of them at once with the CPU's
+    /// vector (SIMD) instructions. Each ray follows exactly the same path as
+    /// when traced alone, but the contributions of the rays reach the results
+    /// in a different order, so TL may differ in the last bits and eigenrays
+    /// may be listed in a different order. Not used with cacheRays while rays
+    /// are stored or replayed.
+    bool rayPackets = false;
+    /// Precision of TL runs; see Precision.
+    Precision precision = Precision::Full;
+    /// Incoherent and semi-coherent TL runs (RunType 'I' and 'S') only ever sum
+    /// real intensities. If true, they store their field as float in
+    /// bhcOutputs::uAllSourcesReal instead of as complex in uAllSources, which
+    /// halves the memory of the field and of the field tiles. Results are the
+    /// same.
+    bool realTLField = false;
+    /// Nx2D/3D altimetry and bathymetry read from file or set up with
+    /// extsetup_altimetry / extsetup_bathymetry: store only the grid coordinates
+    /// and the depths (as float) instead of a BdryPtFull per grid point, which
+    /// takes about 60 times less memory, so much larger boundaries fit in
+    /// maxMemory. The triangle normals and curvatures are computed from the
+    /// depths when they are needed, which makes ray tracing slightly slower.
+    /// Results are the same as with full storage for depths which are exactly
+    /// representable as float. See BdryInfoTopBot.
+    bool compactBdry = false;
+    /// Acousto-elastic halfspace boundaries ('A' / 'G'): if greater than zero,
+    /// tabulate the reflection coefficient of each distinct halfspace during
+    /// preprocessing, with about this angular resolution in degrees, and
+    /// interpolate it at each reflection instead of computing it from scratch.
+    /// The largest interpolation error is written to the print file, with a
+    /// warning if it is large. Reflections outside the tabulated range (sound
+    /// speeds below the minimum of the SSP) are still computed exactly. 0 means
+    /// all reflections are computed exactly.
+    double hsReflTableRes = 0.0;
     /// Index of the GPU to use (ignored if not in CUDA mode). This is the order
     /// the GPUs are enumerated in CUDA, usually with the most powerful GPU
     /// as index 0.
@@ -556,9 +922,26 @@ template<bool O3D> struct bhcParams {
 
 template<bool O3D, bool R3D> struct bhcOutputs {
     RayInfo<O3D, R3D> *rayinfo;
+    /// TL field. Broadband runs (freqinfo->Nfreq > 1) store one field per
+    /// frequency, consecutively in the order of freqinfo->freqVec. nullptr for
+    /// incoherent and semi-coherent runs with bhcInit::realTLField, which use
+    /// uAllSourcesReal instead.
     cpxf *uAllSources;
+    /// TL field of incoherent and semi-coherent runs (RunType 'I' and 'S') with
+    /// bhcInit::realTLField, laid out the same as uAllSources. After run(), this
+    /// is the real part of the pressure (the imaginary part is zero); while the
+    /// rays are being traced it is the intensity. nullptr otherwise.
+    float *uAllSourcesReal;
+    /// TL in dB of the field, laid out the same as uAllSources; see
+    /// bhcInit::tlDB. nullptr if not enabled.
+    float *tlDB;
+    /// Phase of the field in radians, laid out the same as uAllSources; see
+    /// bhcInit::tlPhase. nullptr if not enabled.
+    float *tlPhase;
     EigenInfo *eigen;
     ArrInfo *arrinfo;
+    /// Statistics about the last run; see RunMetrics.
+    RunMetrics *metrics;
 };
 
 } // namespace bhc
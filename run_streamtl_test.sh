@@ -0,0 +1,63 @@
+#!/bin/bash
+# bellhopcxx / bellhopcuda - C++/CUDA port of BELLHOP underwater acoustics simulator
+# Copyright (C) 2021-2022 The Regents of the University of California
+# c/o Jules Jaffe team at SIO / UCSD, jjaffe@ucsd.edu
+# Based on BELLHOP, which is Copyright (C) 1983-2020 Michael B. Porter
+#
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT ANY
+# WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+# PARTICULAR PURPOSE. See the GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program. If not, see <https://www.gnu.org/licenses/>.
+
+# Streamed TL (--streamtl) splits the sources into tiles sized by the memory
+# limit. With deterministic field accumulation (also the default), the shade
+# file must not depend on that limit: it must be identical to the one of the
+# run which is not streamed. The limits are large enough for all the field
+# tiles, which the default mode otherwise reduces.
+
+envfil=${1:-MunkStreamTL}
+mems=("--mem=128M" "--mem=256M")
+modes=("--deterministic" "")
+
+dotexe=""
+if [ -f ./bin/bellhopcxx.exe ]; then
+    dotexe=".exe"
+fi
+
+if [ ! -f "test/in/$envfil.env" ]; then
+    echo "test/in/$envfil.env does not exist"
+    exit 1
+fi
+dir=test/streamtl
+rm -rf $dir
+mkdir -p $dir
+cp test/in/$envfil.* $dir/
+
+failed=0
+for mode in "${modes[@]}"; do
+    echo "mode ${mode:-(default)}"
+    ./bin/bellhopcxx$dotexe -2 $mode $dir/$envfil >/dev/null || exit 1
+    mv $dir/$envfil.shd $dir/ref.shd
+    for mem in "${mems[@]}"; do
+        ./bin/bellhopcxx$dotexe -2 $mode --streamtl $mem $dir/$envfil >/dev/null \
+            || exit 1
+        grep "Streaming TL" $dir/$envfil.prt
+        if ! cmp -s $dir/$envfil.shd $dir/ref.shd; then
+            echo "$envfil: streamed TL with $mem differs from the unstreamed run"
+            failed=1
+        fi
+    done
+done
+
+if [[ $failed != "0" ]]; then
+    exit 1
+fi
+rm -rf $dir
+echo "$envfil: streamed TL passed"
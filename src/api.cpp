@@ -37,6 +37,7 @@ this program. If not, see <https://www.gnu.org/licenses/>.
 #include "module/beaminfo.hpp"
 #include "module/boundary.hpp"
 #include "module/reflcoef.hpp"
+#include "module/hsrefl.hpp"
 #include "module/sbp.hpp"
 
 #include "mode/modemodule.hpp"
@@ -76,6 +77,7 @@ public:
         modules.push_back(new Bathymetry<O3D>());
         modules.push_back(new BRC<O3D>());
         modules.push_back(new TRC<O3D>());
+        modules.push_back(new HSRefl<O3D>());
         modules.push_back(new SBP<O3D>());
     }
     ~ModulesList()
@@ -89,6 +91,37 @@ private:
     std::vector<ParamsModule<O3D> *> modules;
 };
 
+/**
+ * Validates and preprocesses the modules for run(). With preprocessDirtyOnly,
+ * after the first run, only the modules whose inputs are dirty, or were
+ * modified by an earlier module in the list, are redone, and the print file
+ * lists which ones these were.
+ */
+template<bool O3D> void PreprocessModules(
+    bhcParams<O3D> &params, const ModulesList<O3D> &modules)
+{
+    bhcInternal *internal = GetInternal(params);
+    bool incremental      = internal->preprocessDirtyOnly && internal->modulesPreprocessed;
+    uint32_t dirty        = incremental ? GetDirtyInputs(params) : INPUT_ALL;
+    std::vector<ParamsModule<O3D> *> redo;
+    std::string recomputed;
+    for(auto *m : modules.list()) {
+        if((m->Inputs() & dirty) == 0) continue;
+        redo.push_back(m);
+        dirty |= m->Outputs();
+        if(!recomputed.empty()) recomputed += ", ";
+        recomputed += m->Name();
+    }
+    for(auto *m : redo) m->Validate(params);
+    for(auto *m : redo) m->Preprocess(params);
+    ClearDirtyInputs(params);
+    if(incremental) {
+        internal->PRTFile << "\nRecomputed for changed inputs: "
+                          << (recomputed.empty() ? "none" : recomputed) << "\n";
+    }
+    internal->modulesPreprocessed = true;
+}
+
 #if BHC_ENABLE_2D
 template class ParamsModule<false>;
 template class ModulesList<false>;
@@ -224,6 +257,7 @@ template<bool O3D, bool R3D> bool setup(
         outputs.rayinfo = nullptr;
         outputs.eigen   = nullptr;
         outputs.arrinfo = nullptr;
+        outputs.metrics = nullptr;
         trackallocate(params, "data structures", params.Bdry);
         trackallocate(params, "data structures", params.bdinfo);
         trackallocate(params, "data structures", params.refl);
@@ -237,6 +271,9 @@ template<bool O3D, bool R3D> bool setup(
         trackallocate(params, "data structures", outputs.rayinfo);
         trackallocate(params, "data structures", outputs.eigen);
         trackallocate(params, "data structures", outputs.arrinfo);
+        trackallocate(params, "data structures", outputs.metrics);
+        memset(outputs.metrics, 0, sizeof(RunMetrics));
+        outputs.metrics->threads = nullptr;
 
         module::ModulesList<O3D> modules;
         mode::ModesList<O3D, R3D> modes;
@@ -281,7 +318,7 @@ template<bool O3D, bool R3D> bool setup(
             }
         }
 
-        sw.tock("setup");
+        outputs.metrics->setupTime = sw.tock("setup");
     } catch(const std::exception &e) {
         EXTWARN("Exception caught in bhc::setup(): %s\n", e.what());
         return false;
@@ -303,6 +340,15 @@ template bool BHC_API setup<true, true>(
     const bhcInit &init, bhcParams<true> &params, bhcOutputs<true, true> &outputs);
 #endif
 
+BHC_API bhcThreadPool *create_thread_pool(int32_t numThreads, bool pinThreads)
+{
+    bhcThreadPool *pool = new bhcThreadPool();
+    pool->Start(ModifyNumThreads(numThreads), pinThreads);
+    return pool;
+}
+
+BHC_API void destroy_thread_pool(bhcThreadPool *pool) { delete pool; }
+
 template<bool O3D> bool echo(bhcParams<O3D> &params)
 {
     try {
@@ -381,29 +427,72 @@ template<bool O3D, bool R3D> inline mode::ModeModule<O3D, R3D> *GetMode(
     }
 }
 
+/**
+ * Clears the metrics (except the setup and writeout times) and the per-thread
+ * counters for a new run.
+ */
+template<bool O3D, bool R3D> void ResetRunMetrics(
+    const bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs)
+{
+    bhcInternal *internal = GetInternal(params);
+    RunMetrics *metrics   = outputs.metrics;
+    if(metrics->numThreads != internal->numThreads) {
+        trackallocate(params, "run metrics", metrics->threads, internal->numThreads);
+        metrics->numThreads = internal->numThreads;
+    }
+    memset(metrics->threads, 0, metrics->numThreads * sizeof(ThreadMetrics));
+    metrics->preprocessTime = metrics->runTime = metrics->postprocessTime = 0.0;
+    metrics->rays = metrics->steps = metrics->reflections = metrics->smallSteps = 0;
+    metrics->influenceEvals = metrics->receiverHits = 0;
+    internal->rayCounters.assign(internal->numThreads, RayCounters());
+}
+
+/**
+ * Sums the per-thread counters into the metrics after the run.
+ */
+template<bool O3D, bool R3D> void SumRunMetrics(
+    const bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs)
+{
+    bhcInternal *internal = GetInternal(params);
+    RunMetrics *metrics   = outputs.metrics;
+    for(const RayCounters &c : internal->rayCounters) {
+        metrics->rays += c.rays;
+        metrics->steps += c.steps;
+        metrics->reflections += c.reflections;
+        metrics->smallSteps += c.smallSteps;
+        metrics->influenceEvals += c.influenceEvals;
+        metrics->receiverHits += c.receiverHits;
+    }
+    metrics->peakMemory = internal->peakMemory;
+}
+
 template<bool O3D, bool R3D> bool run(
     bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs)
 {
     try {
         Stopwatch sw(GetInternal(params));
+        RunMetrics *metrics = outputs.metrics;
 
         sw.tick();
+        ResetRunMetrics<O3D, R3D>(params, outputs);
         module::ModulesList<O3D> modules;
-        for(auto *m : modules.list()) m->Validate(params);
-        for(auto *m : modules.list()) m->Preprocess(params);
+        module::PreprocessModules<O3D>(params, modules);
         auto *mo = GetMode<O3D, R3D>(params);
+        // Ray runs do not use cached rays, so do not keep them taking memory
+        if(IsRayRun(params.Beam)) mode::FreeRayCache<O3D>(params);
         mo->Preprocess(params, outputs);
-        sw.tock("Preprocess");
+        metrics->preprocessTime = sw.tock("Preprocess");
 
         sw.tick();
         mo->Run(params, outputs);
-        sw.tock("Run");
+        metrics->runTime = sw.tock("Run");
 
         sw.tick();
         mo->Postprocess(params, outputs);
-        sw.tock("Postprocess");
+        metrics->postprocessTime = sw.tock("Postprocess");
 
         delete mo;
+        SumRunMetrics<O3D, R3D>(params, outputs);
     } catch(const std::exception &e) {
         EXTWARN("Exception caught in bhc::run(): %s\n", e.what());
         return false;
@@ -425,6 +514,157 @@ template bool BHC_API
 run<true, true>(bhcParams<true> &params, bhcOutputs<true, true> &outputs);
 #endif
 
+/**
+ * LP: Runs one scenario of a batch on the calling thread (a thread of the
+ * batch's pool) with one worker.
+ */
+template<bool O3D, bool R3D> bool RunBatchScenario(
+    bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs)
+{
+    bhcInternal *internal = GetInternal(params);
+    int32_t numThreads    = internal->numThreads;
+    internal->numThreads  = 1;
+    bool ok               = run<O3D, R3D>(params, outputs);
+    internal->numThreads  = numThreads;
+    return ok;
+}
+
+template<bool O3D, bool R3D> bool run_batch(
+    bhcParams<O3D> *params, bhcOutputs<O3D, R3D> *outputs, int32_t numScenarios,
+    bhcThreadPool *pool, void (*completed)(int32_t scenario, bool success, void *user),
+    void *user)
+{
+    if(numScenarios <= 0) return true;
+    if(pool == nullptr) pool = GetInternal(params[0])->threadPool;
+    std::atomic<int32_t> nextScenario(0);
+    std::atomic<bool> allOK(true);
+    try {
+        pool->Run(pool->NumThreads(), [&](int32_t) {
+            for(int32_t s = nextScenario++; s < numScenarios; s = nextScenario++) {
+                bool ok = RunBatchScenario<O3D, R3D>(params[s], outputs[s]);
+                if(!ok) allOK = false;
+                if(completed != nullptr) completed(s, ok, user);
+            }
+        });
+    } catch(const std::exception &e) {
+        ExternalWarning(
+            GetInternal(params[0]), "Exception caught in bhc::run_batch(): %s\n",
+            e.what());
+        return false;
+    }
+    return allOK;
+}
+
+#if BHC_ENABLE_2D
+template bool BHC_API run_batch<false, false>(
+    bhcParams<false> *params, bhcOutputs<false, false> *outputs, int32_t numScenarios,
+    bhcThreadPool *pool, void (*completed)(int32_t scenario, bool success, void *user),
+    void *user);
+#endif
+#if BHC_ENABLE_NX2D
+template bool BHC_API run_batch<true, false>(
+    bhcParams<true> *params, bhcOutputs<true, false> *outputs, int32_t numScenarios,
+    bhcThreadPool *pool, void (*completed)(int32_t scenario, bool success, void *user),
+    void *user);
+#endif
+#if BHC_ENABLE_3D
+template bool BHC_API run_batch<true, true>(
+    bhcParams<true> *params, bhcOutputs<true, true> *outputs, int32_t numScenarios,
+    bhcThreadPool *pool, void (*completed)(int32_t scenario, bool success, void *user),
+    void *user);
+#endif
+
+template<bool O3D, bool R3D> bool run_batch(
+    const bhcInit &init, int32_t numScenarios, bhcThreadPool *pool,
+    bool (*perturb)(int32_t scenario, bhcParams<O3D> &params, void *user),
+    void (*completed)(
+        int32_t scenario, bool success, bhcParams<O3D> &params,
+        bhcOutputs<O3D, R3D> &outputs, void *user),
+    void *user)
+{
+    if(numScenarios <= 0) return true;
+    std::unique_ptr<bhcThreadPool, void (*)(bhcThreadPool *)> ownPool(
+        nullptr, destroy_thread_pool);
+    bhcInit workerInit = init;
+    std::atomic<int32_t> nextScenario(0), numRun(0);
+    std::atomic<bool> allOK(true);
+    try {
+        if(pool == nullptr) {
+            ownPool.reset(create_thread_pool(init.numThreads, init.pinThreads));
+            pool = ownPool.get();
+        }
+        workerInit.threadPool = pool;
+        pool->Run(pool->NumThreads(), [&](int32_t) {
+            int32_t s = nextScenario++;
+            if(s >= numScenarios) return;
+            // LP: Each thread's own instance, set up once and reused.
+            bhcParams<O3D> params;
+            bhcOutputs<O3D, R3D> outputs;
+            if(!setup<O3D, R3D>(workerInit, params, outputs)) {
+                // Leave this and the remaining scenarios to the other threads,
+                // which will most likely fail the same way.
+                allOK = false;
+                return;
+            }
+            // LP: Also if a callback throws.
+            struct Finalizer {
+                bhcParams<O3D> &params;
+                bhcOutputs<O3D, R3D> &outputs;
+                ~Finalizer() { finalize<O3D, R3D>(params, outputs); }
+            } finalizer {params, outputs};
+            // Also for writeout() etc. in the callback, which would otherwise
+            // split its work into tasks which this same thread runs one by one.
+            GetInternal(params)->numThreads = 1;
+            for(; s < numScenarios; s = nextScenario++) {
+                bool ok = perturb(s, params, user)
+                    && RunBatchScenario<O3D, R3D>(params, outputs);
+                if(!ok) allOK = false;
+                ++numRun;
+                completed(s, ok, params, outputs, user);
+            }
+        });
+    } catch(const std::exception &e) {
+        // LP: There is no instance to report through, as in ExternalWarning.
+        std::string msg = std::string("Exception caught in bhc::run_batch(): ")
+            + e.what() + "\n";
+        if(init.outputCallback == nullptr) {
+            printf("%s\n", msg.c_str());
+        } else {
+            init.outputCallback(msg.c_str());
+        }
+        return false;
+    }
+    return allOK && numRun == numScenarios;
+}
+
+#if BHC_ENABLE_2D
+template bool BHC_API run_batch<false, false>(
+    const bhcInit &init, int32_t numScenarios, bhcThreadPool *pool,
+    bool (*perturb)(int32_t scenario, bhcParams<false> &params, void *user),
+    void (*completed)(
+        int32_t scenario, bool success, bhcParams<false> &params,
+        bhcOutputs<false, false> &outputs, void *user),
+    void *user);
+#endif
+#if BHC_ENABLE_NX2D
+template bool BHC_API run_batch<true, false>(
+    const bhcInit &init, int32_t numScenarios, bhcThreadPool *pool,
+    bool (*perturb)(int32_t scenario, bhcParams<true> &params, void *user),
+    void (*completed)(
+        int32_t scenario, bool success, bhcParams<true> &params,
+        bhcOutputs<true, false> &outputs, void *user),
+    void *user);
+#endif
+#if BHC_ENABLE_3D
+template bool BHC_API run_batch<true, true>(
+    const bhcInit &init, int32_t numScenarios, bhcThreadPool *pool,
+    bool (*perturb)(int32_t scenario, bhcParams<true> &params, void *user),
+    void (*completed)(
+        int32_t scenario, bool success, bhcParams<true> &params,
+        bhcOutputs<true, true> &outputs, void *user),
+    void *user);
+#endif
+
 template<bool O3D, bool R3D> bool writeout(
     const bhcParams<O3D> &params, const bhcOutputs<O3D, R3D> &outputs,
     const char *FileRoot)
@@ -435,7 +675,7 @@ template<bool O3D, bool R3D> bool writeout(
         if(FileRoot != nullptr) { GetInternal(params)->FileRoot = FileRoot; }
         auto *mo = GetMode<O3D, R3D>(params);
         mo->Writeout(params, outputs);
-        sw.tock("writeout");
+        outputs.metrics->writeoutTime = sw.tock("writeout");
         delete mo;
     } catch(const std::exception &e) {
         EXTWARN("Exception caught in bhc::writeout(): %s\n", e.what());
@@ -460,6 +700,65 @@ template bool BHC_API writeout<true, true>(
     const char *FileRoot);
 #endif
 
+template<bool O3D, bool R3D> bool writemetrics(
+    const bhcParams<O3D> &params, const bhcOutputs<O3D, R3D> &outputs,
+    const char *FileRoot)
+{
+    try {
+        if(FileRoot == nullptr) { FileRoot = GetInternal(params)->FileRoot.c_str(); }
+        std::string path = std::string(FileRoot) + ".metrics.json";
+        std::ofstream out(path);
+        if(!out.good()) { EXTERR("Could not open %s", path.c_str()); }
+        const RunMetrics *m = outputs.metrics;
+        out << std::setprecision(12);
+        out << "{\n"
+            << "  \"program\": \"" BHC_PROGRAMNAME "\",\n"
+            << "  \"dim\": \"" << (R3D ? "3D" : O3D ? "Nx2D" : "2D") << "\",\n"
+            << "  \"runType\": \"" << params.Beam->RunType[0] << "\",\n"
+            << "  \"setupTime\": " << m->setupTime << ",\n"
+            << "  \"preprocessTime\": " << m->preprocessTime << ",\n"
+            << "  \"runTime\": " << m->runTime << ",\n"
+            << "  \"postprocessTime\": " << m->postprocessTime << ",\n"
+            << "  \"writeoutTime\": " << m->writeoutTime << ",\n"
+            << "  \"rays\": " << m->rays << ",\n"
+            << "  \"steps\": " << m->steps << ",\n"
+            << "  \"reflections\": " << m->reflections << ",\n"
+            << "  \"smallSteps\": " << m->smallSteps << ",\n"
+            << "  \"influenceEvals\": " << m->influenceEvals << ",\n"
+            << "  \"receiverHits\": " << m->receiverHits << ",\n"
+            << "  \"peakMemory\": " << m->peakMemory << ",\n"
+            << "  \"threads\": [";
+        for(int32_t t = 0; t < m->numThreads; ++t) {
+            const ThreadMetrics &tm = m->threads[t];
+            out << (t == 0 ? "\n" : ",\n") << "    {\"jobs\": " << tm.jobs
+                << ", \"busyTime\": " << tm.busyTime << ", \"idleTime\": " << tm.idleTime
+                << "}";
+        }
+        out << (m->numThreads > 0 ? "\n  ]\n" : "]\n") << "}\n";
+        if(!out.good()) { EXTERR("Error writing %s", path.c_str()); }
+    } catch(const std::exception &e) {
+        EXTWARN("Exception caught in bhc::writemetrics(): %s\n", e.what());
+        return false;
+    }
+    return true;
+}
+
+#if BHC_ENABLE_2D
+template bool BHC_API writemetrics<false, false>(
+    const bhcParams<false> &params, const bhcOutputs<false, false> &outputs,
+    const char *FileRoot);
+#endif
+#if BHC_ENABLE_NX2D
+template bool BHC_API writemetrics<true, false>(
+    const bhcParams<true> &params, const bhcOutputs<true, false> &outputs,
+    const char *FileRoot);
+#endif
+#if BHC_ENABLE_3D
+template bool BHC_API writemetrics<true, true>(
+    const bhcParams<true> &params, const bhcOutputs<true, true> &outputs,
+    const char *FileRoot);
+#endif
+
 template<bool O3D, bool R3D> bool readout(
     bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs, const char *FileRoot)
 {
@@ -499,6 +798,7 @@ template<bool O3D, bool R3D> void finalize(
     mode::ModesList<O3D, R3D> modes;
     for(auto *m : modules.list()) m->Finalize(params);
     for(auto *m : modes.list()) m->Finalize(params, outputs);
+    mode::FreeRayCache<O3D>(params);
 
     trackdeallocate(params, params.Bdry);
     trackdeallocate(params, params.bdinfo);
@@ -513,6 +813,8 @@ template<bool O3D, bool R3D> void finalize(
     trackdeallocate(params, outputs.rayinfo);
     trackdeallocate(params, outputs.eigen);
     trackdeallocate(params, outputs.arrinfo);
+    trackdeallocate(params, outputs.metrics->threads);
+    trackdeallocate(params, outputs.metrics);
 
     if(GetInternal(params)->usedMemory != 0) {
         EXTWARN(
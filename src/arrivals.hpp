@@ -27,105 +27,141 @@ namespace bhc {
  * (test this by seeing if the arrival time is close to the previous one)
  * (also need that the phase is about the same to make sure surface and direct paths are
  * not joined)
+ * LP: lastArr is the previous arrival at this receiver, or nullptr if none.
  */
 template<bool R3D> HOST_DEVICE inline bool IsSecondStepOfPair(
-    real omega, real Phase, cpx delay, Arrival *baseArr, int32_t Nt)
+    real omega, real Phase, cpx delay, const Arrival *lastArr)
 {
     // arrivals with essentially the same phase are grouped into one
     const float PhaseTol = /*R3D ? FL(0.5) :*/ FL(0.05); // LP: 0.5 for 2D removed by mbp
                                                          // in 2022 revisions.
-    return Nt >= 1 && omega * STD::abs(delay - Cpxf2Cpx(baseArr[Nt - 1].delay)) < PhaseTol
-        && STD::abs(baseArr[Nt - 1].Phase - Phase) < PhaseTol;
+    return lastArr != nullptr
+        && omega * STD::abs(delay - Cpxf2Cpx(lastArr->delay)) < PhaseTol
+        && STD::abs(lastArr->Phase - Phase) < PhaseTol;
+}
+
+/**
+ * LP: Takes an entry from the arrivals pool. Returns -1 if the pool is full.
+ */
+HOST_DEVICE inline int32_t AllocArr(const ArrInfo *arrinfo)
+{
+    int32_t *used = &arrinfo->PoolCounters[0];
+    // LP: Avoid incrementing the counter forever (and overflowing it) once full.
+    if(*used >= arrinfo->ArrCapacity) return -1;
+    int32_t iArr = AtomicFetchAdd(used, 1);
+    return iArr < arrinfo->ArrCapacity ? iArr : -1;
+}
+
+template<bool R3D> HOST_DEVICE inline void SetArr(
+    Arrival &arr, real Amp, real Phase, cpx delay, const RayInitInfo &rinit,
+    real RcvrDeclAngle, real RcvrAzimAngle, int32_t NumTopBnc, int32_t NumBotBnc)
+{
+    arr.a             = (float)Amp;                // amplitude
+    arr.Phase         = (float)Phase;              // phase
+    arr.delay         = Cpx2Cpxf(delay);           // delay time
+    arr.SrcDeclAngle  = (float)rinit.SrcDeclAngle; // launch angle from source
+    arr.SrcAzimAngle  = (float)rinit.SrcAzimAngle; // launch angle from source
+    arr.RcvrDeclAngle = (float)RcvrDeclAngle;      // angle ray reaches receiver
+    arr.RcvrAzimAngle = (float)RcvrAzimAngle;      // angle ray reaches receiver
+    arr.NTopBnc       = NumTopBnc;                 // Number of top    bounces
+    arr.NBotBnc       = NumBotBnc;                 //   "       bottom
+}
+
+/**
+ * Combines the second step of a pair into the arrival from the first step.
+ */
+HOST_DEVICE inline void MergeArr(Arrival &arr, const Arrival &next)
+{
+    // PhaseArr[<base> + Nt-1] = PhaseArr[<base> + Nt-1] // LP: ???
+
+    // calculate weightings of old ray information vs. new, based on amplitude of
+    // the arrival
+    float AmpTot = arr.a + next.a;
+    float w1     = arr.a / AmpTot;
+    float w2     = next.a / AmpTot;
+
+    arr.delay         = w1 * arr.delay + w2 * next.delay; // weighted sum
+    arr.a             = AmpTot;
+    arr.SrcDeclAngle  = w1 * arr.SrcDeclAngle + w2 * next.SrcDeclAngle;
+    arr.SrcAzimAngle  = w1 * arr.SrcAzimAngle + w2 * next.SrcAzimAngle;
+    arr.RcvrDeclAngle = w1 * arr.RcvrDeclAngle + w2 * next.RcvrDeclAngle;
+    arr.RcvrAzimAngle = w1 * arr.RcvrAzimAngle + w2 * next.RcvrAzimAngle;
 }
 
 /**
  * Adds the amplitude and delay for an ARRival into a matrix of same.
  * Extra logic included to keep only the strongest arrivals.
+ *
+ * LP: The arrivals at each receiver are a linked list of entries in the
+ * arrivals pool, so any receiver can have any number of arrivals as long as
+ * the pool as a whole has space. PostProcessArrivals compacts the lists.
  */
 template<bool R3D> HOST_DEVICE inline void AddArr(
     int32_t itheta, int32_t id, int32_t ir, real Amp, real omega, real Phase, cpx delay,
     const RayInitInfo &rinit, real RcvrDeclAngle, real RcvrAzimAngle, int32_t NumTopBnc,
     int32_t NumBotBnc, const ArrInfo *arrinfo, const Position *Pos)
 {
-    size_t base      = GetFieldAddr(rinit.isx, rinit.isy, rinit.isz, itheta, id, ir, Pos);
-    Arrival *baseArr = &arrinfo->Arr[base * arrinfo->MaxNArr];
-    int32_t *baseNArr = &arrinfo->NArr[base];
-    int32_t Nt;
+    size_t base   = GetFieldAddr(rinit.isx, rinit.isy, rinit.isz, itheta, id, ir, Pos);
+    int32_t *last = &arrinfo->ArrLast[base];
 
     if(arrinfo->AllowMerging) {
         // LP: BUG: This only checks the last arrival, whereas the first step of the
         // pair could have been placed in previous slots. See the Fortran version readme.
 
-        Nt = *baseNArr; // # of arrivals
+        Arrival *lastArr = *last >= 0 ? &arrinfo->Arr[*last] : nullptr;
 
-        if(!IsSecondStepOfPair<R3D>(omega, Phase, delay, baseArr, Nt)) {
-            int32_t iArr;
-            if(Nt >= arrinfo->MaxNArr) { // space not available to add an arrival?
+        if(!IsSecondStepOfPair<R3D>(omega, Phase, delay, lastArr)) {
+            int32_t iArr = AllocArr(arrinfo);
+            if(iArr < 0) { // space not available to add an arrival?
+                // LP: One arrival is lost either way, so count it for Run to
+                // trace again with a larger pool.
+                ++arrinfo->PoolCounters[1];
                 // replace weakest arrival
-                iArr         = -1;
                 real weakest = Amp;
-                for(Nt = 0; Nt < arrinfo->MaxNArr; ++Nt) {
-                    if(baseArr[Nt].a < weakest) {
-                        weakest = baseArr[Nt].a;
-                        iArr    = Nt;
+                for(int32_t i = *last; i >= 0; i = arrinfo->ArrPrev[i]) {
+                    if(arrinfo->Arr[i].a < weakest) {
+                        weakest = arrinfo->Arr[i].a;
+                        iArr    = i;
                     }
                 }
                 if(iArr < 0) return; // LP: current arrival is weaker than all stored
             } else {
-                iArr      = Nt;
-                *baseNArr = Nt + 1; // # of arrivals
+                arrinfo->ArrPrev[iArr] = *last;
+                *last                  = iArr;
+                ++arrinfo->NArr[base]; // # of arrivals
             }
-            baseArr[iArr].a            = (float)Amp;                // amplitude
-            baseArr[iArr].Phase        = (float)Phase;              // phase
-            baseArr[iArr].delay        = Cpx2Cpxf(delay);           // delay time
-            baseArr[iArr].SrcDeclAngle = (float)rinit.SrcDeclAngle; // launch angle from
-                                                                    // source
-            baseArr[iArr].SrcAzimAngle = (float)rinit.SrcAzimAngle; // launch angle from
-                                                                    // source
-            baseArr[iArr].RcvrDeclAngle = (float)RcvrDeclAngle;     // angle ray reaches
-                                                                    // receiver
-            baseArr[iArr].RcvrAzimAngle = (float)RcvrAzimAngle;     // angle ray reaches
-                                                                    // receiver
-            baseArr[iArr].NTopBnc = NumTopBnc; // Number of top    bounces
-            baseArr[iArr].NBotBnc = NumBotBnc; //   "       bottom
-        } else {                               // not a new ray
-            // PhaseArr[<base> + Nt-1] = PhaseArr[<base> + Nt-1] // LP: ???
-
-            // calculate weightings of old ray information vs. new, based on amplitude of
-            // the arrival
-            float AmpTot = baseArr[Nt - 1].a + (float)Amp;
-            float w1     = baseArr[Nt - 1].a / AmpTot;
-            float w2     = (float)Amp / AmpTot;
-
-            baseArr[Nt - 1].delay = w1 * baseArr[Nt - 1].delay
-                + w2 * Cpx2Cpxf(delay); // weighted sum
-            baseArr[Nt - 1].a            = AmpTot;
-            baseArr[Nt - 1].SrcDeclAngle = w1 * baseArr[Nt - 1].SrcDeclAngle
-                + w2 * (float)rinit.SrcDeclAngle;
-            baseArr[Nt - 1].SrcAzimAngle = w1 * baseArr[Nt - 1].SrcAzimAngle
-                + w2 * (float)rinit.SrcAzimAngle;
-            baseArr[Nt - 1].RcvrDeclAngle = w1 * baseArr[Nt - 1].RcvrDeclAngle
-                + w2 * (float)RcvrDeclAngle;
-            baseArr[Nt - 1].RcvrAzimAngle = w1 * baseArr[Nt - 1].RcvrAzimAngle
-                + w2 * (float)RcvrAzimAngle;
+            SetArr<R3D>(
+                arrinfo->Arr[iArr], Amp, Phase, delay, rinit, RcvrDeclAngle,
+                RcvrAzimAngle, NumTopBnc, NumBotBnc);
+        } else { // not a new ray
+            Arrival next;
+            SetArr<R3D>(
+                next, Amp, Phase, delay, rinit, RcvrDeclAngle, RcvrAzimAngle, NumTopBnc,
+                NumBotBnc);
+            MergeArr(*lastArr, next);
         }
 
     } else {
         // LP: For multithreading mode, some mutex scheme would be needed to
         // guarantee correct access to previously written data, which would
-        // destroy the performance on GPU. So just write the first
-        // arrinfo->MaxNArr arrivals and give up.
-        Nt = AtomicFetchAdd(baseNArr, 1);
-        if(Nt >= arrinfo->MaxNArr) return;
-        baseArr[Nt].a             = (float)Amp;                // amplitude
-        baseArr[Nt].Phase         = (float)Phase;              // phase
-        baseArr[Nt].delay         = Cpx2Cpxf(delay);           // delay time
-        baseArr[Nt].SrcDeclAngle  = (float)rinit.SrcDeclAngle; // launch angle from source
-        baseArr[Nt].SrcAzimAngle  = (float)rinit.SrcAzimAngle; // launch angle from source
-        baseArr[Nt].RcvrDeclAngle = (float)RcvrDeclAngle; // angle ray reaches receiver
-        baseArr[Nt].RcvrAzimAngle = (float)RcvrAzimAngle; // angle ray reaches receiver
-        baseArr[Nt].NTopBnc       = NumTopBnc;            // Number of top    bounces
-        baseArr[Nt].NBotBnc       = NumBotBnc;            //   "       bottom
+        // destroy the performance on GPU. So each arrival gets its own pool
+        // entry, which is pushed onto the receiver's list with an atomic
+        // exchange. The list is only traversed after the run, when the steps
+        // of pairs are merged in ray order, giving the same result as above.
+        int32_t iArr = AllocArr(arrinfo);
+        if(iArr < 0) {
+            AtomicFetchAdd(&arrinfo->PoolCounters[1], 1);
+            return;
+        }
+        SetArr<R3D>(
+            arrinfo->Arr[iArr], Amp, Phase, delay, rinit, RcvrDeclAngle, RcvrAzimAngle,
+            NumTopBnc, NumBotBnc);
+        ArrivalMergeInfo &merge = arrinfo->ArrMerge[iArr];
+        merge.delay             = delay;
+        merge.Phase             = Phase;
+        merge.ray               = rinit.ibeta * arrinfo->Nalpha + rinit.ialpha;
+        arrinfo->ArrPrev[iArr] = AtomicExchange(last, iArr);
+        AtomicFetchAdd(&arrinfo->NArr[base], 1);
     }
 }
 
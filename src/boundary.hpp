@@ -49,9 +49,127 @@ template<> struct bdry_big<false> {
  */
 HOST_DEVICE inline void CopyHSInfo(HSInfo &b, const HSInfo &a)
 {
-    b.cP  = a.cP;
-    b.cS  = a.cS;
-    b.rho = a.rho;
+    b.cP     = a.cP;
+    b.cS     = a.cS;
+    b.rho    = a.rho;
+    b.iTable = a.iTable;
+}
+
+/**
+ * LP: Nx2D/3D boundary grid accessors. The boundary is either stored as a
+ * BdryPtFull per grid point (bd), or compactly as the grid coordinates and
+ * depths only (see bhcInit::compactBdry and BdryInfoTopBot).
+ */
+HOST_DEVICE inline real BdryGridX(const BdryInfoTopBot<true> *bdinfotb, int32_t ix)
+{
+    if(bdinfotb->bd != nullptr) return bdinfotb->bd[ix * bdinfotb->NPts.y].x.x;
+    return bdinfotb->gridx[ix];
+}
+HOST_DEVICE inline real BdryGridY(const BdryInfoTopBot<true> *bdinfotb, int32_t iy)
+{
+    if(bdinfotb->bd != nullptr) return bdinfotb->bd[iy].x.y;
+    return bdinfotb->gridy[iy];
+}
+HOST_DEVICE inline vec3 BdryNodeX(
+    const BdryInfoTopBot<true> *bdinfotb, int32_t ix, int32_t iy)
+{
+    int32_t i = ix * bdinfotb->NPts.y + iy;
+    if(bdinfotb->bd != nullptr) return bdinfotb->bd[i].x;
+    return vec3(bdinfotb->gridx[ix], bdinfotb->gridy[iy], (real)bdinfotb->depth[i]);
+}
+
+/**
+ * Outward-pointing unit normal of one of the triangles of a boundary rectangle,
+ * whose corner nodes are p1 = (ix, iy), p2 = (ix+1, iy), p3 = (ix+1, iy+1), and
+ * p4 = (ix, iy+1), moving counter-clockwise around the rectangle. side false is
+ * triangle 1 (p1, p2, p3) and side true is triangle 2 (p1, p3, p4).
+ */
+HOST_DEVICE inline vec3 BdryTriNormal(
+    const vec3 &p1, const vec3 &p2, const vec3 &p3, const vec3 &p4, bool side,
+    bool isTop)
+{
+    vec3 u, v;
+    if(!side) {
+        // edges for triangle 1
+        u = p2 - p1; // tangent along one edge
+        v = p3 - p1; // tangent along another edge
+    } else {
+        // edges for triangle 2
+        u = p3 - p1; // tangent along one edge
+        v = p4 - p1; // tangent along another edge
+    }
+    // normal vector is the cross-product of the edge tangents
+    vec3 n = glm::cross(u, v);
+    if(isTop) n = -n;
+    return n / glm::length(n); // scale to make it a unit normal
+}
+
+/**
+ * Normal to the boundary surface at a grid point, vec3(-dz/dx, -dz/dy, 1) (not
+ * unit length). Uses forward, centered, or backward difference formulas.
+ */
+HOST_DEVICE inline vec3 BdryNodeNormalUnscaled(
+    const BdryInfoTopBot<true> *bdinfotb, int32_t ix, int32_t iy)
+{
+    int32_t ixlo = bhc::max(ix - 1, 0), ixhi = bhc::min(ix + 1, bdinfotb->NPts.x - 1);
+    int32_t iylo = bhc::max(iy - 1, 0), iyhi = bhc::min(iy + 1, bdinfotb->NPts.y - 1);
+    vec3 xlo     = BdryNodeX(bdinfotb, ixlo, iy);
+    vec3 xhi     = BdryNodeX(bdinfotb, ixhi, iy);
+    vec3 ylo     = BdryNodeX(bdinfotb, ix, iylo);
+    vec3 yhi     = BdryNodeX(bdinfotb, ix, iyhi);
+    real mx      = (xhi.z - xlo.z) / (xhi.x - xlo.x);
+    real my      = (yhi.z - ylo.z) / (yhi.y - ylo.y);
+    return vec3(-mx, -my, RL(1.0)); // this is a normal to the surface
+}
+
+/**
+ * LP: Curvature terms of boundary rectangle (ix, iy) for the curvilinear
+ * option, computed from the depths like ComputeBdryTangentNormal in
+ * module/boundary.hpp does for all rectangles of a non-compact boundary. Only
+ * used for compact boundaries, at reflections.
+ */
+HOST_DEVICE inline void BdryCellCurvature(
+    const BdryInfoTopBot<true> *bdinfotb, int32_t ix, int32_t iy,
+    ReflCurvature<true> &rcurv)
+{
+    vec3 p00 = BdryNodeX(bdinfotb, ix, iy);
+    vec3 p10 = BdryNodeX(bdinfotb, ix + 1, iy);
+    vec3 p01 = BdryNodeX(bdinfotb, ix, iy + 1);
+    vec3 n00 = BdryNodeNormalUnscaled(bdinfotb, ix, iy);
+    vec3 n10 = BdryNodeNormalUnscaled(bdinfotb, ix + 1, iy);
+    vec3 n01 = BdryNodeNormalUnscaled(bdinfotb, ix, iy + 1);
+    // this is the angle at each node
+    real phi00 = STD::atan2(n00.z, n00.x);
+    real phi10 = STD::atan2(n10.z, n10.x);
+    real phi01 = STD::atan2(n01.z, n01.x);
+
+    // z_xx (difference in x of z_x)
+    rcurv.z_xx = -(n10.x - n00.x) / (p10.x - p00.x);
+
+    vec3 tvec = p10 - p00;
+    real Len  = STD::sqrt(SQ(tvec.x) + SQ(tvec.z));
+    // this is curvature = dphi/ds
+    rcurv.kappa_xx = (phi10 - phi00) / Len;
+
+    // z_xy (difference in y of z_x)
+    rcurv.z_xy = -(n01.x - n00.x) / (p01.y - p00.y);
+
+    tvec = p01 - p00;
+    Len  = STD::sqrt(SQ(tvec.y) + SQ(tvec.z));
+    // this is curvature = dphi/ds
+    rcurv.kappa_xy = (phi01 - phi00) / Len;
+
+    // z_yy (difference in y of z_y)
+    rcurv.z_yy = -(n01.y - n00.y) / (p01.y - p00.y);
+
+    // this is curvature = dphi/ds
+    rcurv.kappa_yy = (phi01 - phi00) / Len;
+
+    // introduce Len factor per Eq. 4.4.18 in Cerveny's book
+    Len = glm::length(n00);
+    rcurv.z_xx /= Len;
+    rcurv.z_xy /= Len;
+    rcurv.z_yy /= Len;
 }
 
 /**
@@ -76,36 +194,38 @@ template<bool O3D> HOST_DEVICE inline void GetBdrySeg(
         bds.Iseg.x = bhc::min(bhc::max(bds.Iseg.x, 0), nx - 2);
         bds.Iseg.y = bhc::min(bhc::max(bds.Iseg.y, 0), ny - 2);
         if(t.x >= FL(0.0)) {
-            while(bds.Iseg.x >= 0 && bdinfotb->bd[(bds.Iseg.x) * ny].x.x > x.x)
+            while(bds.Iseg.x >= 0 && BdryGridX(bdinfotb, bds.Iseg.x) > x.x)
                 --bds.Iseg.x;
             while(bds.Iseg.x >= 0 && bds.Iseg.x < nx - 1
-                  && bdinfotb->bd[(bds.Iseg.x + 1) * ny].x.x <= x.x)
+                  && BdryGridX(bdinfotb, bds.Iseg.x + 1) <= x.x)
                 ++bds.Iseg.x;
         } else {
-            while(bds.Iseg.x < nx - 1 && bdinfotb->bd[(bds.Iseg.x + 1) * ny].x.x < x.x)
+            while(bds.Iseg.x < nx - 1 && BdryGridX(bdinfotb, bds.Iseg.x + 1) < x.x)
                 ++bds.Iseg.x;
             while(bds.Iseg.x >= 0 && bds.Iseg.x < nx - 1
-                  && bdinfotb->bd[(bds.Iseg.x) * ny].x.x >= x.x)
+                  && BdryGridX(bdinfotb, bds.Iseg.x) >= x.x)
                 --bds.Iseg.x;
         }
         if(t.y >= FL(0.0)) {
-            while(bds.Iseg.y >= 0 && bdinfotb->bd[bds.Iseg.y].x.y > x.y) --bds.Iseg.y;
+            while(bds.Iseg.y >= 0 && BdryGridY(bdinfotb, bds.Iseg.y) > x.y)
+                --bds.Iseg.y;
             while(bds.Iseg.y >= 0 && bds.Iseg.y < ny - 1
-                  && bdinfotb->bd[bds.Iseg.y + 1].x.y <= x.y)
+                  && BdryGridY(bdinfotb, bds.Iseg.y + 1) <= x.y)
                 ++bds.Iseg.y;
         } else {
-            while(bds.Iseg.y < ny - 1 && bdinfotb->bd[bds.Iseg.y + 1].x.y < x.y)
+            while(bds.Iseg.y < ny - 1 && BdryGridY(bdinfotb, bds.Iseg.y + 1) < x.y)
                 ++bds.Iseg.y;
             while(bds.Iseg.y >= 0 && bds.Iseg.y < ny - 1
-                  && bdinfotb->bd[bds.Iseg.y].x.y >= x.y)
+                  && BdryGridY(bdinfotb, bds.Iseg.y) >= x.y)
                 --bds.Iseg.y;
         }
 
-        if(bds.Iseg.x == -1 && bdinfotb->bd[0].x.x == x.x) bds.Iseg.x = 0;
-        if(bds.Iseg.x == nx - 1 && bdinfotb->bd[(nx - 1) * ny].x.x == x.x)
+        if(bds.Iseg.x == -1 && BdryGridX(bdinfotb, 0) == x.x) bds.Iseg.x = 0;
+        if(bds.Iseg.x == nx - 1 && BdryGridX(bdinfotb, nx - 1) == x.x)
             bds.Iseg.x = nx - 2;
-        if(bds.Iseg.y == -1 && bdinfotb->bd[0].x.y == x.y) bds.Iseg.y = 0;
-        if(bds.Iseg.y == ny - 1 && bdinfotb->bd[ny - 1].x.y == x.y) bds.Iseg.y = ny - 2;
+        if(bds.Iseg.y == -1 && BdryGridY(bdinfotb, 0) == x.y) bds.Iseg.y = 0;
+        if(bds.Iseg.y == ny - 1 && BdryGridY(bdinfotb, ny - 1) == x.y)
+            bds.Iseg.y = ny - 2;
 
         if(bds.Iseg.x < 0 || bds.Iseg.x >= nx - 1 || bds.Iseg.y < 0
            || bds.Iseg.y >= ny - 1) {
@@ -124,13 +244,13 @@ template<bool O3D> HOST_DEVICE inline void GetBdrySeg(
         }
 
         // segment limits in range
-        bds.lSeg.x.min = bdinfotb->bd[(bds.Iseg.x) * ny].x.x;
-        bds.lSeg.x.max = bdinfotb->bd[(bds.Iseg.x + 1) * ny].x.x;
-        bds.lSeg.y.min = bdinfotb->bd[bds.Iseg.y].x.y;
-        bds.lSeg.y.max = bdinfotb->bd[bds.Iseg.y + 1].x.y;
+        bds.lSeg.x.min = BdryGridX(bdinfotb, bds.Iseg.x);
+        bds.lSeg.x.max = BdryGridX(bdinfotb, bds.Iseg.x + 1);
+        bds.lSeg.y.min = BdryGridY(bdinfotb, bds.Iseg.y);
+        bds.lSeg.y.max = BdryGridY(bdinfotb, bds.Iseg.y + 1);
 
-        bds.x    = bdinfotb->bd[bds.Iseg.x * ny + bds.Iseg.y].x;
-        bds.xmid = (bds.x + bdinfotb->bd[(bds.Iseg.x + 1) * ny + (bds.Iseg.y + 1)].x)
+        bds.x    = BdryNodeX(bdinfotb, bds.Iseg.x, bds.Iseg.y);
+        bds.xmid = (bds.x + BdryNodeX(bdinfotb, bds.Iseg.x + 1, bds.Iseg.y + 1))
             * RL(0.5);
 
         // printf("Iseg%s %d %d\n", isTop ? "Top" : "Bot", bds.Iseg.x+1, bds.Iseg.y+1);
@@ -155,7 +275,12 @@ template<bool O3D> HOST_DEVICE inline void GetBdrySeg(
             bds.td.side = over_diag_amount >= RL(0.0);
         }
         bds.td.justSteppedTo = false;
-        if(!bds.td.side) {
+        if(bdinfotb->bd == nullptr) {
+            bds.n = BdryTriNormal(
+                bds.x, BdryNodeX(bdinfotb, bds.Iseg.x + 1, bds.Iseg.y),
+                BdryNodeX(bdinfotb, bds.Iseg.x + 1, bds.Iseg.y + 1),
+                BdryNodeX(bdinfotb, bds.Iseg.x, bds.Iseg.y + 1), bds.td.side, isTop);
+        } else if(!bds.td.side) {
             bds.n = bdinfotb->bd[bds.Iseg.x * ny + bds.Iseg.y].n1;
         } else {
             bds.n = bdinfotb->bd[bds.Iseg.x * ny + bds.Iseg.y].n2;
@@ -19,6 +19,7 @@ this program. If not, see <https://www.gnu.org/licenses/>.
 #include "common_setup.hpp"
 
 static bhc::bhcInit init;
+static bool writeMetrics = false;
 
 template<bool O3D, bool R3D> int mainmain()
 {
@@ -27,6 +28,7 @@ template<bool O3D, bool R3D> int mainmain()
     if(!bhc::setup<O3D, R3D>(init, params, outputs)) return 1;
     if(!bhc::run<O3D, R3D>(params, outputs)) return 1;
     if(!bhc::writeout<O3D, R3D>(params, outputs, nullptr)) return 1;
+    if(writeMetrics && !bhc::writemetrics<O3D, R3D>(params, outputs, nullptr)) return 1;
     bhc::finalize<O3D, R3D>(params, outputs);
     return 0;
 }
@@ -69,6 +71,51 @@ void showhelp(const char *argv0)
            "-copy, -raycopy: Sets the behavior when there is insufficient memory to\n"
            "    allocate the requested number of full-size rays. See "
            "bhcInit::useRayCopyMode\n    in <bhc/structs.hpp> for more details\n"
+           "-compact, -compactrays: Stores only the ray coordinates (as float) for\n"
+           "    ray and eigenray runs, to fit many more rays in memory. See\n"
+           "    bhcInit::compactRays in <bhc/structs.hpp> for more details\n"
+           "-stream, -streamrays: Writes the ray file while the rays are being\n"
+           "    traced, without storing all the rays in memory. See\n"
+           "    bhcInit::streamRays in <bhc/structs.hpp> for more details\n"
+           "-binaryrays, -rayb: Writes the ray file in an indexed binary format,\n"
+           "    FileRoot.rayb, instead of text. See bhcInit::binaryRayFile and\n"
+           "    bhc::RayFileHeader in <bhc/structs.hpp> for more details\n"
+           "-streamtl: Writes the TL shade file in tiles of sources while the run\n"
+           "    is going on, so the memory used does not depend on the number of\n"
+           "    sources. See bhcInit::streamTL in <bhc/structs.hpp>\n"
+           "-tldb: Also computes TL in dB during postprocessing and writes it to\n"
+           "    FileRoot.tl. See bhcInit::tlDB in <bhc/structs.hpp>\n"
+           "-tlphase: Like -tldb, and also writes the phase of the pressure. See\n"
+           "    bhcInit::tlPhase in <bhc/structs.hpp>\n"
+           "-deterministic, -reproducible: Sums TL field contributions in a fixed\n"
+           "    ray order, so results are bit-identical for any number of threads\n"
+           "    and any memory limit, for the same -fieldtiles. The default does\n"
+           "    the same, but uses fewer tiles instead of failing if memory is short\n"
+           "-fieldtiles=N: Number of TL field tiles (default 64).\n"
+           "    Results depend on it; at most N threads trace at once. See\n"
+           "    bhcInit::deterministicTiles in <bhc/structs.hpp>\n"
+           "-atomic: Always sums TL field contributions with atomic adds (least\n"
+           "    memory, results may differ in the last bits between runs). See\n"
+           "    bhc::FieldAccumulation in <bhc/structs.hpp> for more details\n"
+           "-perthread: Sums TL field contributions into one field tile per thread,\n"
+           "    with the rays scheduled dynamically (results may differ in the last\n"
+           "    bits between runs)\n"
+           "-packets: Traces packets of rays together with SIMD instructions\n"
+           "    (2D, 1D SSP). See bhcInit::rayPackets in <bhc/structs.hpp>\n"
+           "-mixed, -mixedprecision: Traces rays in full precision but evaluates\n"
+           "    TL contributions in float. See bhc::Precision in <bhc/structs.hpp>\n"
+           "-realfield: Stores the field of incoherent and semi-coherent TL runs as\n"
+           "    real intensity, in half the memory. See bhcInit::realTLField in\n"
+           "    <bhc/structs.hpp>\n"
+           "-compactbdry: Stores only the depths (as float) of 3D/Nx2D altimetry and\n"
+           "    bathymetry, for very large grids. See bhcInit::compactBdry in\n"
+           "    <bhc/structs.hpp>\n"
+           "-hsrefltable=X: Tabulates the reflection coefficients of acousto-elastic\n"
+           "    halfspaces with a resolution of X degrees instead of computing them\n"
+           "    at every bounce. See bhcInit::hsReflTableRes in <bhc/structs.hpp>\n"
+           "-metrics: Writes timings and work counts of the run to\n"
+           "    FileRoot.metrics.json. See bhc::RunMetrics in <bhc/structs.hpp>\n"
+           "-pin, -pinthreads: Binds each worker thread to one logical core\n"
 #if BHC_BUILD_CUDA
            "-gpu=N, -device=N: Selects CUDA device N\n"
 #endif
@@ -102,6 +149,37 @@ int main(int argc, char **argv)
                 dimmode = 3;
             } else if(s == "-copy" || s == "-raycopy") {
                 init.useRayCopyMode = true;
+            } else if(s == "-compact" || s == "-compactrays") {
+                init.compactRays = true;
+            } else if(s == "-stream" || s == "-streamrays") {
+                init.streamRays = true;
+            } else if(s == "-binaryrays" || s == "-rayb") {
+                init.binaryRayFile = true;
+            } else if(s == "-streamtl") {
+                init.streamTL = true;
+            } else if(s == "-tldb") {
+                init.tlDB = true;
+            } else if(s == "-tlphase") {
+                init.tlDB    = true;
+                init.tlPhase = true;
+            } else if(s == "-deterministic" || s == "-reproducible") {
+                init.fieldAccumulation = bhc::FieldAccumulation::Deterministic;
+            } else if(s == "-atomic") {
+                init.fieldAccumulation = bhc::FieldAccumulation::Atomic;
+            } else if(s == "-perthread") {
+                init.fieldAccumulation = bhc::FieldAccumulation::PerThread;
+            } else if(s == "-packets") {
+                init.rayPackets = true;
+            } else if(s == "-mixed" || s == "-mixedprecision") {
+                init.precision = bhc::Precision::Mixed;
+            } else if(s == "-realfield") {
+                init.realTLField = true;
+            } else if(s == "-compactbdry") {
+                init.compactBdry = true;
+            } else if(s == "-metrics") {
+                writeMetrics = true;
+            } else if(s == "-pin" || s == "-pinthreads") {
+                init.pinThreads = true;
             } else if(s == "-?" || s == "-h" || s == "-help") {
                 showhelp(argv[0]);
                 return 0;
@@ -149,6 +227,22 @@ int main(int argc, char **argv)
                         return 1;
                     }
                     init.maxMemory = multiplier * std::stoi(value);
+                } else if(key == "-hsrefltable") {
+                    if(!bhc::isReal(value)) {
+                        std::cout << "Value \"" << value
+                                  << "\" for --hsrefltable argument is invalid, try "
+                                  << argv[0] << " --help\n";
+                        return 1;
+                    }
+                    init.hsReflTableRes = std::stod(value);
+                } else if(key == "-fieldtiles") {
+                    if(!bhc::isInt(value, false)) {
+                        std::cout << "Value \"" << value
+                                  << "\" for --fieldtiles argument is invalid, try "
+                                  << argv[0] << " --help\n";
+                        return 1;
+                    }
+                    init.deterministicTiles = std::stoi(value);
                 } else {
                     std::cout << "Unknown command-line option \"-" << key << "=" << value
                               << "\", try " << argv[0] << " --help\n";
@@ -40,6 +40,9 @@ this program. If not, see <https://www.gnu.org/licenses/>.
 #include <cstdarg>
 #include <chrono>
 #include <thread>
+#include <mutex>
+#include <vector>
+#include <type_traits>
 
 #define GLM_FORCE_EXPLICIT_CTOR 1
 #include <glm/common.hpp>
@@ -392,12 +395,19 @@ HOST_DEVICE inline size_t GetFieldAddr(
     // clang-format on
 }
 
+HOST_DEVICE inline size_t GetFieldSize(const Position *Pos)
+{
+    return GetFieldAddr(0, 0, Pos->NSz, 0, 0, 0, Pos);
+}
+
 } // namespace bhc
 
 #define _BHC_INCLUDING_COMPONENTS_ 1
 #include "util/errors.hpp"
 #include "util/prtfileemu.hpp"
 #include "util/timing.hpp"
+#include "util/scheduler.hpp"
+#include "util/threadpool.hpp"
 #include "runtype.hpp"
 #undef _BHC_INCLUDING_COMPONENTS_
 
@@ -407,16 +417,107 @@ namespace bhc {
 // Internal
 ////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Ray paths kept from the last field run for bhcInit::cacheRays. rays is an
+ * array of CachedRay<O3D, R3D>, one per job, whose points are stored in chunks.
+ * See mode/raycache.hpp.
+ */
+struct RayCacheState {
+    enum class Mode {
+        /// Not in use for this run.
+        Off,
+        /// This run traces the rays and stores them.
+        Record,
+        /// This run only applies the stored rays to the (new) receivers.
+        Replay,
+    };
+    Mode mode = Mode::Off;
+    /// Hash of all the inputs the rays depend on (everything except receivers).
+    uint64_t key      = 0;
+    uint8_t *rays     = nullptr;
+    int32_t numRays   = 0;
+    int32_t numCached = 0;
+    /// Whether the run which recorded the rays completed successfully.
+    bool valid = false;
+    std::mutex mutex;
+    std::vector<uint8_t *> chunks;
+    size_t chunkUsed = 0, chunkCapacity = 0;
+    /// Memory the chunks may take in total, set at the start of the run.
+    size_t budget = 0;
+    /// Memory used by rays and chunks, including pendingMemory.
+    size_t memory = 0;
+    /// Memory of the chunks allocated during the run, which is not yet counted
+    /// in bhcInternal::usedMemory (see StoreCachedRay).
+    size_t pendingMemory = 0;
+    /// Each worker's buffer for the points of the ray it is recording, only
+    /// allocated during the run (not counted in memory).
+    uint8_t *pointBuffers = nullptr;
+};
+
+/**
+ * Work counters of one worker thread for RunMetrics. The tracing functions add
+ * to these at the end of each ray, so no atomics are needed; they are summed
+ * into the metrics after the run.
+ */
+struct alignas(64) RayCounters {
+    int64_t rays, steps, reflections, smallSteps, influenceEvals, receiverHits;
+};
+
 struct bhcInternal {
     void (*outputCallback)(const char *message);
     std::string FileRoot;
     PrintFileEmu PRTFile;
-    std::atomic<int32_t> sharedJobID;
+    JobScheduler scheduler;
+    // Worker threads, either ownThreadPool or a pool shared with other
+    // instances (bhcInit::threadPool).
+    bhcThreadPool ownThreadPool;
+    bhcThreadPool *threadPool;
+    // Thread-private TL field tiles 1 through numFieldTiles - 1 (tile 0 is
+    // uAllSources itself), or numFieldTiles == 0 if not in use. See TL. Stored
+    // as floats: two per receiver, or one for a real field (UsesRealField).
+    float *fieldTiles;
+    int32_t numFieldTiles;
+    // Chunks of compact ray storage, allocated as needed during the run. The
+    // last chunk has rayChunkUsed of rayChunkCapacity floats in use. See Ray.
+    std::mutex rayChunkMutex;
+    std::vector<float *> rayChunks;
+    size_t rayChunkUsed, rayChunkCapacity;
+    // See RayCacheState.
+    RayCacheState rayCache;
+    // One per worker thread, see RayCounters.
+    std::vector<RayCounters> rayCounters;
     int gpuIndex, d_multiprocs; // d_warp, d_maxthreads
     int32_t numThreads;
     size_t maxMemory;
     size_t usedMemory;
+    size_t peakMemory;
     bool useRayCopyMode;
+    bool compactRays;
+    bool cacheRays;
+    // Whether run() has validated and preprocessed all the modules once, after
+    // which it only redoes the ones whose inputs are dirty if
+    // preprocessDirtyOnly is set.
+    bool preprocessDirtyOnly;
+    bool modulesPreprocessed;
+    bool streamRays;
+    bool binaryRayFile;
+    bool streamTL;
+    // Streamed TL runs: number of sources in x, y, and z of each tile, see
+    // bhcInit::streamTL and RunStreamedTL.
+    int32_t streamTileNS[3];
+    // Streamed TL runs, while a tile is traced: the Position of all the
+    // sources (else nullptr), and the first source of the tile in x, y, and z.
+    const Position *streamPos;
+    int32_t streamTileS0[3];
+    bool tlDB;
+    bool tlPhase;
+    bool rayPackets;
+    Precision precision;
+    bool realTLField;
+    bool compactBdry;
+    double hsReflTableRes;
+    FieldAccumulation fieldAccumulation;
+    int32_t deterministicTiles;
     bool noEnvFil;
     uint8_t dim;
 
@@ -425,13 +526,32 @@ struct bhcInternal {
           FileRoot(
               init.FileRoot == nullptr ? "error_incorrect_use_of_" BHC_PROGRAMNAME
                                        : init.FileRoot),
-          PRTFile(this, this->FileRoot, init.prtCallback), gpuIndex(init.gpuIndex),
+          PRTFile(this, this->FileRoot, init.prtCallback), fieldTiles(nullptr),
+          numFieldTiles(0), rayChunkUsed(0), rayChunkCapacity(0),
+          gpuIndex(init.gpuIndex),
           numThreads(ModifyNumThreads(init.numThreads)), maxMemory(init.maxMemory),
-          usedMemory(0), useRayCopyMode(init.useRayCopyMode),
+          usedMemory(0), peakMemory(0), useRayCopyMode(init.useRayCopyMode),
+          compactRays(init.compactRays), cacheRays(init.cacheRays),
+          preprocessDirtyOnly(init.preprocessDirtyOnly), modulesPreprocessed(false),
+          streamRays(init.streamRays),
+          binaryRayFile(init.binaryRayFile), streamTL(init.streamTL),
+          streamPos(nullptr), tlDB(init.tlDB),
+          tlPhase(init.tlPhase), rayPackets(init.rayPackets), precision(init.precision),
+          realTLField(init.realTLField), compactBdry(init.compactBdry),
+          hsReflTableRes(init.hsReflTableRes), fieldAccumulation(init.fieldAccumulation),
+          deterministicTiles(init.deterministicTiles),
           noEnvFil(init.FileRoot == nullptr), dim(r3d       ? 3
                                                       : o3d ? 4
                                                             : 2)
-    {}
+    {
+        if(init.threadPool != nullptr) {
+            threadPool = init.threadPool;
+            numThreads = threadPool->NumThreads();
+        } else {
+            threadPool = &ownThreadPool;
+            ownThreadPool.Start(numThreads, init.pinThreads);
+        }
+    }
 };
 
 template<bool O3D> inline bhcInternal *GetInternal(const bhcParams<O3D> &params)
@@ -439,4 +559,47 @@ template<bool O3D> inline bhcInternal *GetInternal(const bhcParams<O3D> &params)
     return reinterpret_cast<bhcInternal *>(params.internal);
 }
 
+/**
+ * Index among all the sources of the run, in the order of the jobs (see
+ * GetJobIndices), of source src of Pos (counted in the same order). Pos is the
+ * tile being traced in a streamed TL run (see RunStreamedTL), else the same.
+ */
+template<bool O3D> inline int32_t GetRunSourceIndex(
+    const bhcInternal *internal, const Position *Pos, int32_t src)
+{
+    const Position *all = internal->streamPos;
+    if(all == nullptr) return src;
+    const int32_t *s0 = internal->streamTileS0;
+    if constexpr(O3D) {
+        int32_t isy = src % Pos->NSy + s0[1];
+        src /= Pos->NSy;
+        int32_t isx = src % Pos->NSx + s0[0];
+        int32_t isz = src / Pos->NSx + s0[2];
+        return (isz * all->NSx + isx) * all->NSy + isy;
+    } else {
+        return src + s0[2];
+    }
+}
+
+/**
+ * Whether the TL field is accumulated into a fixed number of field tiles, each
+ * tracing every numFieldTiles'th ray in order (FieldAccumulation::Auto and
+ * Deterministic), rather than into one tile per worker (PerThread).
+ */
+inline bool HasFixedFieldTiles(const bhcInternal *internal)
+{
+    return internal->fieldAccumulation == FieldAccumulation::Auto
+        || internal->fieldAccumulation == FieldAccumulation::Deterministic;
+}
+
+/**
+ * Whether the TL field of this run is real intensity (float,
+ * bhcOutputs::uAllSourcesReal) instead of complex pressure; see
+ * bhcInit::realTLField.
+ */
+template<bool O3D> inline bool UsesRealField(const bhcParams<O3D> &params)
+{
+    return GetInternal(params)->realTLField && IsRealFieldRun(params.Beam);
+}
+
 } // namespace bhc
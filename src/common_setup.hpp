@@ -138,6 +138,7 @@ inline bool endswith(const std::string &source, const std::string &target)
 #include "util/ldio.hpp"
 #include "util/directio.hpp"
 #include "util/unformattedio.hpp"
+#include "util/streamwriter.hpp"
 #undef _BHC_INCLUDING_COMPONENTS_
 
 namespace bhc {
@@ -181,6 +182,8 @@ template<bool O3D, typename T> inline void trackallocate(
 #endif
     *ptr2 = s2;
     GetInternal(params)->usedMemory += s2;
+    GetInternal(params)->peakMemory = bhc::max(
+        GetInternal(params)->peakMemory, GetInternal(params)->usedMemory);
     ptr = (T *)(ptr2 + 2);
 #ifdef BHC_DEBUG
     // Debugging: Fill memory with garbage data to help detect uninitialized vars
@@ -188,6 +188,188 @@ HOST_DEVICE inline bool Compute_M_N_R_IR(
     return false;
 }
 
+/**
+ * LP: The receiver depths [iz0, iz1) which may be within [zmin, zmax], found
+ * by binary search if Pos->RzSorted. This may include extra depths (all of
+ * them if the depths are not sorted or the window is NaN), so the influence
+ * functions still test each depth; it only skips the ones which cannot pass.
+ */
+HOST_DEVICE inline void RcvrDepthSlice(
+    int32_t &iz0, int32_t &iz1, real zmin, real zmax, const Position *Pos)
+{
+    iz0 = 0;
+    iz1 = Pos->NRz_per_range;
+    if(!Pos->RzSorted || !(zmin <= zmax) || iz1 <= 1) return;
+    iz0 = BinarySearchGEQ(Pos->Rz, iz1, 1, 0, zmin);
+    iz1 = BinarySearchLEQ(Pos->Rz, iz1, 1, 0, zmax) + 1;
+    // The searches return the end element if no element satisfies them
+    if((real)Pos->Rz[iz0] < zmin || (real)Pos->Rz[iz1 - 1] > zmax || iz1 < iz0) {
+        iz1 = iz0;
+    }
+}
+
+/**
+ * LP: The depth window [zmin, zmax] outside of which no receiver is within
+ * normal distance R of a 2D ray-centered step from xA to xB, with ray normals
+ * raynA and raynB. If both normals point the same way in depth, a receiver
+ * more than R * |normal| above or below both ends is further than R from the
+ * ray along either normal, and so along any normal interpolated between them.
+ * Otherwise the window is NaN, which RcvrDepthSlice treats as all depths.
+ */
+HOST_DEVICE inline void RayCenDepthWindow(
+    real &zmin, real &zmax, const vec2 &xA, const vec2 &raynA, const vec2 &xB,
+    const vec2 &raynB, real R)
+{
+    zmin = zmax = NAN;
+    if(DEP(raynA) * DEP(raynB) > RL(0.0)) {
+        // Padded so that rounding cannot exclude any depth the test accepts
+        R *= FL(1.01) * bhc::max(glm::length(raynA), glm::length(raynB));
+        zmin = bhc::min(DEP(xA), DEP(xB)) - R;
+        zmax = bhc::max(DEP(xA), DEP(xB)) + R;
+    }
+}
+
+/**
+ * LP: The receiver bearings Step_InfluenceGeoCart tests in 3D for one ray step at
+ * one receiver range: the ranges of itheta [lo, hi), in increasing order of
+ * itheta so that eigenrays and arrivals are recorded in the same order as when
+ * testing every bearing. They are found from angular intervals with
+ * Pos->thetaIndex and may include extra bearings; the per-bearing tests still
+ * decide which receivers the step affects.
+ */
+struct BearingRanges {
+    int32_t n, cur;
+    int32_t lo[4], hi[4];
+};
+
+HOST_DEVICE inline void AddBearingRange(BearingRanges &br, int32_t lo, int32_t hi)
+{
+    if(lo >= hi) return;
+    int32_t i = br.n++;
+    // Insertion sort, then merge with the previous ranges if they overlap
+    for(; i > 0 && br.lo[i - 1] > lo; --i) {
+        br.lo[i] = br.lo[i - 1];
+        br.hi[i] = br.hi[i - 1];
+    }
+    br.lo[i] = lo;
+    br.hi[i] = hi;
+    int32_t m = 0;
+    for(int32_t j = 1; j < br.n; ++j) {
+        if(br.lo[j] <= br.hi[m]) {
+            br.hi[m] = bhc::max(br.hi[m], br.hi[j]);
+        } else {
+            ++m;
+            br.lo[m] = br.lo[j];
+            br.hi[m] = br.hi[j];
+        }
+    }
+    br.n = m + 1;
+}
+
+/**
+ * Adds the bearings in the angular interval [a, b] (radians, b >= a).
+ */
+HOST_DEVICE inline void AddBearingArc(
+    BearingRanges &br, real a, real b, const Position *Pos)
+{
+    const real twoPi = RL(2.0) * REAL_PI;
+    if(b - a >= twoPi) {
+        AddBearingRange(br, 0, Pos->Ntheta);
+        return;
+    }
+    // Relative to theta[0], as in the index
+    real step = twoPi / (real)Pos->NthetaIndex;
+    real a0   = a - DegRad * (real)Pos->theta[0];
+    a0 -= twoPi * STD::floor(a0 / twoPi);
+    real b0    = a0 + (b - a);
+    int32_t ka = bhc::min((int32_t)(a0 / step), Pos->NthetaIndex - 1);
+    if(b0 < twoPi) {
+        int32_t kb = bhc::min((int32_t)(b0 / step), Pos->NthetaIndex - 1);
+        AddBearingRange(br, Pos->thetaIndex[ka], Pos->thetaIndex[kb + 1]);
+    } else {
+        int32_t kb = bhc::min((int32_t)((b0 - twoPi) / step), Pos->NthetaIndex - 1);
+        AddBearingRange(br, 0, Pos->thetaIndex[kb + 1]);
+        AddBearingRange(br, Pos->thetaIndex[ka], Pos->Ntheta);
+    }
+}
+
+/**
+ * Whether the angular intervals [a1, b1] and [a2, b2] overlap (mod 2 pi).
+ */
+HOST_DEVICE inline bool ArcsOverlap(real a1, real b1, real a2, real b2)
+{
+    const real twoPi = RL(2.0) * REAL_PI;
+    real d           = a2 - a1;
+    if(d - twoPi * STD::floor(d / twoPi) <= b1 - a1) return true;
+    d = a1 - a2;
+    return d - twoPi * STD::floor(d / twoPi) <= b2 - a2;
+}
+
+/**
+ * Bearings for Step_InfluenceGeoCart in 3D, for the receivers at range rcvrR.
+ * A bearing is tested only if it could pass both of its per-bearing tests:
+ * s >= 0 (receiver on the same side of the source as the ray point p, both
+ * relative to the source), which leaves half of the bearings, and for hat
+ * beams, m_prime <= W, the distance from the line of the step (horizontal
+ * direction u, not normalized) in the horizontal plane. With theta the
+ * bearing and phi the direction of u, the latter is
+ * |rcvrR * |u| * sin(theta - phi) - cross(u, p)| <= W,
+ * which is a narrow interval around phi (and its mirror image behind the
+ * source, which s >= 0 usually rules out).
+ * Gaussian beams get only the half-plane: their m_prime test is commented out,
+ * as in BELLHOP3D, and the beam window in InfluenceGeoCore (n1prime + n2prime,
+ * normalized by the beam widths) has no closed-form bound in bearing.
+ */
+HOST_DEVICE inline void BearingsGeoCart(
+    BearingRanges &br, real rcvrR, const vec2 &p, const vec2 &u, real W, bool hat,
+    const Position *Pos)
+{
+    br.n = br.cur = 0;
+    if(Pos->NthetaIndex == 0 || rcvrR <= RL(0.0) || (p.x == RL(0.0) && p.y == RL(0.0))) {
+        AddBearingRange(br, 0, Pos->Ntheta);
+        return;
+    }
+    // Margin for rounding, so that no bearing which passes the tests is missed
+    const real pad = RL(1e-5);
+    real thetaP    = STD::atan2(p.y, p.x);
+    real sLo       = thetaP - REAL_PI / RL(2.0) - pad;
+    real sHi       = thetaP + REAL_PI / RL(2.0) + pad;
+    real ulen      = glm::length(u);
+    if(hat && ulen > RL(0.0)) {
+        real scale = rcvrR * ulen;
+        real c     = u.x * p.y - u.y * p.x;
+        real tol   = RL(1e-9) * (rcvrR + glm::length(p) + W) / scale;
+        real lo    = (c - W) / scale - tol;
+        real hi    = (c + W) / scale + tol;
+        if(lo > RL(1.0) || hi < RL(-1.0)) return; // no receiver within W
+        if(lo > RL(-1.0) || hi < RL(1.0)) {
+            real phi = STD::atan2(u.y, u.x);
+            real a1  = STD::asin(bhc::max(lo, RL(-1.0)));
+            real a2  = STD::asin(bhc::min(hi, RL(1.0)));
+            if(ArcsOverlap(phi + a1 - pad, phi + a2 + pad, sLo, sHi)) {
+                AddBearingArc(br, phi + a1 - pad, phi + a2 + pad, Pos);
+            }
+            real b1 = phi + REAL_PI - a2 - pad, b2 = phi + REAL_PI - a1 + pad;
+            if(ArcsOverlap(b1, b2, sLo, sHi)) AddBearingArc(br, b1, b2, Pos);
+            return;
+        }
+    }
+    AddBearingArc(br, sLo, sHi, Pos);
+}
+
+/**
+ * Advances itheta (initially -1) to the next bearing in br; false at the end.
+ */
+HOST_DEVICE inline bool NextBearing(BearingRanges &br, int32_t &itheta)
+{
+    ++itheta;
+    for(; br.cur < br.n; ++br.cur) {
+        if(itheta < br.lo[br.cur]) itheta = br.lo[br.cur];
+        if(itheta < br.hi[br.cur]) return true;
+    }
+    return false;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Cerveny-only helper functions
 ////////////////////////////////////////////////////////////////////////////////
@@ -420,22 +602,51 @@ template<bool R3D> HOST_DEVICE inline real FinalPhase(
 // Storing results
 ////////////////////////////////////////////////////////////////////////////////
 
-template<bool R3D> HOST_DEVICE inline void AddToField(
-    cpxf *uAllSources, const cpxf &dfield, int32_t itheta, int32_t ir, int32_t iz,
+/**
+ * LP: FT is the field element type, see RunType::FieldT. A real field only
+ * stores intensities, the real part of dfield.
+ */
+template<bool R3D, typename FT> HOST_DEVICE inline void AddToField(
+    FT *uAllSources, const cpxf &dfield, int32_t itheta, int32_t ir, int32_t iz,
     const InfluenceRayInfo<R3D> &inflray, const Position *Pos)
 {
     size_t base = GetFieldAddr(
         inflray.init.isx, inflray.init.isy, inflray.init.isz, itheta, iz, ir, Pos);
-    AtomicAddCpx(&uAllSources[base], dfield);
+    if constexpr(std::is_same<FT, float>::value) {
+        if(inflray.privateField) {
+            uAllSources[base] += dfield.real();
+        } else {
+            AtomicAddReal(&uAllSources[base], dfield.real());
+        }
+    } else if(inflray.privateField) {
+        uAllSources[base] += dfield;
+    } else {
+        AtomicAddCpx(&uAllSources[base], dfield);
+    }
+}
+
+/**
+ * LP: cnst * w * exp(-J * (omega * delay - phaseInt)), evaluated in float
+ * (Precision::Mixed). omega * delay is often thousands of radians, which float
+ * cannot resolve, so the phase is reduced to one cycle in real first.
+ */
+HOST_DEVICE inline cpxf CoherentContributionMixed(
+    real cnst, real w, real omega, const cpx &delay, real phaseInt)
+{
+    real phase = omega * delay.real() - phaseInt;
+    phase -= RL(2.0) * REAL_PI * STD::floor(phase / (RL(2.0) * REAL_PI) + RL(0.5));
+    float amp = (float)(cnst * w) * STD::exp((float)(omega * delay.imag()));
+    return cpxf(amp * STD::cos((float)phase), -amp * STD::sin((float)phase));
 }
 
 template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline void ApplyContribution(
-    cpxf *uAllSources, real cnst, real w, real omega, cpx delay, real phaseInt,
-    real RcvrDeclAngle, real RcvrAzimAngle, int32_t itheta, int32_t ir, int32_t iz,
-    int32_t is, const InfluenceRayInfo<R3D> &inflray, const rayPt<R3D> &point1,
+    typename CFG::run::FieldT *uAllSources, real cnst, real w, real omega, cpx delay,
+    real phaseInt, real RcvrDeclAngle, real RcvrAzimAngle, int32_t itheta, int32_t ir,
+    int32_t iz, int32_t is, InfluenceRayInfo<R3D> &inflray, const rayPt<R3D> &point1,
     const Position *Pos, const BeamStructure<O3D> *Beam, EigenInfo *eigen,
     const ArrInfo *arrinfo)
 {
+    ++inflray.numHits;
     if constexpr(O3D && !R3D) { itheta = inflray.init.ibeta; }
     if constexpr(CFG::run::IsEigenrays()) {
         // eigenrays
@@ -447,12 +658,19 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline void ApplyContribu
             RcvrAzimAngle, point1.NumTopBnc, point1.NumBotBnc, arrinfo, Pos);
     } else {
         cpxf dfield;
-        if(IsCoherentRun(Beam)) {
+        if(IsCoherentRun(Beam) && inflray.mixedPrecision) {
+            dfield = CoherentContributionMixed(cnst, w, omega, delay, phaseInt);
+        } else if(IsCoherentRun(Beam)) {
             // coherent TL
             dfield = Cpx2Cpxf(cnst * w * STD::exp(-J * (omega * delay - phaseInt)));
             // printf("%20.17f %20.17f\n", dfield.real(), dfield.imag());
             // omega * SQ(n) / (FL(2.0) * SQ(point1.c) * delay)))) // curvature correction
             // [LP: 2D only]
+        } else if(inflray.mixedPrecision) {
+            float v = (float)cnst * STD::exp((float)(omega * delay.imag()));
+            v       = SQ(v) * (float)w;
+            if(IsGaussianGeomInfl(Beam)) v *= (float)GaussScaleFactor<R3D>();
+            dfield = cpxf(v, 0.0f);
         } else {
             // incoherent/semicoherent TL
             real v = cnst * STD::exp((omega * delay).imag());
@@ -522,20 +740,22 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline void Init_Influenc
     InfluenceRayInfo<R3D> &inflray, const rayPt<R3D> &point0, RayInitInfo &rinit,
     const VEC23<O3D> &gradc, const Position *Pos, const Origin<O3D, R3D> &org,
     [[maybe_unused]] const SSPStructure *ssp, SSPSegState &iSeg,
-    const AnglesStructure *Angles, const FreqInfo *freqinfo,
-    const BeamStructure<O3D> *Beam, ErrState *errState)
+    const AnglesStructure *Angles, real freq, const BeamStructure<O3D> *Beam,
+    ErrState *errState)
 {
     bool isGaussian = IsGaussianGeomInfl(Beam);
 
-    inflray.init  = rinit;
-    inflray.freq0 = freqinfo->freq0;
-    inflray.omega = FL(2.0) * REAL_PI * inflray.freq0;
-    inflray.c0    = point0.c;
-    inflray.xs    = point0.x;
+    inflray.init      = rinit;
+    inflray.freq0     = freq;
+    inflray.omega     = FL(2.0) * REAL_PI * inflray.freq0;
+    inflray.c0        = point0.c;
+    inflray.xs        = point0.x;
+    inflray.numEvals  = 0;
+    inflray.numHits   = 0;
     // LP: The 5x version is changed to 50x on both codepaths before it is used.
-    // inflray.RadMax = FL(5.0) * ccpx.real() / freqinfo->freq0; // 5 wavelength max
+    // inflray.RadMax = FL(5.0) * ccpx.real() / freq; // 5 wavelength max
     // radius
-    inflray.RadMax = FL(50.0) * point0.c / freqinfo->freq0; // 50 wavelength max radius
+    inflray.RadMax = FL(50.0) * point0.c / freq; // 50 wavelength max radius
     inflray.Dalpha = Angles->alpha.d;
     inflray.Dbeta  = Angles->beta.d;
 
@@ -648,9 +868,9 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline void Init_Influenc
  */
 template<typename CFG, bool O3D> HOST_DEVICE inline bool Step_InfluenceCervenyRayCen(
     const rayPt<false> &point0, const rayPt<false> &point1,
-    InfluenceRayInfo<false> &inflray, [[maybe_unused]] int32_t is, cpxf *uAllSources,
-    const BdryType *Bdry, const Position *Pos, const BeamStructure<O3D> *Beam,
-    ErrState *errState)
+    InfluenceRayInfo<false> &inflray, [[maybe_unused]] int32_t is,
+    typename CFG::run::FieldT *uAllSources, const BdryType *Bdry, const Position *Pos,
+    const BeamStructure<O3D> *Beam, ErrState *errState)
 {
     cpx eps0, eps1, pB0, pB1, qB0, qB1, gamma0, gamma1;
     // need to add logic related to NRz_per_range
@@ -683,7 +903,30 @@ template<typename CFG, bool O3D> HOST_DEVICE inline bool Step_InfluenceCervenyRa
     int32_t old_kmah = inflray.kmah;
     BranchCut<O3D>(qB0, qB1, inflray.kmah, Beam);
 
-    for(int32_t iz = 0; iz < Pos->NRz_per_range; ++iz) {
+    // LP: The beam window test below needs
+    // n^2 < 2 * iBeamWindow2 / (omega * -imag(gamma)), and -imag(gamma) is at
+    // least its smaller value at the two ends unless either is positive (in
+    // which case every depth is tested, so the unbounded beam warning is still
+    // raised). The images' windows are the true beam's reflected about the
+    // boundaries.
+    int32_t iz0 = 0, iz1 = Pos->NRz_per_range;
+    if(inflray.lastValid && gamma0.imag() <= RL(0.0) && gamma1.imag() <= RL(0.0)) {
+        real zmin, zmax;
+        real gmin = bhc::min(-gamma0.imag(), -gamma1.imag());
+        RayCenDepthWindow(
+            zmin, zmax, inflray.x, inflray.rayn1, point1.x, rayn1,
+            STD::sqrt(FL(2.0) * inflray.iBeamWindow2 / (inflray.omega * gmin)));
+        if(zmin <= zmax) {
+            real zlo = zmin, zhi = zmax;
+            for(int32_t image = 2; image <= Beam->Nimage; ++image) {
+                real zb = (image == 2) ? Bdry->Top.hs.Depth : Bdry->Bot.hs.Depth;
+                zlo     = bhc::min(zlo, FL(2.0) * zb - zmax);
+                zhi     = bhc::max(zhi, FL(2.0) * zb - zmin);
+            }
+            RcvrDepthSlice(iz0, iz1, zlo, zhi, Pos);
+        }
+    }
+    for(int32_t iz = iz0; iz < iz1; ++iz) {
         real zR = Pos->Rz[iz];
 
         for(int32_t image = 1; image <= Beam->Nimage; ++image) {
@@ -754,6 +997,7 @@ template<typename CFG, bool O3D> HOST_DEVICE inline bool Step_InfluenceCervenyRa
                         AddToField<false>(
                             uAllSources, Cpx2Cpxf(contri), O3D ? inflray.init.ibeta : 0,
                             ir, iz, inflray, Pos);
+                        ++inflray.numHits;
                     }
                 }
             }
@@ -771,9 +1015,10 @@ template<typename CFG, bool O3D> HOST_DEVICE inline bool Step_InfluenceCervenyRa
  */
 template<typename CFG, bool O3D> HOST_DEVICE inline bool Step_InfluenceCervenyCart(
     const rayPt<false> &point0, const rayPt<false> &point1,
-    InfluenceRayInfo<false> &inflray, int32_t is, cpxf *uAllSources, const BdryType *Bdry,
-    const Origin<O3D, false> &org, const SSPStructure *ssp, SSPSegState &iSeg,
-    const Position *Pos, const BeamStructure<O3D> *Beam, ErrState *errState)
+    InfluenceRayInfo<false> &inflray, int32_t is, typename CFG::run::FieldT *uAllSources,
+    const BdryType *Bdry, const Origin<O3D, false> &org, const SSPStructure *ssp,
+    SSPSegState &iSeg, const Position *Pos, const BeamStructure<O3D> *Beam,
+    ErrState *errState)
 {
     cpx eps0, eps1, pB0, pB1, qB0, qB1, gamma0, gamma1;
     real zR;
@@ -837,7 +1082,24 @@ template<typename CFG, bool O3D> HOST_DEVICE inline bool Step_InfluenceCervenyCa
         BranchCut<O3D>(qB0, q, kmah, Beam);
         if(kmah < 0) cnst = -cnst;
 
-        for(int32_t iz = 0; iz < Pos->NRz_per_range; ++iz) {
+        // LP: Depths at least 2 * RadMax from every image of the beam have
+        // Hermite() == 0, i.e. zero contribution, so they are skipped. The
+        // window is a bit wider so that rounding cannot exclude any others.
+        int32_t iz0 = 0, iz1 = Pos->NRz_per_range;
+        if(Beam->Nimage <= 3) {
+            real zwin = FL(2.02) * inflray.RadMax;
+            real zmin = x.y - zwin, zmax = x.y + zwin;
+            if(Beam->Nimage >= 2) {
+                zmin = bhc::min(zmin, FL(2.0) * Bdry->Top.hs.Depth - x.y - zwin);
+                zmax = bhc::max(zmax, FL(2.0) * Bdry->Top.hs.Depth - x.y + zwin);
+            }
+            if(Beam->Nimage >= 3) {
+                zmin = bhc::min(zmin, FL(2.0) * Bdry->Bot.hs.Depth - x.y - zwin);
+                zmax = bhc::max(zmax, FL(2.0) * Bdry->Bot.hs.Depth - x.y + zwin);
+            }
+            RcvrDepthSlice(iz0, iz1, zmin, zmax, Pos);
+        }
+        for(int32_t iz = iz0; iz < iz1; ++iz) {
             zR = Pos->Rz[iz];
 
             cpx contri = FL(0.0);
@@ -876,6 +1138,7 @@ template<typename CFG, bool O3D> HOST_DEVICE inline bool Step_InfluenceCervenyCa
             AddToField<false>(
                 uAllSources, Cpx2Cpxf(contri), O3D ? inflray.init.ibeta : 0, ir, iz,
                 inflray, Pos);
+            ++inflray.numHits;
         }
     }
 
@@ -894,8 +1157,9 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline void InfluenceGeoC
     real s, real n1, [[maybe_unused]] real n2, const V2M2<R3D> &dq, const cpx &dtau,
     int32_t itheta, int32_t ir, int32_t iz, int32_t is, const rayPt<R3D> &point0,
     const rayPt<R3D> &point1, real RcvrDeclAngle, real RcvrAzimAngle,
-    const InfluenceRayInfo<R3D> &inflray, cpxf *uAllSources, const Position *Pos,
-    const BeamStructure<O3D> *Beam, EigenInfo *eigen, const ArrInfo *arrinfo)
+    InfluenceRayInfo<R3D> &inflray, typename CFG::run::FieldT *uAllSources,
+    const Position *Pos, const BeamStructure<O3D> *Beam, EigenInfo *eigen,
+    const ArrInfo *arrinfo)
 {
     static_assert(
         CFG::infl::IsGeometric(), "InfluenceGeoCore templated with non-geometric type!");
@@ -988,13 +1252,17 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline void InfluenceGeoC
     real cnst = inflray.Ratio1 * cfactor * point1.Amp / STD::sqrt(STD::abs(qFinal));
     real w;
     if constexpr(R3D) {
-        if(isGaussian) {
+        if(isGaussian && inflray.mixedPrecision) {
+            w = STD::exp(FL(-0.5) * (float)(SQ(n1prime) + SQ(n2prime)));
+        } else if(isGaussian) {
             w = STD::exp(FL(-0.5) * (SQ(n1prime) + SQ(n2prime)));
         } else {
             w = (FL(1.0) - n1prime) * (FL(1.0) - n2prime);
         }
     } else {
-        if(isGaussian) {
+        if(isGaussian && inflray.mixedPrecision) {
+            w = STD::exp(FL(-0.5) * (float)SQ(n1prime / sigma)) * (sigma_orig / sigma);
+        } else if(isGaussian) {
             // Gaussian decay
             w = STD::exp(FL(-0.5) * SQ(n1prime / sigma)) * (sigma_orig / sigma);
         } else {
@@ -1026,8 +1294,8 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline void InfluenceGeoC
 template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline bool
 Step_InfluenceGeoRayCen(
     const rayPt<R3D> &point0, const rayPt<R3D> &point1, InfluenceRayInfo<R3D> &inflray,
-    int32_t is, cpxf *uAllSources, const Position *Pos, const BeamStructure<O3D> *Beam,
-    EigenInfo *eigen, const ArrInfo *arrinfo)
+    int32_t is, typename CFG::run::FieldT *uAllSources, const Position *Pos,
+    const BeamStructure<O3D> *Beam, EigenInfo *eigen, const ArrInfo *arrinfo)
 {
     real phaseq = QScalar(point0.q);
     IncPhaseIfCaustic<R3D>(inflray, phaseq, true);
@@ -1068,7 +1336,26 @@ Step_InfluenceGeoRayCen(
     // During reflection imag(q) is constant and adjacent normals cannot bracket
     // a segment of the TL line, so no special treatment is necessary
 
-    for(int32_t iz = 0; iz < Pos->NRz_per_range; ++iz) {
+    // LP: In 2D, a receiver is only affected if it is within BeamWindow * sigma
+    // of the ray along the interpolated normal, and sigma is largest at the end
+    // with the larger |q|. Before the first valid step, nA is a placeholder, so
+    // every depth is tested. In 3D, every depth is tested: the distance is
+    // measured in each bearing's plane, and the Gaussian window test is not
+    // applied at all.
+    int32_t iz0 = 0, iz1 = Pos->NRz_per_range;
+    if constexpr(!R3D) {
+        if(inflray.lastValid) {
+            real zmin, zmax;
+            real sigma = STD::abs(
+                bhc::max(STD::abs(point0.q.x), STD::abs(point1.q.x)) * inflray.rcp_q0);
+            AdjustSigma<CFG, O3D, R3D>(sigma, point0, point1, inflray, Beam);
+            RayCenDepthWindow(
+                zmin, zmax, inflray.x, inflray.rayn1, point1.x, rayn1,
+                inflray.BeamWindow * sigma);
+            RcvrDepthSlice(iz0, iz1, zmin, zmax, Pos);
+        }
+    }
+    for(int32_t iz = iz0; iz < iz1; ++iz) {
         real zR = Pos->Rz[iz];
 
         [[maybe_unused]] vec3 xtA, xtB, xtxe1A, xtxe1B, xtxe2A, xtxe2B;
@@ -1078,6 +1365,9 @@ Step_InfluenceGeoRayCen(
             Compute_RayCenCross(xtB, xtxe1B, xtxe2B, point1.x, rayn1, rayn2, zR, inflray);
         }
 
+        // LP: Every bearing is tested here (no BearingRanges): which bearings
+        // the step affects depends on where the normal planes at both ends cut
+        // each bearing, which has no safe closed-form angular interval.
         int32_t itheta = -1;
         do {
             ++itheta;
@@ -1196,8 +1486,8 @@ Step_InfluenceGeoRayCen(
  */
 template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline bool Step_InfluenceGeoCart(
     const rayPt<R3D> &point0, const rayPt<R3D> &point1, InfluenceRayInfo<R3D> &inflray,
-    int32_t is, cpxf *uAllSources, const Position *Pos, const BeamStructure<O3D> *Beam,
-    EigenInfo *eigen, const ArrInfo *arrinfo)
+    int32_t is, typename CFG::run::FieldT *uAllSources, const Position *Pos,
+    const BeamStructure<O3D> *Beam, EigenInfo *eigen, const ArrInfo *arrinfo)
 {
     // LP: Replaced ScaleBeam in 3D with applying the same scale factors below.
     // This avoids modifying the ray and makes the codepaths more similar.
@@ -1294,14 +1584,19 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline bool Step_Influenc
         // which direction the ray goes, we only have to check this side.
         if(Pos->Rr[inflray.ir] >= bhc::min(rA, rB)
            && Pos->Rr[inflray.ir] < bhc::max(rA, rB)) {
-            [[maybe_unused]] int32_t itheta = -1;
+            [[maybe_unused]] int32_t itheta = R3D ? -1 : 0;
+            [[maybe_unused]] BearingRanges bearings;
+            if constexpr(R3D) {
+                BearingsGeoCart(
+                    bearings, Pos->Rr[inflray.ir], XYCOMP(x_ray) - XYCOMP(inflray.xs),
+                    XYCOMP(rayt), inflray.BeamWindow * L_diag, IsHatGeomInfl(Beam), Pos);
+            }
             do {
                 VEC23<R3D> x_rcvr;
 
-                ++itheta;
                 if constexpr(R3D) {
                     // LP: Loop logic
-                    if(itheta >= Pos->Ntheta) break;
+                    if(!NextBearing(bearings, itheta)) break;
 
                     vec2 t_rcvr = Pos->t_rcvr[itheta];
                     SETXY(
@@ -1355,7 +1650,12 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline bool Step_Influenc
                     x_rcvr.x = Pos->Rr[inflray.ir];
                 }
 
-                for(int32_t iz = 0; iz < Pos->NRz_per_range; ++iz) {
+                // LP: In an irregular grid, the one depth per range is Rz[ir].
+                int32_t iz0 = 0, iz1 = Pos->NRz_per_range;
+                if(R3D || !IsIrregularGrid(Beam)) {
+                    RcvrDepthSlice(iz0, iz1, zmin, zmax, Pos);
+                }
+                for(int32_t iz = iz0; iz < iz1; ++iz) {
                     int32_t tempiz = iz;
                     if constexpr(!R3D) {
                         if(IsIrregularGrid(Beam)) tempiz = inflray.ir;
@@ -1410,8 +1710,9 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline bool Step_Influenc
  */
 template<typename CFG, bool O3D> HOST_DEVICE inline bool Step_InfluenceSGB(
     const rayPt<false> &point0, const rayPt<false> &point1,
-    InfluenceRayInfo<false> &inflray, int32_t is, cpxf *uAllSources, const Position *Pos,
-    const BeamStructure<O3D> *Beam, EigenInfo *eigen, const ArrInfo *arrinfo)
+    InfluenceRayInfo<false> &inflray, int32_t is, typename CFG::run::FieldT *uAllSources,
+    const Position *Pos, const BeamStructure<O3D> *Beam, EigenInfo *eigen,
+    const ArrInfo *arrinfo)
 {
     real w;
     vec2 x, rayt;
@@ -1449,7 +1750,14 @@ template<typename CFG, bool O3D> HOST_DEVICE inline bool Step_InfluenceSGB(
 
         // printf("is ir %d %d\n", is, inflray.ir);
 
-        for(int32_t iz = 0; iz < Pos->NRz_per_range; ++iz) {
+        // LP: TL runs use every depth. The window is a bit wider than
+        // RadMax so that rounding cannot exclude any depth the test accepts.
+        int32_t iz0 = 0, iz1 = Pos->NRz_per_range;
+        if constexpr(!CFG::run::IsTL()) {
+            real zwin = FL(1.01) * inflray.RadMax;
+            RcvrDepthSlice(iz0, iz1, x.y - zwin, x.y + zwin, Pos);
+        }
+        for(int32_t iz = iz0; iz < iz1; ++iz) {
             real deltaz = Pos->Rz[iz] - x.y; // ray to rcvr distance
             // LP: Reinstated this condition for eigenrays and arrivals, as
             // without it every ray would be an eigenray / arrival.
@@ -1490,11 +1798,13 @@ template<typename CFG, bool O3D> HOST_DEVICE inline bool Step_InfluenceSGB(
  */
 template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline bool Step_Influence(
     const rayPt<R3D> &point0, const rayPt<R3D> &point1, InfluenceRayInfo<R3D> &inflray,
-    int32_t is, cpxf *uAllSources, [[maybe_unused]] const BdryType *Bdry,
-    const Origin<O3D, R3D> &org, [[maybe_unused]] const SSPStructure *ssp,
-    SSPSegState &iSeg, const Position *Pos, const BeamStructure<O3D> *Beam,
-    EigenInfo *eigen, const ArrInfo *arrinfo, ErrState *errState)
+    int32_t is, typename CFG::run::FieldT *uAllSources,
+    [[maybe_unused]] const BdryType *Bdry, const Origin<O3D, R3D> &org,
+    [[maybe_unused]] const SSPStructure *ssp, SSPSegState &iSeg, const Position *Pos,
+    const BeamStructure<O3D> *Beam, EigenInfo *eigen, const ArrInfo *arrinfo,
+    ErrState *errState)
 {
+    ++inflray.numEvals;
     // See PreRun_Influence, make sure these remain in sync.
     if constexpr(CFG::infl::IsCerveny()) {
         if constexpr(R3D) {
@@ -1535,6 +1845,15 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline bool Step_Influenc
 // Post-processing
 ////////////////////////////////////////////////////////////////////////////////
 
+HOST_DEVICE inline void ScaleField(cpxf &u, const cpxf &cnst) { u *= cnst; }
+HOST_DEVICE inline void ScaleField(float &u, const cpxf &cnst) { u *= cnst.real(); }
+
+HOST_DEVICE inline void IntensityToPressure(cpxf &u)
+{
+    u = cpxf(STD::sqrt(u.real()), 0.0f);
+}
+HOST_DEVICE inline void IntensityToPressure(float &u) { u = STD::sqrt(u); }
+
 /**
  * Scale the pressure field
  *
@@ -1542,16 +1861,21 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline bool Step_Influenc
  * Dalpha, Dbeta: angular spacing between rays
  * freq: source frequency
  * c: nominal sound speed
- * u [LP: 3D: P]: Pressure field (LP: [NRz][Nr])
+ * u [LP: 3D: P]: Pressure field (LP: [NRz][Nr]; float for the real intensity
+ * field of incoherent and semi-coherent runs, see bhcOutputs::uAllSourcesReal)
+ *
+ * LP: The rows of u (receiver bearings and depths) are independent, so u
+ * may also be any subset of consecutive rows, passed as Ntheta = 1 and NRz =
+ * the number of rows (see PostProcessTL).
  *
  * [LP: 3D only:] mbp: this routine should be eliminated
  * LP: The conversion of intensity to pressure can't be eliminated (moved into
  * the Influence* functions) because it must occur after the summing of
  * contributions from different rays/beams.
  */
-template<bool O3D, bool R3D> HOST_DEVICE inline void ScalePressure(
+template<bool O3D, bool R3D, typename FT> HOST_DEVICE inline void ScalePressure(
     real Dalpha, [[maybe_unused]] real Dbeta, real c, [[maybe_unused]] cpx epsilon1,
-    [[maybe_unused]] cpx epsilon2, float *r, cpxf *u, int32_t Ntheta, int32_t NRz,
+    [[maybe_unused]] cpx epsilon2, float *r, FT *u, int32_t Ntheta, int32_t NRz,
     int32_t Nr, real freq, const BeamStructure<O3D> *Beam)
 {
     real cnst;
@@ -1571,7 +1895,7 @@ template<bool O3D, bool R3D> HOST_DEVICE inline void ScalePressure(
                 for(int32_t irz = 0; irz < NRz; ++irz) {
                     for(int32_t ir = 0; ir < Nr; ++ir) {
                         size_t addr = ((size_t)itheta * NRz + irz) * Nr + ir;
-                        u[addr] *= Cpx2Cpxf(cnst3d);
+                        ScaleField(u[addr], Cpx2Cpxf(cnst3d));
                     }
                 }
             }
@@ -1586,37 +1910,44 @@ template<bool O3D, bool R3D> HOST_DEVICE inline void ScalePressure(
         }
     }
 
-    // For incoherent run, convert intensity to pressure
-    if(!IsCoherentRun(Beam)) {
-        for(int32_t itheta = 0; itheta < Ntheta; ++itheta) {
-            for(int32_t irz = 0; irz < NRz; ++irz) {
-                for(int32_t ir = 0; ir < Nr; ++ir) {
-                    size_t addr = ((size_t)itheta * NRz + irz) * Nr + ir;
-                    u[addr]     = cpxf(STD::sqrt(u[addr].real()), 0.0f);
-                }
-            }
+    if constexpr(R3D) {
+        // For incoherent run, convert intensity to pressure
+        if(!IsCoherentRun(Beam)) {
+            size_t n = (size_t)Ntheta * NRz * Nr;
+            for(size_t addr = 0; addr < n; ++addr) IntensityToPressure(u[addr]);
         }
-    }
-
-    if constexpr(!R3D) {
+    } else {
         // scale and/or incorporate cylindrical spreading
-        for(int32_t ir = 0; ir < Nr; ++ir) {
-            real factor;
-            if(IsLineSource(Beam)) {
-                const float local_pi = 3.14159265f;
-                factor               = FL(-4.0) * STD::sqrt(local_pi) * cnst;
-            } else {
-                if(r[ir] == 0.0f) {
-                    factor = RL(0.0); // avoid /0 at origin, return pressure = 0
+        // LP: The factors of a block of ranges are computed once, and then
+        // applied to every row (receiver bearing and depth) of the block, so
+        // the inner loops are over contiguous receivers. The intensity to
+        // pressure conversion is done in the same pass.
+        constexpr int32_t RangeBlock = 256;
+        float factor[RangeBlock];
+        bool toPressure = !IsCoherentRun(Beam);
+        int32_t nRows   = Ntheta * NRz;
+        for(int32_t ir0 = 0; ir0 < Nr; ir0 += RangeBlock) {
+            int32_t n = bhc::min(RangeBlock, Nr - ir0);
+            for(int32_t i = 0; i < n; ++i) {
+                real f;
+                if(IsLineSource(Beam)) {
+                    const float local_pi = 3.14159265f;
+                    f                    = FL(-4.0) * STD::sqrt(local_pi) * cnst;
                 } else {
-                    factor = cnst / (real)STD::sqrt(STD::abs(r[ir]));
+                    if(r[ir0 + i] == 0.0f) {
+                        f = RL(0.0); // avoid /0 at origin, return pressure = 0
+                    } else {
+                        f = cnst / (real)STD::sqrt(STD::abs(r[ir0 + i]));
+                    }
                 }
+                factor[i] = (float)f;
             }
-            for(int32_t itheta = 0; itheta < Ntheta; ++itheta) {
-                for(int32_t irz = 0; irz < NRz; ++irz) {
-                    size_t addr = ((size_t)itheta * NRz + irz) * Nr + ir;
-                    u[addr] *= (float)factor;
+            for(int32_t row = 0; row < nRows; ++row) {
+                FT *urow = &u[(size_t)row * Nr + ir0];
+                if(toPressure) {
+                    for(int32_t i = 0; i < n; ++i) IntensityToPressure(urow[i]);
                 }
+                for(int32_t i = 0; i < n; ++i) urow[i] *= factor[i];
             }
         }
     }
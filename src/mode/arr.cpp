@@ -18,13 +18,158 @@ this program. If not, see <https://www.gnu.org/licenses/>.
 */
 #include "arr.hpp"
 #include "../common_run.hpp"
+#include "../arrivals.hpp"
+
+#include <atomic>
+#include <vector>
 
 namespace bhc { namespace mode {
 
+/**
+ * LP: Converts the per-receiver linked lists of arrivals built up in the pool
+ * during the run into contiguous runs of arrivals per receiver, in the order
+ * they were added. Returns the number of arrivals.
+ */
+template<bool O3D> int32_t CompactArrivals(
+    const bhcParams<O3D> &params, ArrInfo *arrinfo, size_t nSrcsRcvrs)
+{
+    int32_t used = bhc::min(arrinfo->PoolCounters[0], arrinfo->ArrCapacity);
+    if(arrinfo->PoolCounters[1] > 0) {
+        EXTWARN(
+            "%d arrivals were discarded because there was only memory for %d",
+            arrinfo->PoolCounters[1], arrinfo->ArrCapacity);
+    }
+
+    // Destination of each pool entry, stored in place of its list link
+    size_t offset = 0;
+    for(size_t base = 0; base < nSrcsRcvrs; ++base) {
+        arrinfo->ArrOffset[base] = offset;
+        int32_t narr             = arrinfo->NArr[base];
+        offset += narr;
+        int32_t iArr = arrinfo->ArrLast[base];
+        for(int32_t dest = narr - 1; dest >= 0; --dest) {
+            int32_t prev           = arrinfo->ArrPrev[iArr];
+            arrinfo->ArrPrev[iArr] = (int32_t)arrinfo->ArrOffset[base] + dest;
+            iArr                   = prev;
+        }
+    }
+    if(offset != (size_t)used) {
+        EXTERR("Internal error in arrivals lists (%zu listed, %d used)", offset, used);
+    }
+
+    // Permute in place; each swap puts one entry in its final position
+    for(int32_t i = 0; i < used; ++i) {
+        while(arrinfo->ArrPrev[i] != i) {
+            int32_t j = arrinfo->ArrPrev[i];
+            std::swap(arrinfo->Arr[i], arrinfo->Arr[j]);
+            if(arrinfo->ArrMerge != nullptr) {
+                std::swap(arrinfo->ArrMerge[i], arrinfo->ArrMerge[j]);
+            }
+            std::swap(arrinfo->ArrPrev[i], arrinfo->ArrPrev[j]);
+        }
+    }
+    return used;
+}
+
+/**
+ * LP: Merges the steps of pairs for runs where AddArr could not do this as it
+ * went (multithreaded). The arrivals at each receiver are processed in ray
+ * order, i.e. the order a single thread traces the rays in, exactly as AddArr
+ * would have. Receivers are independent, so this is spread over the threads.
+ * Returns the number of arrivals after merging.
+ */
+template<bool O3D, bool R3D> int32_t MergeArrivals(
+    const bhcParams<O3D> &params, ArrInfo *arrinfo, size_t nSrcsRcvrs)
+{
+    const real omega       = FL(2.0) * REAL_PI * params.freqinfo->freq0;
+    const size_t blockSize = 4096;
+    const size_t numBlocks = (nSrcsRcvrs + blockSize - 1) / blockSize;
+    std::atomic<size_t> nextBlock(0);
+    auto worker = [&](int32_t) {
+        std::vector<int32_t> order;
+        std::vector<Arrival> arrs;
+        for(size_t block = nextBlock++; block < numBlocks; block = nextBlock++) {
+            size_t end = bhc::min((block + 1) * blockSize, nSrcsRcvrs);
+            for(size_t base = block * blockSize; base < end; ++base) {
+                int32_t narr = arrinfo->NArr[base];
+                if(narr == 0) continue;
+                size_t offset    = arrinfo->ArrOffset[base];
+                Arrival *baseArr = &arrinfo->Arr[offset];
+                const ArrivalMergeInfo *baseMerge = &arrinfo->ArrMerge[offset];
+                // Arrivals from one ray are already in order, as it was traced
+                // by a single thread.
+                order.resize(narr);
+                for(int32_t i = 0; i < narr; ++i) order[i] = i;
+                std::stable_sort(order.begin(), order.end(), [&](int32_t a, int32_t b) {
+                    return baseMerge[a].ray < baseMerge[b].ray;
+                });
+                arrs.assign(baseArr, baseArr + narr);
+                int32_t Nt = 0;
+                for(int32_t i : order) {
+                    const Arrival *lastArr = Nt > 0 ? &baseArr[Nt - 1] : nullptr;
+                    if(IsSecondStepOfPair<R3D>(
+                           omega, baseMerge[i].Phase, baseMerge[i].delay, lastArr)) {
+                        MergeArr(baseArr[Nt - 1], arrs[i]);
+                    } else {
+                        baseArr[Nt++] = arrs[i];
+                    }
+                }
+                arrinfo->NArr[base] = Nt;
+            }
+        }
+    };
+    GetInternal(params)->threadPool->Run(GetInternal(params)->numThreads, worker);
+
+    // Close the gaps left by the merged arrivals
+    size_t offset = 0;
+    for(size_t base = 0; base < nSrcsRcvrs; ++base) {
+        int32_t narr = arrinfo->NArr[base];
+        if(arrinfo->ArrOffset[base] != offset && narr > 0) {
+            memmove(
+                &arrinfo->Arr[offset], &arrinfo->Arr[arrinfo->ArrOffset[base]],
+                narr * sizeof(Arrival));
+        }
+        arrinfo->ArrOffset[base] = offset;
+        offset += narr;
+    }
+    return (int32_t)offset;
+}
+
+/**
+ * LP: Frees the bookkeeping only needed while arrivals are being added, and
+ * shrinks the pool to the arrivals actually stored if there is memory to copy
+ * them.
+ */
+template<bool O3D> void ShrinkArrivals(
+    const bhcParams<O3D> &params, ArrInfo *arrinfo, int32_t used)
+{
+    trackdeallocate(params, arrinfo->ArrLast);
+    trackdeallocate(params, arrinfo->ArrPrev);
+    trackdeallocate(params, arrinfo->PoolCounters);
+    trackdeallocate(params, arrinfo->ArrMerge);
+    size_t need = ((size_t)used * sizeof(Arrival) + 15) / 16 * 16 + 16;
+    if(used < arrinfo->ArrCapacity
+       && GetInternal(params)->usedMemory + need <= GetInternal(params)->maxMemory) {
+        Arrival *compact = nullptr;
+        trackallocate(params, "arrivals", compact, bhc::max(used, 1));
+        memcpy(compact, arrinfo->Arr, (size_t)used * sizeof(Arrival));
+        trackdeallocate(params, arrinfo->Arr);
+        arrinfo->Arr         = compact;
+        arrinfo->ArrCapacity = used;
+    }
+}
+
 template<bool O3D, bool R3D> void PostProcessArrivals(
     const bhcParams<O3D> &params, ArrInfo *arrinfo)
 {
     const Position *Pos = params.Pos;
+    size_t nSrcsRcvrs   = GetFieldSize(Pos);
+    int32_t used        = CompactArrivals<O3D>(params, arrinfo, nSrcsRcvrs);
+    if(!arrinfo->AllowMerging) {
+        used = MergeArrivals<O3D, R3D>(params, arrinfo, nSrcsRcvrs);
+    }
+    ShrinkArrivals<O3D>(params, arrinfo, used);
+    arrinfo->MaxNArr = 0;
     for(int32_t isz = 0; isz < Pos->NSz; ++isz) {
         for(int32_t isx = 0; isx < Pos->NSx; ++isx) {
             for(int32_t isy = 0; isy < Pos->NSy; ++isy) {
@@ -36,13 +181,7 @@ template<bool O3D, bool R3D> void PostProcessArrivals(
                                 = GetFieldAddr(isx, isy, isz, itheta, iz, ir, Pos);
 
                             int32_t narr = arrinfo->NArr[base];
-                            if(narr > arrinfo->MaxNArr) {
-                                // For multithreading / AllowMerging == false where this
-                                // holds the total number of attempted arrivals,
-                                // including those not written due to limited memory
-                                arrinfo->NArr[base] = narr = arrinfo->MaxNArr;
-                            }
-                            maxn = bhc::max(maxn, narr);
+                            maxn         = bhc::max(maxn, narr);
 
                             float factor;
                             if constexpr(R3D) {
@@ -60,13 +199,15 @@ template<bool O3D, bool R3D> void PostProcessArrivals(
                                     factor = FL(1.0) / STD::sqrt(Pos->Rr[ir]);
                                 }
                             }
+                            Arrival *baseArr = &arrinfo->Arr[arrinfo->ArrOffset[base]];
                             for(int32_t iArr = 0; iArr < narr; ++iArr) {
-                                arrinfo->Arr[base * arrinfo->MaxNArr + iArr].a *= factor;
+                                baseArr[iArr].a *= factor;
                             }
                         }
                     }
                 }
                 arrinfo->MaxNPerSource[(isz * Pos->NSx + isx) * Pos->NSy + isy] = maxn;
+                arrinfo->MaxNArr = bhc::max(arrinfo->MaxNArr, maxn);
             }
         }
     }
@@ -194,7 +335,7 @@ template<bool O3D> void WriteOutArrivals(
 
                             for(int32_t iArr = 0; iArr < narr; ++iArr) {
                                 Arrival *arr
-                                    = &arrinfo->Arr[base * arrinfo->MaxNArr + iArr];
+                                    = &arrinfo->Arr[arrinfo->ArrOffset[base] + iArr];
                                 // LP: Unnecessary inconsistent casting to float; see
                                 // Fortran version readme.
                                 if(isAscii) {
@@ -345,6 +486,9 @@ template<bool O3D, bool R3D> void ReadOutArrivals(
     Pos->NRz_per_range = Pos->NRz;
     Arr<O3D, R3D> arrmode;
     arrmode.Preprocess(params, outputs);
+    // The arrivals in the file have already been merged
+    arrinfo->AllowMerging = true;
+    arrmode.AllocateMaxPool(params, arrinfo);
 
     Arrival dummy_arr;
     for(int32_t isz = 0; isz < Pos->NSz; ++isz) {
@@ -362,19 +506,24 @@ template<bool O3D, bool R3D> void ReadOutArrivals(
                                 = GetFieldAddr(isx, isy, isz, itheta, iz, ir, Pos);
                             int32_t narr;
                             ReadArrivalsValue(AARRFile, BARRFile, isAscii, narr, true);
-                            int32_t keep_narr = narr;
-                            if(narr > arrinfo->MaxNArr) {
-                                keep_narr = arrinfo->MaxNArr;
+                            int32_t keep_narr = bhc::min(
+                                narr, arrinfo->ArrCapacity - arrinfo->PoolCounters[0]);
+                            if(keep_narr < narr) {
                                 EXTWARN(
                                     "%d arrivals in file (source xyz %d,%d,%d "
                                     "/ rcvr tzr %d,%d,%d), but only memory for %d",
-                                    isx, isy, isz, itheta, iz, ir, narr, keep_narr);
+                                    narr, isx, isy, isz, itheta, iz, ir, keep_narr);
                             }
-                            arrinfo->NArr[base] = keep_narr;
                             for(int32_t iArr = 0; iArr < narr; ++iArr) {
                                 Arrival *arr;
                                 if(iArr < keep_narr) {
-                                    arr = &arrinfo->Arr[base * arrinfo->MaxNArr + iArr];
+                                    // LP: Same bookkeeping as AddArr, so the
+                                    // arrivals are compacted the same way.
+                                    int32_t i = arrinfo->PoolCounters[0]++;
+                                    arrinfo->ArrPrev[i]     = arrinfo->ArrLast[base];
+                                    arrinfo->ArrLast[base]  = i;
+                                    arrinfo->NArr[base]     = iArr + 1;
+                                    arr                     = &arrinfo->Arr[i];
                                 } else {
                                     arr = &dummy_arr;
                                 }
@@ -420,6 +569,14 @@ template<bool O3D, bool R3D> void ReadOutArrivals(
             }
         }
     }
+
+    size_t nSrcsRcvrs = GetFieldSize(Pos);
+    int32_t used      = CompactArrivals<O3D>(params, arrinfo, nSrcsRcvrs);
+    ShrinkArrivals<O3D>(params, arrinfo, used);
+    arrinfo->MaxNArr = 0;
+    for(size_t base = 0; base < nSrcsRcvrs; ++base) {
+        arrinfo->MaxNArr = bhc::max(arrinfo->MaxNArr, arrinfo->NArr[base]);
+    }
 }
 
 #if BHC_ENABLE_2D
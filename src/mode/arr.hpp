@@ -56,7 +56,13 @@ public:
     {
         outputs.arrinfo->Arr           = nullptr;
         outputs.arrinfo->NArr          = nullptr;
+        outputs.arrinfo->ArrOffset     = nullptr;
+        outputs.arrinfo->ArrLast       = nullptr;
+        outputs.arrinfo->ArrPrev       = nullptr;
+        outputs.arrinfo->PoolCounters  = nullptr;
+        outputs.arrinfo->ArrMerge      = nullptr;
         outputs.arrinfo->MaxNPerSource = nullptr;
+        outputs.arrinfo->ArrCapacity   = 0;
         outputs.arrinfo->MaxNArr       = 1;
     }
 
@@ -66,37 +72,89 @@ public:
         Field<O3D, R3D>::Preprocess(params, outputs);
         ArrInfo *arrinfo = outputs.arrinfo;
 
-        trackdeallocate(params, arrinfo->Arr);
-        trackdeallocate(params, arrinfo->NArr);
-        trackdeallocate(params, arrinfo->MaxNPerSource);
-        arrinfo->AllowMerging = GetInternal(params)->numThreads == 1;
+        Finalize(params, outputs);
+        // LP: Packet tracing (see packet.hpp) interleaves the rays within each
+        // thread, so then the steps of pairs are also merged after the run.
+        char st      = params.ssp->Type;
+        bool packets = !O3D && GetInternal(params)->rayPackets
+            && GetInternal(params)->rayCache.mode == RayCacheState::Mode::Off
+            && (st == 'N' || st == 'C' || st == 'S' || st == 'P');
+        arrinfo->AllowMerging = GetInternal(params)->numThreads == 1 && !packets;
+        arrinfo->Nalpha       = params.Angles->alpha.n;
         size_t nSrcs          = params.Pos->NSx * params.Pos->NSy * params.Pos->NSz;
-        size_t nSrcsRcvrs     = nSrcs * params.Pos->Ntheta * params.Pos->NRr
-            * params.Pos->NRz_per_range;
-        int64_t remainingMemory = GetInternal(params)->maxMemory
-            - GetInternal(params)->usedMemory;
-        remainingMemory -= nSrcsRcvrs * sizeof(int32_t);
-        remainingMemory -= nSrcs * sizeof(int32_t);
-        remainingMemory -= 32 * 3; // Possible padding used for the three arrays
-        remainingMemory  = std::max(remainingMemory, (int64_t)0);
-        arrinfo->MaxNArr = (int32_t)std::min(
-            remainingMemory / (nSrcsRcvrs * sizeof(Arrival)), (size_t)0x7FFFFFFF);
-        if(arrinfo->MaxNArr == 0) {
+        size_t nSrcsRcvrs     = NumSrcsRcvrs(params);
+        trackallocate(params, "arrivals", arrinfo->NArr, nSrcsRcvrs);
+        trackallocate(params, "arrivals", arrinfo->ArrOffset, nSrcsRcvrs);
+        trackallocate(params, "arrivals", arrinfo->ArrLast, nSrcsRcvrs);
+        trackallocate(params, "arrivals", arrinfo->PoolCounters, 2);
+        trackallocate(params, "arrivals", arrinfo->MaxNPerSource, nSrcs);
+        // ArrOffset and MaxNPerSource do not have to be initialized
+
+        // LP: The pool is shared by all receivers, so it only has to be large
+        // enough for the total number of arrivals. It starts out with room for
+        // InitialArrPerRcvr arrivals per receiver, and only grows if the run
+        // finds more (see Run), so the memory used scales with the arrivals.
+        int32_t maxCapacity = MaxPoolCapacity(params, arrinfo);
+        if(maxCapacity == 0) {
             EXTERR("Insufficient memory to allocate arrivals");
-        } else if(arrinfo->MaxNArr < 10) {
+        } else if((size_t)maxCapacity < 10 * nSrcsRcvrs) {
             EXTWARN(
                 "Only enough memory to allocate up to %d arrivals per receiver",
-                arrinfo->MaxNArr);
+                (int32_t)((size_t)maxCapacity / nSrcsRcvrs));
         }
-        GetInternal(params)->PRTFile << "\n( Maximum # of arrivals = " << arrinfo->MaxNArr
-                                     << " )\n";
-        trackallocate(
-            params, "arrivals", arrinfo->Arr, nSrcsRcvrs * (size_t)arrinfo->MaxNArr);
-        trackallocate(params, "arrivals", arrinfo->NArr, nSrcsRcvrs);
-        trackallocate(params, "arrivals", arrinfo->MaxNPerSource, nSrcs);
-        memset(arrinfo->Arr, 0, nSrcsRcvrs * (size_t)arrinfo->MaxNArr * sizeof(Arrival));
-        memset(arrinfo->NArr, 0, nSrcsRcvrs * sizeof(int32_t));
-        // MaxNPerSource does not have to be initialized
+        // LP: As before the pool was shared: the number of arrivals which fit
+        // per receiver.
+        GetInternal(params)->PRTFile << "\n( Maximum # of arrivals = "
+                                     << (size_t)maxCapacity / nSrcsRcvrs << " )\n";
+        AllocatePool(
+            params, arrinfo,
+            (int32_t)bhc::min(
+                (size_t)maxCapacity,
+                bhc::max(nSrcsRcvrs * InitialArrPerRcvr, MinInitialArr)));
+    }
+
+    virtual void Run(bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs) const override
+    {
+        ArrInfo *arrinfo = outputs.arrinfo;
+        while(true) {
+            Field<O3D, R3D>::Run(params, outputs);
+            int32_t dropped = arrinfo->PoolCounters[1];
+            if(dropped == 0) return;
+            // LP: The pool was too small. If there is memory for a larger one,
+            // trace the rays again into it; otherwise keep what was stored, and
+            // the dropped arrivals are reported in PostProcessArrivals.
+            // LP: The rays recorded in the first pass are replayed, so the
+            // memory which was kept for them is available.
+            RayCacheState &cache = GetInternal(params)->rayCache;
+            if(cache.mode == RayCacheState::Mode::Record && cache.valid) {
+                cache.mode = RayCacheState::Mode::Replay;
+            }
+            int64_t cur  = arrinfo->ArrCapacity;
+            int64_t more = MaxPoolCapacity(params, arrinfo);
+            if(more == 0) return;
+            int64_t want = cur + (int64_t)dropped;
+            int64_t cap  = std::min(
+                std::min(cur + more, (int64_t)0x7FFFFFFF),
+                std::max(2 * cur, want + want / 4));
+            GetInternal(params)->PRTFile << "\nArrivals pool of " << cur
+                                         << " entries was full, tracing again with "
+                                         << cap << " entries\n";
+            AllocatePool(params, arrinfo, (int32_t)cap);
+        }
+    }
+
+    /**
+     * Allocates the arrivals pool with the largest capacity which fits, for
+     * reading arrivals from a file (see ReadOutArrivals).
+     */
+    void AllocateMaxPool(bhcParams<O3D> &params, ArrInfo *arrinfo) const
+    {
+        trackdeallocate(params, arrinfo->Arr);
+        trackdeallocate(params, arrinfo->ArrPrev);
+        trackdeallocate(params, arrinfo->ArrMerge);
+        int32_t cap = MaxPoolCapacity(params, arrinfo);
+        if(cap == 0) { EXTERR("Insufficient memory to allocate arrivals"); }
+        AllocatePool(params, arrinfo, cap);
     }
 
     virtual void Postprocess(
@@ -123,8 +181,73 @@ public:
     {
         trackdeallocate(params, outputs.arrinfo->Arr);
         trackdeallocate(params, outputs.arrinfo->NArr);
+        trackdeallocate(params, outputs.arrinfo->ArrOffset);
+        trackdeallocate(params, outputs.arrinfo->ArrLast);
+        trackdeallocate(params, outputs.arrinfo->ArrPrev);
+        trackdeallocate(params, outputs.arrinfo->PoolCounters);
+        trackdeallocate(params, outputs.arrinfo->ArrMerge);
         trackdeallocate(params, outputs.arrinfo->MaxNPerSource);
     }
+
+private:
+    /// Initial size of the arrivals pool per receiver, and overall minimum.
+    static constexpr size_t InitialArrPerRcvr = 16;
+    static constexpr size_t MinInitialArr     = 1 << 20;
+
+    static size_t NumSrcsRcvrs(const bhcParams<O3D> &params)
+    {
+        const Position *Pos = params.Pos;
+        return (size_t)Pos->NSx * Pos->NSy * Pos->NSz * Pos->Ntheta * Pos->NRr
+            * Pos->NRz_per_range;
+    }
+
+    /// Bytes per entry of the pool: Arr, ArrPrev, and ArrMerge if used.
+    static size_t PoolEntryBytes(const ArrInfo *arrinfo)
+    {
+        size_t entrySize = sizeof(Arrival) + sizeof(int32_t);
+        if(!arrinfo->AllowMerging) entrySize += sizeof(ArrivalMergeInfo);
+        return entrySize;
+    }
+
+    /**
+     * Number of pool entries which fit in the memory left, in addition to
+     * what is already allocated.
+     */
+    static int32_t MaxPoolCapacity(const bhcParams<O3D> &params, const ArrInfo *arrinfo)
+    {
+        int64_t remainingMemory = (int64_t)GetInternal(params)->maxMemory
+            - (int64_t)GetInternal(params)->usedMemory;
+        remainingMemory -= 32 * 3; // Possible padding used for the three arrays
+        remainingMemory = std::max(remainingMemory, (int64_t)0);
+        // Leave room for the rays to be stored (bhcInit::cacheRays)
+        if(GetInternal(params)->rayCache.mode == RayCacheState::Mode::Record) {
+            remainingMemory /= 2;
+        }
+        return (int32_t)std::min(
+            (size_t)remainingMemory / PoolEntryBytes(arrinfo), (size_t)0x7FFFFFFF);
+    }
+
+    /**
+     * (Re)allocates the pool with room for capacity arrivals, and empties the
+     * per-receiver lists. The pool is not initialized, so on the CPU, the OS
+     * only provides the pages which are actually used.
+     */
+    static void AllocatePool(bhcParams<O3D> &params, ArrInfo *arrinfo, int32_t capacity)
+    {
+        trackdeallocate(params, arrinfo->Arr);
+        trackdeallocate(params, arrinfo->ArrPrev);
+        trackdeallocate(params, arrinfo->ArrMerge);
+        arrinfo->ArrCapacity = capacity;
+        trackallocate(params, "arrivals", arrinfo->Arr, capacity);
+        trackallocate(params, "arrivals", arrinfo->ArrPrev, capacity);
+        if(!arrinfo->AllowMerging) {
+            trackallocate(params, "arrivals", arrinfo->ArrMerge, capacity);
+        }
+        size_t nSrcsRcvrs = NumSrcsRcvrs(params);
+        memset(arrinfo->NArr, 0, nSrcsRcvrs * sizeof(int32_t));
+        memset(arrinfo->ArrLast, 0xFF, nSrcsRcvrs * sizeof(int32_t)); // -1
+        memset(arrinfo->PoolCounters, 0, 2 * sizeof(int32_t));
+    }
 };
 
 }} // namespace bhc::mode
@@ -25,10 +25,9 @@ template<bool O3D, bool R3D> void EigenModePostWorker(
     const bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs, int32_t worker,
     ErrState *errState)
 {
-    SetupThread();
-    while(true) {
-        int32_t job = GetInternal(params)->sharedJobID++;
-        if(job >= bhc::min(outputs.eigen->neigen, outputs.eigen->memsize)) break;
+    JobScheduler &scheduler = GetInternal(params)->scheduler;
+    int32_t job;
+    while(scheduler.GetNextJob(worker, job)) {
         EigenHit *hit  = &outputs.eigen->hits[job];
         int32_t Nsteps = hit->is;
         RayInitInfo rinit;
@@ -78,14 +77,14 @@ template<bool O3D, bool R3D> void PostProcessEigenrays(
 
     ErrState errState;
     ResetErrState(&errState);
-    GetInternal(params)->sharedJobID = 0;
-    int32_t numThreads               = GetInternal(params)->numThreads;
-    std::vector<std::thread> threads;
-    for(int32_t i = 0; i < numThreads; ++i)
-        threads.push_back(std::thread(
-            EigenModePostWorker<O3D, R3D>, std::cref(params), std::ref(outputs), i,
-            &errState));
-    for(int32_t i = 0; i < numThreads; ++i) threads[i].join();
+    int32_t numThreads = GetInternal(params)->numThreads;
+    GetInternal(params)->scheduler.Reset(
+        bhc::min(outputs.eigen->neigen, outputs.eigen->memsize), numThreads);
+    GetInternal(params)->threadPool->Run(numThreads, [&](int32_t i) {
+        EigenModePostWorker<O3D, R3D>(params, outputs, i, &errState);
+    });
+    GetInternal(params)->scheduler.Report(
+        GetInternal(params), "Eigenrays", outputs.metrics);
     CheckReportErrors(GetInternal(params), &errState);
 
     raymode.Postprocess(params, outputs);
@@ -93,7 +93,14 @@ template<char IT, bool O3D, bool R3D> inline void RunFieldModesSelRun(
     bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs)
 {
     char rt = params.Beam->RunType[0];
-    if(rt == 'C' || rt == 'S' || rt == 'I') {
+    if((rt == 'S' || rt == 'I') && UsesRealField(params)) {
+#ifdef BHC_RUN_ENABLE_TL_REAL
+        RunFieldModesSelSSP<'I', IT, O3D, R3D>(params, outputs);
+#else
+        EXTERR("Real-field transmission loss runs (Beam->RunType[0] == 'S' or 'I' "
+               "with realTLField) were not enabled at compile time!");
+#endif
+    } else if(rt == 'C' || rt == 'S' || rt == 'I') {
 #ifdef BHC_RUN_ENABLE_TL
         RunFieldModesSelSSP<'C', IT, O3D, R3D>(params, outputs);
 #else
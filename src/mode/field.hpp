@@ -20,6 +20,7 @@ this program. If not, see <https://www.gnu.org/licenses/>.
 #include "../common_setup.hpp"
 #include "modemodule.hpp"
 #include "fieldimpl.hpp"
+#include "raycache.hpp"
 #include "../influence.hpp"
 
 namespace bhc { namespace mode {
@@ -35,6 +36,7 @@ public:
     virtual void Preprocess(bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &) const override
     {
         PreRun_Influence<O3D, R3D>(params);
+        PrepareRayCache<O3D, R3D>(params);
     }
 
     virtual void Run(bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs) const override
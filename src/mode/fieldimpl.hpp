@@ -21,8 +21,42 @@ this program. If not, see <https://www.gnu.org/licenses/>.
 
 namespace bhc { namespace mode {
 
+/**
+ * The TL field for the tracing and influence code to add into: uAllSources, or
+ * uAllSourcesReal for real-field TL runs (see RunType::FieldT). nullptr for
+ * other run types.
+ */
+template<typename CFG, bool O3D, bool R3D>
+HOST_DEVICE inline typename CFG::run::FieldT *GetTraceField(
+    const bhcOutputs<O3D, R3D> &outputs)
+{
+    if constexpr(CFG::run::IsRealFieldTL()) {
+        return outputs.uAllSourcesReal;
+    } else {
+        return outputs.uAllSources;
+    }
+}
+
+/**
+ * Thread-private field tile number tile (1 through numFieldTiles - 1) of
+ * tileElems elements, see bhcInternal::fieldTiles.
+ */
+template<typename CFG> inline typename CFG::run::FieldT *GetFieldTile(
+    bhcInternal *internal, int32_t tile, size_t tileElems)
+{
+    float *tileField = &internal->fieldTiles
+                            [(size_t)(tile - 1) * tileElems
+                             * (sizeof(typename CFG::run::FieldT) / sizeof(float))];
+    if constexpr(CFG::run::IsRealFieldTL()) {
+        return tileField;
+    } else {
+        return reinterpret_cast<cpxf *>(tileField);
+    }
+}
+
 template<typename CFG, bool O3D, bool R3D> void FieldModesWorker(
-    bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs, ErrState *errState);
+    bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs, int32_t worker,
+    ErrState *errState);
 
 template<typename CFG, bool O3D, bool R3D> void RunFieldModesImpl(
     bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs);
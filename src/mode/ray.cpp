@@ -23,6 +23,50 @@ this program. If not, see <https://www.gnu.org/licenses/>.
 
 namespace bhc { namespace mode {
 
+template<bool O3D> void FreeCompactRays(const bhcParams<O3D> &params)
+{
+    bhcInternal *internal = GetInternal(params);
+    for(float *&chunk : internal->rayChunks) trackdeallocate(params, chunk);
+    internal->rayChunks.clear();
+    internal->rayChunkUsed = internal->rayChunkCapacity = 0;
+}
+
+#if BHC_ENABLE_2D
+template void FreeCompactRays<false>(const bhcParams<false> &params);
+#endif
+#if BHC_ENABLE_3D || BHC_ENABLE_NX2D
+template void FreeCompactRays<true>(const bhcParams<true> &params);
+#endif
+
+/**
+ * Returns space for n floats of compact ray storage, starting a new chunk if
+ * the current one is full, or nullptr if out of memory. Thread-safe.
+ */
+template<bool O3D> inline float *AllocateCompactRay(
+    const bhcParams<O3D> &params, size_t n)
+{
+    // 16 MiB per chunk, roughly 2 million 2D ray points
+    constexpr size_t ChunkFloats = 4ull * 1024ull * 1024ull;
+    bhcInternal *internal        = GetInternal(params);
+    std::lock_guard<std::mutex> lock(internal->rayChunkMutex);
+    if(internal->rayChunks.empty()
+       || internal->rayChunkUsed + n > internal->rayChunkCapacity) {
+        size_t avail = internal->maxMemory - internal->usedMemory;
+        size_t cap   = bhc::min(bhc::max(n, ChunkFloats), avail / sizeof(float));
+        // LP: Allocation overhead, see trackallocate.
+        if(cap * sizeof(float) + 32 > avail) cap = (avail - 32) / sizeof(float);
+        if(avail < 32 || cap < n) return nullptr;
+        float *chunk = nullptr;
+        trackallocate(params, "compact rays", chunk, cap);
+        internal->rayChunks.push_back(chunk);
+        internal->rayChunkUsed     = 0;
+        internal->rayChunkCapacity = cap;
+    }
+    float *ret = &internal->rayChunks.back()[internal->rayChunkUsed];
+    internal->rayChunkUsed += n;
+    return ret;
+}
+
 template<bool O3D, bool R3D> bool RunRay(
     RayInfo<O3D, R3D> *rayinfo, const bhcParams<O3D> &params, int32_t job, int32_t worker,
     RayInitInfo &rinit, int32_t &Nsteps, ErrState *errState)
@@ -32,7 +76,7 @@ template<bool O3D, bool R3D> bool RunRay(
         return false;
     }
     rayPt<R3D> *ray;
-    if(rayinfo->isCopyMode) {
+    if(rayinfo->isCopyMode || rayinfo->isCompact || rayinfo->isStreamed) {
         ray = &rayinfo->WorkRayMem[worker * rayinfo->MaxPointsPerRay];
     } else {
         ray = &rayinfo->RayMem[(size_t)job * rayinfo->MaxPointsPerRay];
@@ -43,42 +87,43 @@ template<bool O3D, bool R3D> bool RunRay(
 #endif
 
     Origin<O3D, R3D> org;
-    char st = params.ssp->Type;
+    RayCounters *counters = &GetInternal(params)->rayCounters[worker];
+    char st               = params.ssp->Type;
     if(st == 'N') {
         MainRayMode<CfgSel<'R', 'G', 'N'>, O3D, R3D>(
             rinit, ray, Nsteps, rayinfo->MaxPointsPerRay, org, params.Bdry, params.bdinfo,
             params.refl, params.ssp, params.Pos, params.Angles, params.freqinfo,
-            params.Beam, params.sbp, errState);
+            params.Beam, params.sbp, errState, counters);
     } else if(st == 'C') {
         MainRayMode<CfgSel<'R', 'G', 'C'>, O3D, R3D>(
             rinit, ray, Nsteps, rayinfo->MaxPointsPerRay, org, params.Bdry, params.bdinfo,
             params.refl, params.ssp, params.Pos, params.Angles, params.freqinfo,
-            params.Beam, params.sbp, errState);
+            params.Beam, params.sbp, errState, counters);
     } else if(st == 'S') {
         MainRayMode<CfgSel<'R', 'G', 'S'>, O3D, R3D>(
             rinit, ray, Nsteps, rayinfo->MaxPointsPerRay, org, params.Bdry, params.bdinfo,
             params.refl, params.ssp, params.Pos, params.Angles, params.freqinfo,
-            params.Beam, params.sbp, errState);
+            params.Beam, params.sbp, errState, counters);
     } else if(st == 'P') {
         MainRayMode<CfgSel<'R', 'G', 'P'>, O3D, R3D>(
             rinit, ray, Nsteps, rayinfo->MaxPointsPerRay, org, params.Bdry, params.bdinfo,
             params.refl, params.ssp, params.Pos, params.Angles, params.freqinfo,
-            params.Beam, params.sbp, errState);
+            params.Beam, params.sbp, errState, counters);
     } else if(st == 'Q') {
         MainRayMode<CfgSel<'R', 'G', 'Q'>, O3D, R3D>(
             rinit, ray, Nsteps, rayinfo->MaxPointsPerRay, org, params.Bdry, params.bdinfo,
             params.refl, params.ssp, params.Pos, params.Angles, params.freqinfo,
-            params.Beam, params.sbp, errState);
+            params.Beam, params.sbp, errState, counters);
     } else if(st == 'H') {
         MainRayMode<CfgSel<'R', 'G', 'H'>, O3D, R3D>(
             rinit, ray, Nsteps, rayinfo->MaxPointsPerRay, org, params.Bdry, params.bdinfo,
             params.refl, params.ssp, params.Pos, params.Angles, params.freqinfo,
-            params.Beam, params.sbp, errState);
+            params.Beam, params.sbp, errState, counters);
     } else if(st == 'A') {
         MainRayMode<CfgSel<'R', 'G', 'A'>, O3D, R3D>(
             rinit, ray, Nsteps, rayinfo->MaxPointsPerRay, org, params.Bdry, params.bdinfo,
             params.refl, params.ssp, params.Pos, params.Angles, params.freqinfo,
-            params.Beam, params.sbp, errState);
+            params.Beam, params.sbp, errState, counters);
     } else {
         RunError(errState, BHC_ERR_INVALID_SSP_TYPE);
         return false;
@@ -86,7 +131,25 @@ template<bool O3D, bool R3D> bool RunRay(
     if(HasErrored(errState)) return false;
 
     bool ret = true;
-    if(rayinfo->isCopyMode) {
+    rayinfo->results[job].compactX = nullptr;
+    if(rayinfo->isCompact) {
+        constexpr int32_t dim = R3D ? 3 : 2;
+        float *xc = AllocateCompactRay(params, (size_t)dim * (size_t)Nsteps);
+        if(xc == nullptr) {
+            RunWarning(errState, BHC_WARN_RAYS_OUTOFMEMORY);
+            ret = false;
+        } else {
+            for(int32_t k = 0; k < dim; ++k) {
+                for(int32_t is = 0; is < Nsteps; ++is) {
+                    xc[(size_t)k * Nsteps + is] = (float)ray[is].x[k];
+                }
+            }
+            rayinfo->results[job].compactX  = xc;
+            rayinfo->results[job].NumTopBnc = ray[Nsteps - 1].NumTopBnc;
+            rayinfo->results[job].NumBotBnc = ray[Nsteps - 1].NumBotBnc;
+        }
+        rayinfo->results[job].ray = nullptr;
+    } else if(rayinfo->isCopyMode) {
         size_t p = AtomicFetchAdd(&rayinfo->RayMemPoints, (size_t)Nsteps);
         if(p + (size_t)Nsteps > rayinfo->RayMemCapacity) {
             RunWarning(errState, BHC_WARN_RAYS_OUTOFMEMORY);
@@ -101,6 +164,7 @@ template<bool O3D, bool R3D> bool RunRay(
     }
     rayinfo->results[job].org          = org;
     rayinfo->results[job].SrcDeclAngle = rinit.SrcDeclAngle;
+    rayinfo->results[job].SrcAzimAngle = rinit.SrcAzimAngle;
     rayinfo->results[job].Nsteps       = Nsteps;
 
     return ret;
@@ -124,50 +188,86 @@ template bool RunRay<true, true>(
 
 template<bool O3D, bool R3D> void RayModeWorker(
     const bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs, int32_t worker,
-    ErrState *errState)
+    OrderedStreamWriter *stream, ErrState *errState)
 {
-    SetupThread();
-    while(true) {
-        int32_t job    = GetInternal(params)->sharedJobID++;
+    JobScheduler &scheduler = GetInternal(params)->scheduler;
+    int32_t job;
+    std::string text;
+    while(scheduler.GetNextJob(worker, job)) {
         int32_t Nsteps = -1;
         RayInitInfo rinit;
-        if(!GetJobIndices<O3D>(rinit, job, params.Pos, params.Angles)) break;
-        if(!RunRay<O3D, R3D>(
+        if(!GetJobIndices<O3D>(rinit, job, params.Pos, params.Angles)
+           || !RunRay<O3D, R3D>(
                outputs.rayinfo, params, job, worker, rinit, Nsteps, errState)) {
+            // LP: This ray will never be submitted, so the writer cannot
+            // continue past it.
+            if(stream != nullptr) stream->Abort();
             break;
         }
+        if(stream != nullptr) {
+            // The ray is in this worker's work memory, which is reused for the
+            // next ray, so format it now.
+            RayResult<O3D, R3D> *res = &outputs.rayinfo->results[job];
+            CompressRay(res, params.Bdry);
+            text.clear();
+            text.reserve((size_t)res->Nsteps * (R3D ? 80 : 54) + 64);
+            FormatRay(text, res);
+            stream->Submit(job, std::move(text));
+            res->ray = nullptr;
+        }
     }
 }
 
 #if BHC_ENABLE_2D
 template void RayModeWorker<false, false>(
     const bhcParams<false> &params, bhcOutputs<false, false> &outputs, int32_t worker,
-    ErrState *errState);
+    OrderedStreamWriter *stream, ErrState *errState);
 #endif
 #if BHC_ENABLE_NX2D
 template void RayModeWorker<true, false>(
     const bhcParams<true> &params, bhcOutputs<true, false> &outputs, int32_t worker,
-    ErrState *errState);
+    OrderedStreamWriter *stream, ErrState *errState);
 #endif
 #if BHC_ENABLE_3D
 template void RayModeWorker<true, true>(
     const bhcParams<true> &params, bhcOutputs<true, true> &outputs, int32_t worker,
-    ErrState *errState);
+    OrderedStreamWriter *stream, ErrState *errState);
 #endif
 
 template<bool O3D, bool R3D> void RunRayMode(
     bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs)
 {
+    // Number of finished rays per thread which may be waiting to be written
+    // when streaming, i.e. how far the workers may get ahead of a slow ray.
+    constexpr int32_t StreamWindowPerThread = 16;
+
     ErrState errState;
     ResetErrState(&errState);
-    GetInternal(params)->sharedJobID = 0;
-    int32_t numThreads               = GetInternal(params)->numThreads;
-    std::vector<std::thread> threads;
-    for(int32_t i = 0; i < numThreads; ++i)
-        threads.push_back(std::thread(
-            RayModeWorker<O3D, R3D>, std::ref(params), std::ref(outputs), i, &errState));
-    for(int32_t i = 0; i < numThreads; ++i) threads[i].join();
+    int32_t numThreads = GetInternal(params)->numThreads;
+    bool streamed      = outputs.rayinfo->isStreamed;
+    OrderedStreamWriter stream;
+    if(streamed) {
+        std::string path = GetInternal(params)->FileRoot + ".ray";
+        {
+            LDOFile RAYFile;
+            OpenRAYFile(RAYFile, GetInternal(params)->FileRoot, params);
+        }
+        if(!stream.Open(path, StreamWindowPerThread * numThreads)) {
+            EXTERR("Could not open %s for streaming rays", path.c_str());
+        }
+    }
+    // LP: The writer needs rays to be started in order, see OrderedStreamWriter.
+    GetInternal(params)->scheduler.Reset(
+        GetNumJobs<O3D>(params.Pos, params.Angles), numThreads, streamed);
+    GetInternal(params)->threadPool->Run(numThreads, [&](int32_t i) {
+        RayModeWorker<O3D, R3D>(
+            params, outputs, i, streamed ? &stream : nullptr, &errState);
+    });
+    GetInternal(params)->scheduler.Report(GetInternal(params), "Run", outputs.metrics);
+    bool written = !streamed || stream.Close();
+    // LP: If a ray failed, its error explains why the file is incomplete.
     CheckReportErrors(GetInternal(params), &errState);
+    if(!written) EXTERR("Error writing streamed ray file, the file is incomplete");
 }
 
 #if BHC_ENABLE_2D
@@ -183,6 +283,215 @@ template void RunRayMode<true, true>(
     bhcParams<true> &params, bhcOutputs<true, true> &outputs);
 #endif
 
+template<bool O3D, bool R3D> void WriteOutRayBinary(
+    const bhcParams<O3D> &params, const bhcOutputs<O3D, R3D> &outputs)
+{
+    constexpr int32_t dim            = O3D ? 3 : 2;
+    const RayInfo<O3D, R3D> *rayinfo = outputs.rayinfo;
+    const Position *Pos              = params.Pos;
+    const AnglesStructure *Angles    = params.Angles;
+
+    std::string path = GetInternal(params)->FileRoot + ".rayb";
+    std::ofstream RAYFile(path, std::ios::binary);
+    if(!RAYFile.good()) EXTERR("Could not open binary ray file %s", path.c_str());
+
+    std::vector<float> grid;
+    grid.insert(grid.end(), Pos->Sx, Pos->Sx + Pos->NSx);
+    grid.insert(grid.end(), Pos->Sy, Pos->Sy + Pos->NSy);
+    grid.insert(grid.end(), Pos->Sz, Pos->Sz + Pos->NSz);
+    for(int32_t i = 0; i < Angles->alpha.n; ++i) {
+        grid.push_back((float)(Angles->alpha.angles[i] * RadDeg));
+    }
+    for(int32_t i = 0; i < Angles->beta.n; ++i) {
+        grid.push_back((float)(Angles->beta.angles[i] * RadDeg));
+    }
+    if(grid.size() % 2 != 0) grid.push_back(0.0f); // 8 byte align the index
+
+    RayFileHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, RayFileMagic, sizeof(hdr.magic));
+    hdr.version = RayFileVersion;
+    hdr.dim     = dim;
+    memcpy(hdr.title, params.Title, sizeof(hdr.title));
+    hdr.freq0       = params.freqinfo->freq0;
+    hdr.TopDepth    = params.Bdry->Top.hs.Depth;
+    hdr.BotDepth    = params.Bdry->Bot.hs.Depth;
+    hdr.NSx         = Pos->NSx;
+    hdr.NSy         = Pos->NSy;
+    hdr.NSz         = Pos->NSz;
+    hdr.Nalpha      = Angles->alpha.n;
+    hdr.Nbeta       = Angles->beta.n;
+    hdr.indexOffset = sizeof(hdr) + grid.size() * sizeof(float);
+
+    std::vector<RayFileEntry> index;
+    for(int32_t r = 0; r < rayinfo->NRays; ++r) {
+        const RayResult<O3D, R3D> *res = &rayinfo->results[r];
+        if(res->ray == nullptr && res->compactX == nullptr) continue;
+        RayFileEntry e;
+        memset(&e, 0, sizeof(e));
+        e.offset = hdr.totalPoints; // LP: Converted to bytes below
+        e.Nsteps = res->Nsteps;
+        if(res->ray != nullptr) {
+            e.NumTopBnc = res->ray[res->Nsteps - 1].NumTopBnc;
+            e.NumBotBnc = res->ray[res->Nsteps - 1].NumBotBnc;
+        } else {
+            e.NumTopBnc = res->NumTopBnc;
+            e.NumBotBnc = res->NumBotBnc;
+        }
+        e.SrcDeclAngle = (float)res->SrcDeclAngle;
+        e.SrcAzimAngle = (float)res->SrcAzimAngle;
+        index.push_back(e);
+        hdr.totalPoints += (uint64_t)res->Nsteps;
+    }
+    hdr.NRays         = (int32_t)index.size();
+    uint64_t dataBase = hdr.indexOffset + index.size() * sizeof(RayFileEntry);
+    for(RayFileEntry &e : index) e.offset = dataBase + e.offset * dim * sizeof(float);
+
+    RAYFile.write((const char *)&hdr, sizeof(hdr));
+    RAYFile.write((const char *)grid.data(), grid.size() * sizeof(float));
+    RAYFile.write((const char *)index.data(), index.size() * sizeof(RayFileEntry));
+    std::vector<float> points;
+    for(int32_t r = 0; r < rayinfo->NRays; ++r) {
+        const RayResult<O3D, R3D> *res = &rayinfo->results[r];
+        if(res->ray == nullptr && res->compactX == nullptr) continue;
+        points.resize((size_t)res->Nsteps * dim);
+        for(int32_t is = 0; is < res->Nsteps; ++is) {
+            VEC23<O3D> x = RayToOceanX(GetRayX(res, is), res->org);
+            for(int32_t k = 0; k < dim; ++k) points[(size_t)is * dim + k] = (float)x[k];
+        }
+        RAYFile.write((const char *)points.data(), points.size() * sizeof(float));
+    }
+    if(!RAYFile.good()) EXTERR("Error writing binary ray file %s", path.c_str());
+}
+
+#if BHC_ENABLE_2D
+template void WriteOutRayBinary<false, false>(
+    const bhcParams<false> &params, const bhcOutputs<false, false> &outputs);
+#endif
+#if BHC_ENABLE_NX2D
+template void WriteOutRayBinary<true, false>(
+    const bhcParams<true> &params, const bhcOutputs<true, false> &outputs);
+#endif
+#if BHC_ENABLE_3D
+template void WriteOutRayBinary<true, true>(
+    const bhcParams<true> &params, const bhcOutputs<true, true> &outputs);
+#endif
+
+template<bool O3D, bool R3D> void ReadOutRayBinary(
+    bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs, const char *FileRoot)
+{
+    constexpr int32_t dim      = O3D ? 3 : 2;
+    RayInfo<O3D, R3D> *rayinfo = outputs.rayinfo;
+    std::string path           = std::string(FileRoot) + ".rayb";
+    std::ifstream RAYFile(path, std::ios::binary);
+    if(!RAYFile.good()) EXTERR("Could not open binary ray file %s", path.c_str());
+
+    RayFileHeader hdr;
+    RAYFile.read((char *)&hdr, sizeof(hdr));
+    if(!RAYFile.good() || memcmp(hdr.magic, RayFileMagic, sizeof(hdr.magic)) != 0) {
+        EXTERR("%s is not a binary ray file", path.c_str());
+    }
+    if(hdr.version != RayFileVersion) {
+        EXTERR(
+            "Binary ray file %s has version %d, only %d is supported", path.c_str(),
+            hdr.version, RayFileVersion);
+    }
+    if(hdr.dim != dim) {
+        EXTERR(
+            "Binary ray file %s has %d coordinates per point, must be %d", path.c_str(),
+            hdr.dim, dim);
+    }
+
+    std::string TempTitle(hdr.title, strnlen(hdr.title, sizeof(hdr.title)));
+    bhc::module::Title<O3D> title;
+    title.SetTitle(params, TempTitle);
+    params.freqinfo->freq0 = (real)hdr.freq0;
+    if(hdr.NSx != params.Pos->NSx || hdr.NSy != params.Pos->NSy
+       || hdr.NSz != params.Pos->NSz) {
+        EXTWARN(
+            "NSx = %d, NSy = %d, NSz = %d in RAYFile being loaded, but "
+            "%d, %d, %d in env file",
+            hdr.NSx, hdr.NSy, hdr.NSz, params.Pos->NSx, params.Pos->NSy,
+            params.Pos->NSz);
+    }
+    if(hdr.Nalpha != params.Angles->alpha.n || hdr.Nbeta != params.Angles->beta.n) {
+        EXTWARN(
+            "Warning, RAYFile has alphaN = %d, betaN = %d, but env file has %d, %d",
+            hdr.Nalpha, hdr.Nbeta, params.Angles->alpha.n, params.Angles->beta.n);
+    }
+    if(hdr.TopDepth != params.Bdry->Top.hs.Depth
+       || hdr.BotDepth != params.Bdry->Bot.hs.Depth) {
+        EXTWARN(
+            "Warning, RAYFile has top, bot depth = %f, %f, but env file has %f, %f",
+            hdr.TopDepth, hdr.BotDepth, params.Bdry->Top.hs.Depth,
+            params.Bdry->Bot.hs.Depth);
+    }
+    if(hdr.NRays < 0) EXTERR("Invalid number of rays in binary ray file");
+
+    std::vector<RayFileEntry> index(hdr.NRays);
+    RAYFile.seekg(hdr.indexOffset);
+    RAYFile.read((char *)index.data(), index.size() * sizeof(RayFileEntry));
+    if(!RAYFile.good()) EXTERR("Binary ray file %s is truncated", path.c_str());
+
+    trackdeallocate(params, rayinfo->RayMem);
+    trackdeallocate(params, rayinfo->WorkRayMem);
+    FreeCompactRays(params);
+    rayinfo->isCopyMode = rayinfo->isCompact = rayinfo->isStreamed = false;
+
+    rayinfo->NRays        = hdr.NRays;
+    rayinfo->RayMemPoints = rayinfo->RayMemCapacity = hdr.totalPoints;
+    rayinfo->MaxPointsPerRay                        = MaxN;
+    trackallocate(params, "ray metadata", rayinfo->results, rayinfo->NRays);
+    memset(rayinfo->results, 0, rayinfo->NRays * sizeof(RayResult<O3D, R3D>));
+    trackallocate(params, "rays", rayinfo->RayMem, rayinfo->RayMemCapacity);
+    memset(rayinfo->RayMem, 0, rayinfo->RayMemCapacity * sizeof(rayPt<R3D>));
+
+    std::vector<float> points;
+    size_t TotalPoints = 0;
+    for(int32_t r = 0; r < hdr.NRays; ++r) {
+        const RayFileEntry &e = index[r];
+        if(e.Nsteps <= 0 || TotalPoints + (size_t)e.Nsteps > hdr.totalPoints) {
+            EXTERR("Invalid number of points in ray in binary ray file");
+        }
+        if(e.NumTopBnc < 0 || e.NumBotBnc < 0) {
+            EXTERR("Invalid number of bounces in ray in binary ray file");
+        }
+        points.resize((size_t)e.Nsteps * dim);
+        RAYFile.seekg(e.offset);
+        RAYFile.read((char *)points.data(), points.size() * sizeof(float));
+        if(!RAYFile.good()) EXTERR("Binary ray file %s is truncated", path.c_str());
+
+        RayResult<O3D, R3D> *res = &rayinfo->results[r];
+        res->SrcDeclAngle        = e.SrcDeclAngle;
+        res->SrcAzimAngle        = e.SrcAzimAngle;
+        res->Nsteps              = e.Nsteps;
+        res->ray                 = &rayinfo->RayMem[TotalPoints];
+        auto GetPoint            = [&](int32_t is) {
+            VEC23<O3D> v;
+            for(int32_t k = 0; k < dim; ++k) v[k] = points[(size_t)is * dim + k];
+            return v;
+        };
+        VEC23<R3D> t(RL(0.0));
+        if constexpr(O3D && !R3D) {
+            VEC23<O3D> first = GetPoint(0);
+            res->org.xs      = first;
+            t                = XYCOMP(GetPoint(e.Nsteps - 1) - first);
+            t *= RL(1.0) / glm::length(t);
+            res->org.tradial = t;
+        }
+        res->ray[e.Nsteps - 1].NumTopBnc = e.NumTopBnc;
+        res->ray[e.Nsteps - 1].NumBotBnc = e.NumBotBnc;
+
+        ErrState errState;
+        ResetErrState(&errState);
+        for(int32_t is = 0; is < e.Nsteps; ++is) {
+            res->ray[is].x = OceanToRayX(GetPoint(is), res->org, t, -1, &errState);
+        }
+        CheckReportErrors(GetInternal(params), &errState);
+        TotalPoints += (size_t)e.Nsteps;
+    }
+}
+
 template<bool O3D, bool R3D> void ReadOutRay(
     bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs, const char *FileRoot)
 {
@@ -190,6 +499,10 @@ template<bool O3D, bool R3D> void ReadOutRay(
     if(!IsRayRun(params.Beam) && !IsEigenraysRun(params.Beam)) {
         EXTERR("ReadOutRay not in ray trace or eigenrays mode");
     }
+    if(GetInternal(params)->binaryRayFile) {
+        ReadOutRayBinary<O3D, R3D>(params, outputs, FileRoot);
+        return;
+    }
     LDIFile RAYFile(GetInternal(params), std::string(FileRoot) + ".ray");
 
     std::string TempTitle;
@@ -258,6 +571,8 @@ template<bool O3D, bool R3D> void ReadOutRay(
 
     trackdeallocate(params, rayinfo->RayMem);
     trackdeallocate(params, rayinfo->WorkRayMem);
+    FreeCompactRays(params);
+    rayinfo->isCopyMode = rayinfo->isCompact = rayinfo->isStreamed = false;
 
     [[maybe_unused]] std::vector<VEC23<O3D>> firstpoints;
     [[maybe_unused]] std::vector<VEC23<O3D>> lastpoints;
@@ -298,6 +613,7 @@ template<bool O3D, bool R3D> void ReadOutRay(
     rayinfo->RayMemPoints = rayinfo->RayMemCapacity = TotalPoints;
     rayinfo->MaxPointsPerRay                        = MaxN;
     trackallocate(params, "ray metadata", rayinfo->results, rayinfo->NRays);
+    memset(rayinfo->results, 0, rayinfo->NRays * sizeof(RayResult<O3D, R3D>));
     trackallocate(params, "rays", rayinfo->RayMem, rayinfo->RayMemCapacity);
     memset(rayinfo->RayMem, 0, rayinfo->RayMemCapacity * sizeof(rayPt<R3D>));
 
@@ -311,6 +627,7 @@ template<bool O3D, bool R3D> void ReadOutRay(
         if(!std::isfinite(alpha0)) break; // Nothing written, out of data
         if constexpr(O3D) alpha0 *= RadDeg;
         rayinfo->results[NRays].SrcDeclAngle = alpha0;
+        rayinfo->results[NRays].SrcAzimAngle = NAN; // LP: Not in the text file
 
         int32_t Nsteps = -1, NumTopBnc = -1, NumBotBnc = -1;
         LIST(RAYFile);
@@ -22,6 +22,139 @@ this program. If not, see <https://www.gnu.org/licenses/>.
 
 namespace bhc { namespace mode {
 
+template<bool O3D> void FreeCompactRays(const bhcParams<O3D> &params);
+extern template void FreeCompactRays<false>(const bhcParams<false> &params);
+extern template void FreeCompactRays<true>(const bhcParams<true> &params);
+
+/**
+ * Position of step is of the ray, from either full or compact storage.
+ */
+template<bool O3D, bool R3D> inline VEC23<R3D> GetRayX(
+    const RayResult<O3D, R3D> *res, int32_t is)
+{
+    if(res->ray != nullptr) return res->ray[is].x;
+    VEC23<R3D> x;
+    for(int32_t k = 0; k < (R3D ? 3 : 2); ++k) {
+        x[k] = (real)res->compactX[(size_t)k * res->Nsteps + is];
+    }
+    return x;
+}
+
+// LP: These are small enough that it's not really necessary to compile
+// them separately.
+
+template<bool O3D> inline void OpenRAYFile(
+    LDOFile &RAYFile, std::string FileRoot, const bhcParams<O3D> &params)
+{
+    if(!IsRayRun(params.Beam) && !IsEigenraysRun(params.Beam)) {
+        EXTERR("OpenRAYFile not in ray trace or eigenrays mode");
+    }
+    RAYFile.open(FileRoot + ".ray");
+    RAYFile << params.Title << '\n';
+    RAYFile << params.freqinfo->freq0 << '\n';
+    RAYFile << params.Pos->NSx << params.Pos->NSy << params.Pos->NSz << '\n';
+    RAYFile << params.Angles->alpha.n << params.Angles->beta.n << '\n';
+    RAYFile << params.Bdry->Top.hs.Depth << '\n';
+    RAYFile << params.Bdry->Bot.hs.Depth << '\n';
+    RAYFile << (O3D ? "xyz" : "rz") << '\n';
+}
+
+/**
+ * Compress the ray data keeping every iSkip point, points near surface or bottom, and
+ * last point.
+ *
+ * The 2D version is for ray traces in (r,z) coordinates
+ * The 3D version is for ray traces in (x,y,z) coordinates
+ */
+template<bool O3D, bool R3D> inline void CompressRay(
+    RayResult<O3D, R3D> *res, const BdryType *Bdry)
+{
+    // this is the maximum length of the ray vector that is written out
+    constexpr int32_t MaxNRayPoints = 500000;
+
+    // compression
+    // LP: This is silly for two reasons:
+    // 1) MaxN (maximum number of steps for a ray) is 100000, but MaxNRayPoints
+    //    is 500000. Therefore iSkip will always be 1, and the whole vector will
+    //    always be written.
+    // 2) Even if these constants were changed, the formula for iSkip is not
+    //    ideal: iSkip will only become 2 once the number of steps in the ray is
+    //    more than 2x MaxNRayPoints. If it's less than this, it'll just be
+    //    truncated, which is arguably worse than skipping every other step.
+    // So we'll just make sure this doesn't run unless the constants are changed.
+    if constexpr(MaxN > MaxNRayPoints) {
+        int32_t n2    = 1;
+        int32_t iSkip = bhc::max(res->Nsteps / MaxNRayPoints, 1);
+        if constexpr(R3D) iSkip = 1; // LP: overrides line above
+
+        constexpr int32_t dim = R3D ? 3 : 2;
+        for(int32_t is = 1; is < res->Nsteps; ++is) {
+            // ensure that we always write ray points near bdry reflections (2D only:
+            // works only for flat bdry)
+            VEC23<R3D> x = GetRayX(res, is);
+            if(bhc::min(Bdry->Bot.hs.Depth - DEP(x), DEP(x) - Bdry->Top.hs.Depth)
+                   < FL(0.2)
+               || (is % iSkip) == 0 || is == res->Nsteps - 1) {
+                ++n2;
+                if(res->ray != nullptr) {
+                    res->ray[n2 - 1].x = x;
+                } else {
+                    // LP: In place, coordinates are moved to lower indexes
+                    // in all the arrays, which are repacked below.
+                    for(int32_t k = 0; k < dim; ++k) {
+                        res->compactX[(size_t)k * res->Nsteps + n2 - 1]
+                            = (float)x[k];
+                    }
+                }
+            }
+        }
+        if(res->ray == nullptr) {
+            for(int32_t k = 1; k < dim; ++k) {
+                memmove(
+                    &res->compactX[(size_t)k * n2],
+                    &res->compactX[(size_t)k * res->Nsteps], n2 * sizeof(float));
+            }
+        }
+        res->Nsteps = n2;
+    }
+}
+
+/**
+ * Formats the ray as text for the RAYFile, appending to s. This is the same as
+ * writing it with LDOFile, but much faster and thread-safe.
+ */
+template<bool O3D, bool R3D> inline void FormatRay(
+    std::string &s, const RayResult<O3D, R3D> *res)
+{
+    // take-off angle of this ray [LP: 2D: degrees, 3D: radians]
+    real alpha0 = res->SrcDeclAngle;
+    if constexpr(O3D) alpha0 *= DegRad;
+    AppendFortran(s, alpha0);
+    s += '\n';
+
+    AppendFortran(s, res->Nsteps);
+    if(res->ray != nullptr) {
+        AppendFortran(s, res->ray[res->Nsteps - 1].NumTopBnc);
+        AppendFortran(s, res->ray[res->Nsteps - 1].NumBotBnc);
+        s += '\n';
+        for(int32_t is = 0; is < res->Nsteps; ++is) {
+            VEC23<O3D> x = RayToOceanX(res->ray[is].x, res->org);
+            for(int32_t k = 0; k < (O3D ? 3 : 2); ++k) AppendFortran(s, x[k]);
+            s += '\n';
+        }
+    } else {
+        // Compact rays only have float precision, so write them as float
+        AppendFortran(s, res->NumTopBnc);
+        AppendFortran(s, res->NumBotBnc);
+        s += '\n';
+        for(int32_t is = 0; is < res->Nsteps; ++is) {
+            VEC23<O3D> x = RayToOceanX(GetRayX(res, is), res->org);
+            for(int32_t k = 0; k < (O3D ? 3 : 2); ++k) AppendFortran(s, (float)x[k]);
+            s += '\n';
+        }
+    }
+}
+
 template<bool O3D, bool R3D> bool RunRay(
     RayInfo<O3D, R3D> *rayinfo, const bhcParams<O3D> &params, int32_t job, int32_t worker,
     RayInitInfo &rinit, int32_t &Nsteps, ErrState *errState);
@@ -44,6 +177,15 @@ extern template void RunRayMode<true, false>(
 extern template void RunRayMode<true, true>(
     bhcParams<true> &params, bhcOutputs<true, true> &outputs);
 
+template<bool O3D, bool R3D> void WriteOutRayBinary(
+    const bhcParams<O3D> &params, const bhcOutputs<O3D, R3D> &outputs);
+extern template void WriteOutRayBinary<false, false>(
+    const bhcParams<false> &params, const bhcOutputs<false, false> &outputs);
+extern template void WriteOutRayBinary<true, false>(
+    const bhcParams<true> &params, const bhcOutputs<true, false> &outputs);
+extern template void WriteOutRayBinary<true, true>(
+    const bhcParams<true> &params, const bhcOutputs<true, true> &outputs);
+
 template<bool O3D, bool R3D> void ReadOutRay(
     bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs, const char *FileRoot);
 extern template void ReadOutRay<false, false>(
@@ -68,6 +210,9 @@ public:
         outputs.rayinfo->RayMemPoints    = 0;
         outputs.rayinfo->MaxPointsPerRay = 0;
         outputs.rayinfo->NRays           = 0;
+        outputs.rayinfo->isCopyMode      = false;
+        outputs.rayinfo->isCompact       = false;
+        outputs.rayinfo->isStreamed      = false;
     }
 
     virtual void Preprocess(
@@ -77,6 +222,7 @@ public:
 
         trackdeallocate(params, rayinfo->RayMem);
         trackdeallocate(params, rayinfo->WorkRayMem);
+        FreeCompactRays(params);
         rayinfo->NRays = IsEigenraysRun(params.Beam)
             ? outputs.eigen->neigen
             : GetNumJobs<O3D>(params.Pos, params.Angles);
@@ -86,6 +232,32 @@ public:
 
         rayinfo->MaxPointsPerRay = MaxN;
         rayinfo->isCopyMode      = false;
+        rayinfo->isCompact       = GetInternal(params)->compactRays;
+        rayinfo->isStreamed = GetInternal(params)->streamRays
+            && !GetInternal(params)->binaryRayFile && IsRayRun(params.Beam);
+        rayinfo->RayMemPoints = 0;
+        if(rayinfo->isStreamed) {
+            if(GetInternal(params)->noEnvFil) {
+                EXTERR("Cannot stream rays to a file without a FileRoot");
+            }
+            // Each worker traces into its own work memory, and the ray is
+            // written out from there; nothing is kept.
+            trackallocate(
+                params, "work rays for streaming", rayinfo->WorkRayMem,
+                GetInternal(params)->numThreads * MaxN);
+            rayinfo->isCompact      = false;
+            rayinfo->RayMemCapacity = 0;
+            return;
+        }
+        if(rayinfo->isCompact) {
+            // Each worker traces into full-size work memory, and the compact
+            // copies are allocated in chunks as rays are finished.
+            trackallocate(
+                params, "work rays for compact mode", rayinfo->WorkRayMem,
+                GetInternal(params)->numThreads * MaxN);
+            rayinfo->RayMemCapacity = 0;
+            return;
+        }
         size_t needtotalsize = (size_t)rayinfo->NRays * (size_t)MaxN * sizeof(rayPt<R3D>);
         if(GetInternal(params)->usedMemory + needtotalsize
            <= GetInternal(params)->maxMemory) {
@@ -114,7 +286,6 @@ public:
                 * (size_t)rayinfo->MaxPointsPerRay;
         }
         trackallocate(params, "rays", rayinfo->RayMem, rayinfo->RayMemCapacity);
-        rayinfo->RayMemPoints = 0;
     }
 
     virtual void Run(bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs) const override
@@ -128,7 +299,7 @@ public:
         RayInfo<O3D, R3D> *rayinfo = outputs.rayinfo;
         for(int r = 0; r < rayinfo->NRays; ++r) {
             RayResult<O3D, R3D> *res = &rayinfo->results[r];
-            if(res->ray == nullptr) continue;
+            if(res->ray == nullptr && res->compactX == nullptr) continue;
             CompressRay(res, params.Bdry);
         }
     }
@@ -137,12 +308,20 @@ public:
         const bhcParams<O3D> &params, const bhcOutputs<O3D, R3D> &outputs) const override
     {
         RayInfo<O3D, R3D> *rayinfo = outputs.rayinfo;
+        if(rayinfo->isStreamed) return; // Already written during the run
+        if(GetInternal(params)->binaryRayFile) {
+            WriteOutRayBinary<O3D, R3D>(params, outputs);
+            return;
+        }
         LDOFile RAYFile;
         OpenRAYFile(RAYFile, GetInternal(params)->FileRoot, params);
+        std::string text;
         for(int r = 0; r < rayinfo->NRays; ++r) {
             const RayResult<O3D, R3D> *res = &rayinfo->results[r];
-            if(res->ray == nullptr) continue;
-            WriteRay(RAYFile, res);
+            if(res->ray == nullptr && res->compactX == nullptr) continue;
+            text.clear();
+            FormatRay(text, res);
+            RAYFile.write(text);
         }
     }
 
@@ -159,87 +338,7 @@ public:
         trackdeallocate(params, outputs.rayinfo->results);
         trackdeallocate(params, outputs.rayinfo->RayMem);
         trackdeallocate(params, outputs.rayinfo->WorkRayMem);
-    }
-
-private:
-    // LP: These are small enough that it's not really necessary to compile
-    // them separately.
-
-    inline void OpenRAYFile(
-        LDOFile &RAYFile, std::string FileRoot, const bhcParams<O3D> &params) const
-    {
-        if(!IsRayRun(params.Beam) && !IsEigenraysRun(params.Beam)) {
-            EXTERR("OpenRAYFile not in ray trace or eigenrays mode");
-        }
-        RAYFile.open(FileRoot + ".ray");
-        RAYFile << params.Title << '\n';
-        RAYFile << params.freqinfo->freq0 << '\n';
-        RAYFile << params.Pos->NSx << params.Pos->NSy << params.Pos->NSz << '\n';
-        RAYFile << params.Angles->alpha.n << params.Angles->beta.n << '\n';
-        RAYFile << params.Bdry->Top.hs.Depth << '\n';
-        RAYFile << params.Bdry->Bot.hs.Depth << '\n';
-        RAYFile << (O3D ? "xyz" : "rz") << '\n';
-    }
-
-    /**
-     * Compress the ray data keeping every iSkip point, points near surface or bottom, and
-     * last point.
-     *
-     * The 2D version is for ray traces in (r,z) coordinates
-     * The 3D version is for ray traces in (x,y,z) coordinates
-     */
-    inline void CompressRay(RayResult<O3D, R3D> *res, const BdryType *Bdry) const
-    {
-        // this is the maximum length of the ray vector that is written out
-        constexpr int32_t MaxNRayPoints = 500000;
-
-        // compression
-        // LP: This is silly for two reasons:
-        // 1) MaxN (maximum number of steps for a ray) is 100000, but MaxNRayPoints
-        //    is 500000. Therefore iSkip will always be 1, and the whole vector will
-        //    always be written.
-        // 2) Even if these constants were changed, the formula for iSkip is not
-        //    ideal: iSkip will only become 2 once the number of steps in the ray is
-        //    more than 2x MaxNRayPoints. If it's less than this, it'll just be
-        //    truncated, which is arguably worse than skipping every other step.
-        // So we'll just make sure this doesn't run unless the constants are changed.
-        if constexpr(MaxN > MaxNRayPoints) {
-            int32_t n2    = 1;
-            int32_t iSkip = bhc::max(res->Nsteps / MaxNRayPoints, 1);
-            if constexpr(R3D) iSkip = 1; // LP: overrides line above
-
-            for(int32_t is = 1; is < res->Nsteps; ++is) {
-                // ensure that we always write ray points near bdry reflections (2D only:
-                // works only for flat bdry)
-                if(bhc::min(
-                       Bdry->Bot.hs.Depth - DEP(res->ray[is].x),
-                       DEP(res->ray[is].x) - Bdry->Top.hs.Depth)
-                       < FL(0.2)
-                   || (is % iSkip) == 0 || is == res->Nsteps - 1) {
-                    ++n2;
-                    res->ray[n2 - 1].x = res->ray[is].x;
-                }
-            }
-            res->Nsteps = n2;
-        }
-    }
-
-    /**
-     * Write to RAYFile.
-     */
-    inline void WriteRay(LDOFile &RAYFile, const RayResult<O3D, R3D> *res) const
-    {
-        // take-off angle of this ray [LP: 2D: degrees, 3D: radians]
-        real alpha0 = res->SrcDeclAngle;
-        if constexpr(O3D) alpha0 *= DegRad;
-        RAYFile << alpha0 << '\n';
-
-        RAYFile << res->Nsteps;
-        RAYFile << res->ray[res->Nsteps - 1].NumTopBnc;
-        RAYFile << res->ray[res->Nsteps - 1].NumBotBnc << '\n';
-        for(int32_t is = 0; is < res->Nsteps; ++is) {
-            RAYFile << RayToOceanX(res->ray[is].x, res->org) << '\n';
-        }
+        FreeCompactRays(params);
     }
 };
 
@@ -0,0 +1,341 @@
+/*
+bellhopcxx / bellhopcuda - C++/CUDA port of BELLHOP(3D) underwater acoustics simulator
+Copyright (C) 2021-2023 The Regents of the University of California
+Marine Physical Lab at Scripps Oceanography, c/o Jules Jaffe, jjaffe@ucsd.edu
+Based on BELLHOP / BELLHOP3D, which is Copyright (C) 1983-2022 Michael B. Porter
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "raycache.hpp"
+
+namespace bhc { namespace mode {
+
+namespace {
+
+/**
+ * Hash of the contents of the inputs, not their addresses. Not
+ * cryptographic; a collision would only make the cache be used when it should
+ * not be, so 64 bits is plenty.
+ */
+class KeyHasher {
+public:
+    KeyHasher() : h(0x9E3779B97F4A7C15ull) {}
+
+    void Bytes(const void *data, size_t n)
+    {
+        const uint8_t *d = (const uint8_t *)data;
+        for(; n >= 8; n -= 8, d += 8) {
+            uint64_t w;
+            memcpy(&w, d, 8);
+            Mix(w);
+        }
+        if(n > 0) {
+            uint64_t w = 0;
+            memcpy(&w, d, n);
+            Mix(w);
+        }
+    }
+    template<typename T> void Value(const T &v) { Bytes(&v, sizeof(T)); }
+    template<typename T> void Array(const T *a, size_t n)
+    {
+        Value(n);
+        if(a != nullptr) Bytes(a, n * sizeof(T));
+    }
+    uint64_t Get() const { return h; }
+
+private:
+    uint64_t h;
+
+    void Mix(uint64_t w)
+    {
+        h = (h ^ w) * 0x100000001B3ull;
+        h ^= h >> 29;
+    }
+};
+
+template<bool O3D> void HashBdry(KeyHasher &k, const BdryInfoTopBot<O3D> &bd)
+{
+    k.Value(bd.NPts);
+    k.Value(bd.type);
+    size_t n;
+    if constexpr(O3D) {
+        n = (size_t)bd.NPts.x * (size_t)bd.NPts.y;
+        if(bd.bd == nullptr) {
+            k.Array(bd.gridx, bd.NPts.x);
+            k.Array(bd.gridy, bd.NPts.y);
+            k.Array(bd.depth, n);
+            return;
+        }
+    } else {
+        n = (size_t)bd.NPts;
+    }
+    k.Array(bd.bd, n);
+}
+
+void HashRefl(KeyHasher &k, const ReflectionInfoTopBot &refl)
+{
+    k.Value(refl.NPts);
+    k.Array(refl.r, refl.NPts);
+}
+
+void HashSSP(KeyHasher &k, const SSPStructure *ssp)
+{
+    size_t n = (size_t)ssp->NPts;
+    k.Value(ssp->Type);
+    k.Value(ssp->AttenUnit);
+    k.Array(ssp->c, n);
+    k.Array(ssp->cz, n);
+    k.Array(ssp->n2, n);
+    k.Array(ssp->n2z, n);
+    for(int32_t i = 0; i < 4; ++i) {
+        k.Array(ssp->cSpline[i], n);
+        k.Array(ssp->cCoef[i], n);
+    }
+    k.Array(ssp->z, n);
+    k.Array(ssp->rho, n);
+    if(ssp->Type == 'Q') {
+        k.Array(ssp->cMat, n * ssp->Nr);
+        k.Array(ssp->czMat, (n - 1) * ssp->Nr);
+        k.Array(ssp->Seg.r, ssp->Nr);
+    } else if(ssp->Type == 'H') {
+        size_t nxy = (size_t)ssp->Nx * (size_t)ssp->Ny;
+        k.Array(ssp->cMat, nxy * ssp->Nz);
+        k.Array(ssp->czMat, nxy * (ssp->Nz - 1));
+        k.Array(ssp->Seg.x, ssp->Nx);
+        k.Array(ssp->Seg.y, ssp->Ny);
+        k.Array(ssp->Seg.z, ssp->Nz);
+    }
+}
+
+void HashAngles(KeyHasher &k, const AngleInfo &a)
+{
+    k.Value(a.n);
+    k.Value(a.iSingle);
+    k.Value(a.d);
+    k.Array(a.angles, a.n);
+}
+
+/**
+ * Everything the rays depend on, after preprocessing: all the inputs except
+ * the receivers. (In Nx2D, the receiver bearings are the ray bearings, which
+ * are in Angles->beta.)
+ */
+template<bool O3D> uint64_t RayCacheKey(const bhcParams<O3D> &params)
+{
+    KeyHasher k;
+    k.Value(*params.Bdry);
+    HashBdry<O3D>(k, params.bdinfo->top);
+    HashBdry<O3D>(k, params.bdinfo->bot);
+    HashRefl(k, params.refl->bot);
+    HashRefl(k, params.refl->top);
+    HashSSP(k, params.ssp);
+    k.Value(*params.atten);
+    const Position *Pos = params.Pos;
+    k.Array(Pos->Sx, Pos->NSx);
+    k.Array(Pos->Sy, Pos->NSy);
+    k.Array(Pos->Sz, Pos->NSz);
+    HashAngles(k, params.Angles->alpha);
+    if constexpr(O3D) HashAngles(k, params.Angles->beta);
+    k.Value(params.freqinfo->freq0);
+    k.Array(params.freqinfo->freqVec, params.freqinfo->Nfreq);
+    k.Value(*params.Beam);
+    k.Value(params.sbp->SBPFlag);
+    k.Array(params.sbp->SrcBmPat, 2 * params.sbp->NSBPPts);
+    return k.Get();
+}
+
+/**
+ * Allocates like trackallocate, so the chunk can be freed with
+ * trackdeallocate, but without counting it in bhcInternal::usedMemory, which
+ * is not safe from the workers. Returns the size to be counted.
+ */
+size_t AllocateChunk(uint8_t *&chunk, size_t bytes)
+{
+    uint64_t s2 = (((uint64_t)bytes + 15ull) & ~15ull) + 16ull;
+    uint64_t *ptr2;
+#ifdef BHC_BUILD_CUDA
+    checkCudaErrors(cudaMallocManaged(&ptr2, s2));
+#else
+    ptr2 = (uint64_t *)malloc(s2);
+#endif
+    if(ptr2 == nullptr) return 0;
+    *ptr2 = s2;
+    chunk = (uint8_t *)(ptr2 + 2);
+    return s2;
+}
+
+/// Counts the chunks allocated by the workers in usedMemory.
+template<bool O3D> void CountPendingMemory(const bhcParams<O3D> &params)
+{
+    bhcInternal *internal = GetInternal(params);
+    RayCacheState &cache  = internal->rayCache;
+    internal->usedMemory += cache.pendingMemory;
+    internal->peakMemory = bhc::max(internal->peakMemory, internal->usedMemory);
+    cache.pendingMemory  = 0;
+}
+
+} // namespace
+
+template<bool O3D> void FreeRayCache(const bhcParams<O3D> &params)
+{
+    RayCacheState &cache = GetInternal(params)->rayCache;
+    CountPendingMemory<O3D>(params);
+    for(uint8_t *&chunk : cache.chunks) trackdeallocate(params, chunk);
+    cache.chunks.clear();
+    trackdeallocate(params, cache.rays);
+    trackdeallocate(params, cache.pointBuffers);
+    cache.mode    = RayCacheState::Mode::Off;
+    cache.valid   = false;
+    cache.numRays = cache.numCached = 0;
+    cache.chunkUsed = cache.chunkCapacity = 0;
+    cache.memory    = 0;
+}
+
+template<bool O3D, bool R3D> void PrepareRayCache(bhcParams<O3D> &params)
+{
+    bhcInternal *internal = GetInternal(params);
+    RayCacheState &cache  = internal->rayCache;
+    cache.mode            = RayCacheState::Mode::Off;
+    if(!internal->cacheRays) return;
+#ifdef BHC_BUILD_CUDA
+    return;
+#endif
+    if(IsCervenyInfl(params.Beam)
+       || (IsTLRun(params.Beam) && params.freqinfo->Nfreq > 1)) {
+        FreeRayCache<O3D>(params);
+        return;
+    }
+    uint64_t key    = RayCacheKey<O3D>(params);
+    int32_t numRays = GetNumJobs<O3D>(params.Pos, params.Angles);
+    if(cache.valid && cache.key == key && cache.numRays == numRays) {
+        cache.mode = RayCacheState::Mode::Replay;
+        internal->PRTFile << "\nOnly the receivers changed, using " << cache.numCached
+                          << " of " << numRays << " rays from the previous run\n";
+        return;
+    }
+    FreeRayCache<O3D>(params);
+    size_t indexSize = (size_t)numRays * sizeof(CachedRay<O3D, R3D>);
+    // LP: Allocation overhead, see trackallocate.
+    if(indexSize + 32 > (internal->maxMemory - internal->usedMemory) / 2) return;
+    size_t usedBefore = internal->usedMemory;
+    trackallocate(params, "ray cache", cache.rays, indexSize);
+    cache.memory  = internal->usedMemory - usedBefore;
+    cache.key     = key;
+    cache.numRays = numRays;
+    cache.mode    = RayCacheState::Mode::Record;
+}
+
+template<bool O3D, bool R3D> void StartRayCache(const bhcParams<O3D> &params)
+{
+    bhcInternal *internal = GetInternal(params);
+    RayCacheState &cache  = internal->rayCache;
+    if(cache.mode != RayCacheState::Mode::Record) return;
+    // LP: On the CPU, only the pages of the buffers which are used (by the
+    // longest ray each worker traces) take physical memory.
+    size_t bufBytes = (size_t)internal->numThreads * MaxN * sizeof(CachedRayPt<R3D>);
+    if(bufBytes + 32 > (internal->maxMemory - internal->usedMemory) / 2) {
+        FreeRayCache<O3D>(params);
+        return;
+    }
+    trackallocate(params, "ray cache", cache.pointBuffers, bufBytes);
+    cache.budget = (internal->maxMemory - internal->usedMemory) / 2;
+}
+
+template<bool O3D, bool R3D> void StoreCachedRay(
+    const bhcParams<O3D> &params, CachedRay<O3D, R3D> &cray,
+    const CachedRayPt<R3D> *points, int32_t numPoints)
+{
+    // 16 MiB per chunk, roughly 170000 2D ray points
+    constexpr size_t ChunkBytes = 16ull * 1024ull * 1024ull;
+    if(numPoints == 0) return;
+    size_t bytes         = (size_t)numPoints * sizeof(CachedRayPt<R3D>);
+    RayCacheState &cache = GetInternal(params)->rayCache;
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    if(cache.chunks.empty() || cache.chunkUsed + bytes > cache.chunkCapacity) {
+        // LP: Allocation overhead, see trackallocate.
+        size_t avail = cache.budget - bhc::min(cache.budget, cache.memory + 32);
+        size_t cap   = bhc::min(bhc::max(bytes, ChunkBytes), avail) & ~15ull;
+        if(cap < bytes) return;
+        uint8_t *chunk = nullptr;
+        size_t s2      = AllocateChunk(chunk, cap);
+        if(s2 == 0) return;
+        cache.memory += s2;
+        cache.pendingMemory += s2;
+        cache.chunks.push_back(chunk);
+        cache.chunkUsed     = 0;
+        cache.chunkCapacity = cap;
+    }
+    cray.points = (CachedRayPt<R3D> *)&cache.chunks.back()[cache.chunkUsed];
+    memcpy(cray.points, points, bytes);
+    // Keep the points aligned
+    cache.chunkUsed += (bytes + 15ull) & ~15ull;
+    ++cache.numCached;
+}
+
+template<bool O3D> void FinishRayCache(const bhcParams<O3D> &params, bool failed)
+{
+    RayCacheState &cache = GetInternal(params)->rayCache;
+    if(cache.mode != RayCacheState::Mode::Record) return;
+    CountPendingMemory<O3D>(params);
+    trackdeallocate(params, cache.pointBuffers);
+    if(failed) {
+        FreeRayCache<O3D>(params);
+        return;
+    }
+    cache.valid = true;
+    GetInternal(params)->PRTFile
+        << "\nStored " << cache.numCached << " of " << cache.numRays
+        << " rays for runs with other receivers ("
+        << (cache.memory / (1024ull * 1024ull)) << " MiB)\n";
+}
+
+template<bool O3D> void MakeRoomInRayCache(const bhcParams<O3D> &params, size_t bytes)
+{
+    bhcInternal *internal = GetInternal(params);
+    if(internal->rayCache.rays == nullptr) return;
+    // LP: Allocation overhead, see trackallocate.
+    if(internal->usedMemory + bytes + 32 <= internal->maxMemory) return;
+    FreeRayCache<O3D>(params);
+}
+
+#if BHC_ENABLE_2D
+template void FreeRayCache<false>(const bhcParams<false> &params);
+template void PrepareRayCache<false, false>(bhcParams<false> &params);
+template void StartRayCache<false, false>(const bhcParams<false> &params);
+template void StoreCachedRay<false, false>(
+    const bhcParams<false> &params, CachedRay<false, false> &cray,
+    const CachedRayPt<false> *points, int32_t numPoints);
+template void FinishRayCache<false>(const bhcParams<false> &params, bool failed);
+template void MakeRoomInRayCache<false>(const bhcParams<false> &params, size_t bytes);
+#endif
+#if BHC_ENABLE_NX2D || BHC_ENABLE_3D
+template void FreeRayCache<true>(const bhcParams<true> &params);
+template void FinishRayCache<true>(const bhcParams<true> &params, bool failed);
+template void MakeRoomInRayCache<true>(const bhcParams<true> &params, size_t bytes);
+#endif
+#if BHC_ENABLE_NX2D
+template void PrepareRayCache<true, false>(bhcParams<true> &params);
+template void StartRayCache<true, false>(const bhcParams<true> &params);
+template void StoreCachedRay<true, false>(
+    const bhcParams<true> &params, CachedRay<true, false> &cray,
+    const CachedRayPt<false> *points, int32_t numPoints);
+#endif
+#if BHC_ENABLE_3D
+template void PrepareRayCache<true, true>(bhcParams<true> &params);
+template void StartRayCache<true, true>(const bhcParams<true> &params);
+template void StoreCachedRay<true, true>(
+    const bhcParams<true> &params, CachedRay<true, true> &cray,
+    const CachedRayPt<true> *points, int32_t numPoints);
+#endif
+
+}} // namespace bhc::mode
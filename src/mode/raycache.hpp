@@ -0,0 +1,360 @@
+/*
+bellhopcxx / bellhopcuda - C++/CUDA port of BELLHOP(3D) underwater acoustics simulator
+Copyright (C) 2021-2023 The Regents of the University of California
+Marine Physical Lab at Scripps Oceanography, c/o Jules Jaffe, jjaffe@ucsd.edu
+Based on BELLHOP / BELLHOP3D, which is Copyright (C) 1983-2022 Michael B. Porter
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "../common_setup.hpp"
+#include "../trace.hpp"
+
+namespace bhc { namespace mode {
+
+/**
+ * Ray caching (bhcInit::cacheRays): the ray paths do not depend on the
+ * receivers at all, so if only the receivers change between runs, the
+ * influence functions can be applied to the paths from the previous run
+ * instead of tracing the rays again.
+ *
+ * A ray point is only stored with the members the influence functions read,
+ * which are exactly the ones of rayPt except p (only used by Cerveny beams,
+ * which are not supported). They are not reduced in precision, because the
+ * results have to be the same as from tracing.
+ */
+template<bool R3D> struct CachedRayPtExtras {};
+template<> struct CachedRayPtExtras<false> {
+    vec2 q;
+};
+template<> struct CachedRayPtExtras<true> {
+    mat2x2 q;
+    real phi;
+};
+template<bool R3D> struct CachedRayPt : public CachedRayPtExtras<R3D> {
+    int32_t NumTopBnc, NumBotBnc;
+    VEC23<R3D> x, t;
+    real c, Amp, Phase;
+    cpx tau;
+};
+
+template<bool O3D, bool R3D> struct CachedRay {
+    RayInitInfo rinit;
+    Origin<O3D, R3D> org;
+    /// nullptr if there was no room to store this ray, then it is traced again
+    CachedRayPt<R3D> *points;
+    /// Number of points, or 0 if the ray was not traced (RayInit failed)
+    int32_t Nsteps;
+    /// Sound speed at the source, for CheckEnoughBeams
+    real c0;
+    /// Warnings from tracing this ray, except BHC_WARN_TOO_FEW_BEAMS, which
+    /// depends on the receivers and is checked again.
+    uint32_t warning, warnCount;
+};
+
+template<bool R3D> inline void ToCachedRayPt(CachedRayPt<R3D> &dst, const rayPt<R3D> &src)
+{
+    dst.q = src.q;
+    if constexpr(R3D) dst.phi = src.phi;
+    dst.NumTopBnc = src.NumTopBnc;
+    dst.NumBotBnc = src.NumBotBnc;
+    dst.x         = src.x;
+    dst.t         = src.t;
+    dst.c         = src.c;
+    dst.Amp       = src.Amp;
+    dst.Phase     = src.Phase;
+    dst.tau       = src.tau;
+}
+
+template<bool R3D> inline void FromCachedRayPt(
+    rayPt<R3D> &dst, const CachedRayPt<R3D> &src)
+{
+    if constexpr(R3D) {
+        dst.p   = mat2x2(RL(0.0));
+        dst.phi = src.phi;
+    } else {
+        dst.p = vec2(RL(0.0), RL(0.0));
+    }
+    dst.q         = src.q;
+    dst.NumTopBnc = src.NumTopBnc;
+    dst.NumBotBnc = src.NumBotBnc;
+    dst.x         = src.x;
+    dst.t         = src.t;
+    dst.c         = src.c;
+    dst.Amp       = src.Amp;
+    dst.Phase     = src.Phase;
+    dst.tau       = src.tau;
+}
+
+template<bool O3D, bool R3D> inline CachedRay<O3D, R3D> &GetCachedRay(
+    const bhcParams<O3D> &params, int32_t job)
+{
+    RayCacheState &cache = GetInternal(params)->rayCache;
+    return reinterpret_cast<CachedRay<O3D, R3D> *>(cache.rays)[job];
+}
+
+/**
+ * Decides whether this run records or replays the rays, or does not use the
+ * cache, and frees the cache if it is outdated. Call at the start of the
+ * field mode preprocessing.
+ */
+template<bool O3D, bool R3D> void PrepareRayCache(bhcParams<O3D> &params);
+extern template void PrepareRayCache<false, false>(bhcParams<false> &params);
+extern template void PrepareRayCache<true, false>(bhcParams<true> &params);
+extern template void PrepareRayCache<true, true>(bhcParams<true> &params);
+
+/**
+ * Allocates each worker's buffer for the points of the ray it is recording and
+ * sets the memory budget for the stored rays. Call after all other allocations
+ * for the run; if there is no room for the buffers, the rays are not recorded.
+ */
+template<bool O3D, bool R3D> void StartRayCache(const bhcParams<O3D> &params);
+extern template void StartRayCache<false, false>(const bhcParams<false> &params);
+extern template void StartRayCache<true, false>(const bhcParams<true> &params);
+extern template void StartRayCache<true, true>(const bhcParams<true> &params);
+
+/// Worker's buffer for the points of one ray, MaxN long (see RayTerminate).
+template<bool O3D, bool R3D> inline CachedRayPt<R3D> *GetRayCachePoints(
+    const bhcParams<O3D> &params, int32_t worker)
+{
+    RayCacheState &cache = GetInternal(params)->rayCache;
+    return reinterpret_cast<CachedRayPt<R3D> *>(cache.pointBuffers)
+        + (size_t)worker * MaxN;
+}
+
+/**
+ * Copies the points of a recorded ray into the cache, if there is room.
+ * Thread-safe. The memory of the stored rays is only added to
+ * bhcInternal::usedMemory by FinishRayCache, after the workers have finished,
+ * as nothing else is synchronized with them.
+ */
+template<bool O3D, bool R3D> void StoreCachedRay(
+    const bhcParams<O3D> &params, CachedRay<O3D, R3D> &cray,
+    const CachedRayPt<R3D> *points, int32_t numPoints);
+extern template void StoreCachedRay<false, false>(
+    const bhcParams<false> &params, CachedRay<false, false> &cray,
+    const CachedRayPt<false> *points, int32_t numPoints);
+extern template void StoreCachedRay<true, false>(
+    const bhcParams<true> &params, CachedRay<true, false> &cray,
+    const CachedRayPt<false> *points, int32_t numPoints);
+extern template void StoreCachedRay<true, true>(
+    const bhcParams<true> &params, CachedRay<true, true> &cray,
+    const CachedRayPt<true> *points, int32_t numPoints);
+
+/**
+ * Call after the run; frees the workers' buffers, and discards the recording
+ * if the run failed.
+ */
+template<bool O3D> void FinishRayCache(const bhcParams<O3D> &params, bool failed);
+extern template void FinishRayCache<false>(const bhcParams<false> &params, bool failed);
+extern template void FinishRayCache<true>(const bhcParams<true> &params, bool failed);
+
+template<bool O3D> void FreeRayCache(const bhcParams<O3D> &params);
+extern template void FreeRayCache<false>(const bhcParams<false> &params);
+extern template void FreeRayCache<true>(const bhcParams<true> &params);
+
+/**
+ * Frees the cache (so the rays will be traced) if that is necessary for an
+ * allocation of the given size to fit.
+ */
+template<bool O3D> void MakeRoomInRayCache(const bhcParams<O3D> &params, size_t bytes);
+extern template void MakeRoomInRayCache<false>(
+    const bhcParams<false> &params, size_t bytes);
+extern template void MakeRoomInRayCache<true>(
+    const bhcParams<true> &params, size_t bytes);
+
+inline void AddErrState(ErrState *errState, uint32_t warning, uint32_t warnCount)
+{
+    if(warnCount == 0) return;
+    errState->warnCount.fetch_add(warnCount, STD::memory_order_relaxed);
+    errState->warning.fetch_or(warning, STD::memory_order_relaxed);
+}
+
+inline void AddErrState(ErrState *errState, const ErrState *rayErrState)
+{
+    uint32_t error = rayErrState->error.load(STD::memory_order_relaxed);
+    if(error != 0) {
+        errState->errCount.fetch_add(
+            rayErrState->errCount.load(STD::memory_order_relaxed),
+            STD::memory_order_relaxed);
+        errState->error.fetch_or(error, STD::memory_order_release);
+    }
+    AddErrState(
+        errState, rayErrState->warning.load(STD::memory_order_relaxed),
+        rayErrState->warnCount.load(STD::memory_order_relaxed));
+}
+
+inline void CopyErrState(ErrState *dst, const ErrState *src)
+{
+    dst->error     = src->error.load(STD::memory_order_relaxed);
+    dst->warning   = src->warning.load(STD::memory_order_relaxed);
+    dst->errCount  = src->errCount.load(STD::memory_order_relaxed);
+    dst->warnCount = src->warnCount.load(STD::memory_order_relaxed);
+}
+
+/**
+ * Like MainFieldModes, but also stores the ray path in cray, using points (see
+ * GetRayCachePoints) while tracing. The ray is traced to the end even if the
+ * influence function terminates it, as this only depends on the receivers;
+ * but this run only reports the errors and warnings up to where MainFieldModes
+ * would have stopped. If tracing the rest of the ray fails, the ray is not
+ * stored, so it is traced again if the receivers change.
+ */
+template<typename CFG, bool O3D, bool R3D> inline void MainFieldModesRecord(
+    RayInitInfo &rinit, CachedRay<O3D, R3D> &cray, CachedRayPt<R3D> *points,
+    typename CFG::run::FieldT *uAllSources, bool privateField,
+    const bhcParams<O3D> &params, EigenInfo *eigen, const ArrInfo *arrinfo,
+    ErrState *errState, RayCounters *counters)
+{
+    real DistBegTop, DistEndTop, DistBegBot, DistEndBot;
+    SSPSegState iSeg;
+    VEC23<O3D> xs, gradc;
+    BdryState<O3D> bds;
+    BdryType Bdry;
+    Origin<O3D, R3D> org;
+
+    rayPt<R3D> point0, point1, point2;
+    point2.c = NAN; // Silence incorrect g++ warning about maybe uninitialized
+    point0.c = NAN;
+    InfluenceRayInfo<R3D> inflray;
+    // Errors and warnings from tracing the ray, as opposed to from the
+    // influence functions, and those up to where the influence stopped
+    ErrState rayErrState, inflErrState;
+    ResetErrState(&rayErrState);
+    int32_t numPoints = 0;
+    bool influence    = true;
+
+    bool traced = RayInit<CFG, O3D, R3D>(
+        rinit, xs, point0, gradc, DistBegTop, DistBegBot, org, iSeg, bds, Bdry,
+        params.Bdry, params.bdinfo, params.ssp, params.Pos, params.Angles,
+        params.freqinfo, params.Beam, params.sbp, true, &rayErrState);
+    cray.c0 = point0.c;
+    if(traced) {
+        Init_Influence<CFG, O3D, R3D>(
+            inflray, point0, rinit, gradc, params.Pos, org, params.ssp, iSeg,
+            params.Angles, params.freqinfo->freq0, params.Beam, errState);
+        inflray.privateField   = privateField;
+        inflray.mixedPrecision = GetInternal(params)->precision == Precision::Mixed;
+        ToCachedRayPt<R3D>(points[numPoints++], point0);
+
+        int32_t iSmallStepCtr = 0;
+        int32_t nSmall        = 0;
+        int32_t is            = 0;
+        int32_t Nsteps        = 0;
+        while(true) {
+            if(HasErrored(errState) || HasErrored(&rayErrState)) break;
+            bool twoSteps = RayUpdate<CFG, O3D, R3D>(
+                point0, point1, point2, DistEndTop, DistEndBot, iSmallStepCtr, org, iSeg,
+                bds, Bdry, params.bdinfo, params.refl, params.ssp, params.freqinfo,
+                params.Beam, xs, &rayErrState);
+            nSmall += iSmallStepCtr > 0 ? 1 : 0;
+            ToCachedRayPt<R3D>(points[numPoints++], point1);
+            if(influence) {
+                influence = Step_Influence<CFG, O3D, R3D>(
+                    point0, point1, inflray, is, uAllSources, params.Bdry, org,
+                    params.ssp, iSeg, params.Pos, params.Beam, eigen, arrinfo, errState);
+                if(!influence) CopyErrState(&inflErrState, &rayErrState);
+            }
+            ++is;
+            if(twoSteps) {
+                ToCachedRayPt<R3D>(points[numPoints++], point2);
+                if(influence) {
+                    influence = Step_Influence<CFG, O3D, R3D>(
+                        point1, point2, inflray, is, uAllSources, params.Bdry, org,
+                        params.ssp, iSeg, params.Pos, params.Beam, eigen, arrinfo,
+                        errState);
+                    if(!influence) CopyErrState(&inflErrState, &rayErrState);
+                }
+                point0 = point2;
+                ++is;
+            } else {
+                point0 = point1;
+            }
+            if(RayTerminate<O3D, R3D>(
+                   point0, Nsteps, is, xs, iSmallStepCtr, DistBegTop, DistBegBot,
+                   DistEndTop, DistEndBot, MaxN, org, params.bdinfo, params.Beam,
+                   &rayErrState))
+                break;
+        }
+        CountRay<R3D>(counters, is, nSmall, point0, inflray.numEvals, inflray.numHits);
+    }
+
+    AddErrState(errState, influence ? &rayErrState : &inflErrState);
+    cray.rinit     = rinit;
+    cray.org       = org;
+    cray.points    = nullptr;
+    cray.Nsteps    = numPoints;
+    cray.warning   = rayErrState.warning.load(STD::memory_order_relaxed);
+    cray.warnCount = rayErrState.warnCount.load(STD::memory_order_relaxed);
+    if(cray.warning & (1u << BHC_WARN_TOO_FEW_BEAMS)) {
+        cray.warning &= ~(1u << BHC_WARN_TOO_FEW_BEAMS);
+        --cray.warnCount;
+    }
+    if(HasErrored(&rayErrState)) return;
+    StoreCachedRay<O3D, R3D>(params, cray, points, numPoints);
+}
+
+/**
+ * Applies the influence functions to a ray stored by MainFieldModesRecord,
+ * with the current receivers. If the ray was not stored, it is traced.
+ */
+template<typename CFG, bool O3D, bool R3D> inline void MainFieldModesReplay(
+    RayInitInfo &rinit, const CachedRay<O3D, R3D> &cray,
+    typename CFG::run::FieldT *uAllSources, bool privateField,
+    const bhcParams<O3D> &params, EigenInfo *eigen, const ArrInfo *arrinfo,
+    ErrState *errState, RayCounters *counters)
+{
+    if(cray.points == nullptr) {
+        MainFieldModes<CFG, O3D, R3D>(
+            rinit, uAllSources, privateField,
+            GetInternal(params)->precision == Precision::Mixed, params.Bdry,
+            params.bdinfo, params.refl, params.ssp, params.Pos, params.Angles,
+            params.freqinfo, params.Beam, params.sbp, eigen, arrinfo, errState,
+            counters);
+        return;
+    }
+    rinit = cray.rinit;
+    AddErrState(errState, cray.warning, cray.warnCount);
+    CheckEnoughBeams<O3D>(
+        rinit, cray.c0, params.Pos, params.Angles, params.freqinfo, params.Beam,
+        errState);
+    if(cray.Nsteps == 0) return;
+
+    // LP: gradc and iSeg are only used by Cerveny beams.
+    VEC23<O3D> gradc(RL(0.0));
+    SSPSegState iSeg;
+    iSeg.x = iSeg.y = iSeg.z = iSeg.r = 0;
+    rayPt<R3D> point0, point1;
+    InfluenceRayInfo<R3D> inflray;
+    FromCachedRayPt<R3D>(point0, cray.points[0]);
+    Init_Influence<CFG, O3D, R3D>(
+        inflray, point0, rinit, gradc, params.Pos, cray.org, params.ssp, iSeg,
+        params.Angles, params.freqinfo->freq0, params.Beam, errState);
+    inflray.privateField   = privateField;
+    inflray.mixedPrecision = GetInternal(params)->precision == Precision::Mixed;
+
+    for(int32_t is = 0; is < cray.Nsteps - 1; ++is) {
+        if(HasErrored(errState)) break;
+        FromCachedRayPt<R3D>(point1, cray.points[is + 1]);
+        if(!Step_Influence<CFG, O3D, R3D>(
+               point0, point1, inflray, is, uAllSources, params.Bdry, cray.org,
+               params.ssp, iSeg, params.Pos, params.Beam, eigen, arrinfo, errState))
+            break;
+        point0 = point1;
+    }
+    // Not traced, so only the influence work is counted.
+    counters->influenceEvals += inflray.numEvals;
+    counters->receiverHits += inflray.numHits;
+}
+
+}} // namespace bhc::mode
@@ -20,6 +20,8 @@ this program. If not, see <https://www.gnu.org/licenses/>.
 #include "../trace.hpp"
 #include "../module/title.hpp"
 #include "../module/szrz.hpp"
+#include <future>
+#include <memory>
 
 namespace bhc { namespace mode {
 
@@ -34,10 +36,11 @@ namespace bhc { namespace mode {
  * atten: stabilizing attenuation (for wavenumber integration only)
  * PlotType: If "TL", writes only first and last Sx and Sy [LP: never set to
  * "TL" in BELLHOP]
+ * LP: Ext: File extension, ".shd" or ".tl" (see bhcInit::tlDB)
  */
 template<bool O3D> inline void WriteHeader(
     const bhcParams<O3D> &params, DirectOFile &SHDFile, float atten,
-    const std::string &PlotType)
+    const std::string &PlotType, const char *Ext = ".shd")
 {
     const Position *Pos      = params.Pos;
     const FreqInfo *freqinfo = params.freqinfo;
@@ -54,7 +57,7 @@ template<bool O3D> inline void WriteHeader(
     LRecl = bhc::max(LRecl, Pos->NRz * (int32_t)sizeof(Pos->Rz[0]));
     LRecl = bhc::max(LRecl, Pos->NRr * (int32_t)sizeof(cpxf));
 
-    std::string FileName = GetInternal(params)->FileRoot + ".shd";
+    std::string FileName = GetInternal(params)->FileRoot + Ext;
     SHDFile.open(FileName, LRecl);
     if(!SHDFile.good()) { EXTERR("Could not open SHDFile: %s", FileName.c_str()); }
     LRecl /= 4;
@@ -101,82 +104,175 @@ template<bool O3D> inline void WriteHeader(
 }
 
 /**
- * LP: Write TL results
+ * LP: Nominal sound speed and beam parameters of one source and frequency,
+ * which ScalePressure needs.
  */
-template<bool O3D, bool R3D> void PostProcessTL(
-    const bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs)
+struct TLScale {
+    real c, freq;
+    cpx epsilon1, epsilon2;
+};
+
+/**
+ * LP: Computes the TLScale of every source and frequency, indexed as
+ * ((isz * NSx + isx) * NSy + isy) * Nfreq + ifreq. ST is the SSP type, so this
+ * is only dispatched on once for all the sources.
+ */
+template<char ST, bool O3D, bool R3D> void GetTLScales(
+    const bhcParams<O3D> &params, std::vector<TLScale> &scales, ErrState *errState)
 {
-    ErrState errState;
-    ResetErrState(&errState);
-    for(int32_t isz = 0; isz < params.Pos->NSz; ++isz) {
-        for(int32_t isx = 0; isx < params.Pos->NSx; ++isx) {
-            for(int32_t isy = 0; isy < params.Pos->NSy; ++isy) {
+    const Position *Pos = params.Pos;
+    int32_t Nfreq       = params.freqinfo->Nfreq;
+    for(int32_t isz = 0; isz < Pos->NSz; ++isz) {
+        for(int32_t isx = 0; isx < Pos->NSx; ++isx) {
+            for(int32_t isy = 0; isy < Pos->NSy; ++isy) {
                 SSPSegState iSeg;
                 iSeg.r = iSeg.x = iSeg.y = iSeg.z = 0;
                 VEC23<O3D> xs, tinit;
-                SSPOutputs<O3D> o;
-                char st = params.ssp->Type;
-                if(st == 'N') {
-                    o = RayStartNominalSSP<CfgSel<'C', 'G', 'N'>, O3D>(
-                        isx, isy, isz, FL(0.0), iSeg, params.Pos, params.ssp, &errState,
-                        xs, tinit);
-                } else if(st == 'C') {
-                    o = RayStartNominalSSP<CfgSel<'C', 'G', 'C'>, O3D>(
-                        isx, isy, isz, FL(0.0), iSeg, params.Pos, params.ssp, &errState,
-                        xs, tinit);
-                } else if(st == 'S') {
-                    o = RayStartNominalSSP<CfgSel<'C', 'G', 'S'>, O3D>(
-                        isx, isy, isz, FL(0.0), iSeg, params.Pos, params.ssp, &errState,
-                        xs, tinit);
-                } else if(st == 'P') {
-                    o = RayStartNominalSSP<CfgSel<'C', 'G', 'P'>, O3D>(
-                        isx, isy, isz, FL(0.0), iSeg, params.Pos, params.ssp, &errState,
-                        xs, tinit);
-                } else if(st == 'Q') {
-                    o = RayStartNominalSSP<CfgSel<'C', 'G', 'Q'>, O3D>(
-                        isx, isy, isz, FL(0.0), iSeg, params.Pos, params.ssp, &errState,
-                        xs, tinit);
-                } else if(st == 'H') {
-                    o = RayStartNominalSSP<CfgSel<'C', 'G', 'H'>, O3D>(
-                        isx, isy, isz, FL(0.0), iSeg, params.Pos, params.ssp, &errState,
-                        xs, tinit);
-                } else if(st == 'A') {
-                    o = RayStartNominalSSP<CfgSel<'C', 'G', 'A'>, O3D>(
-                        isx, isy, isz, FL(0.0), iSeg, params.Pos, params.ssp, &errState,
-                        xs, tinit);
-                } else {
-                    EXTERR("Invalid ssp->Type %c!", st);
-                }
-                cpx epsilon1, epsilon2;
-                if constexpr(R3D) {
-                    // LP: In BELLHOP3D, this is run for both Nx2D and 3D, but the results
-                    // are only used in ScalePressure for 3D
-                    epsilon1 = PickEpsilon<O3D, R3D>(
-                        FL(2.0) * REAL_PI * params.freqinfo->freq0, o.ccpx.real(),
-                        o.gradc, FL(0.0), params.Angles->alpha.d, params.Beam, &errState);
-                    epsilon2 = PickEpsilon<O3D, R3D>(
-                        FL(2.0) * REAL_PI * params.freqinfo->freq0, o.ccpx.real(),
-                        o.gradc, FL(0.0), params.Angles->beta.d, params.Beam, &errState);
-                } else {
-                    epsilon1 = epsilon2 = RL(0.0);
-                }
-                if(HasErrored(&errState)) {
-                    // Exit loops
-                    isx = params.Pos->NSx;
-                    isz = params.Pos->NSz;
-                    break;
+                SSPOutputs<O3D> o = RayStartNominalSSP<CfgSel<'C', 'G', ST>, O3D>(
+                    isx, isy, isz, FL(0.0), iSeg, Pos, params.ssp, errState, xs, tinit);
+                // Broadband runs have one field per frequency
+                for(int32_t ifreq = 0; ifreq < Nfreq; ++ifreq) {
+                    TLScale &sc = scales
+                        [(((size_t)isz * Pos->NSx + isx) * Pos->NSy + isy) * Nfreq
+                         + ifreq];
+                    sc.c    = o.ccpx.real();
+                    sc.freq = Nfreq > 1 ? params.freqinfo->freqVec[ifreq]
+                                        : params.freqinfo->freq0;
+                    if constexpr(R3D) {
+                        // LP: In BELLHOP3D, this is run for both Nx2D and 3D, but the
+                        // results are only used in ScalePressure for 3D
+                        sc.epsilon1 = PickEpsilon<O3D, R3D>(
+                            FL(2.0) * REAL_PI * sc.freq, o.ccpx.real(), o.gradc, FL(0.0),
+                            params.Angles->alpha.d, params.Beam, errState);
+                        sc.epsilon2 = PickEpsilon<O3D, R3D>(
+                            FL(2.0) * REAL_PI * sc.freq, o.ccpx.real(), o.gradc, FL(0.0),
+                            params.Angles->beta.d, params.Beam, errState);
+                    } else {
+                        sc.epsilon1 = sc.epsilon2 = RL(0.0);
+                    }
+                    if(HasErrored(errState)) return;
                 }
-                ScalePressure<O3D, R3D>(
-                    params.Angles->alpha.d, params.Angles->beta.d, o.ccpx.real(),
-                    epsilon1, epsilon2, params.Pos->Rr,
-                    &outputs
-                         .uAllSources[GetFieldAddr(isx, isy, isz, 0, 0, 0, params.Pos)],
-                    params.Pos->Ntheta, params.Pos->NRz_per_range, params.Pos->NRr,
-                    params.freqinfo->freq0, params.Beam);
             }
         }
     }
-    CheckReportErrors(GetInternal(params), &errState);
+}
+
+/**
+ * LP: TL in dB of a pressure magnitude, clamped as in plotshd.m.
+ */
+inline float PressureToDB(float a)
+{
+    if(!STD::isfinite(a)) a = 1e-6f;
+    return -20.0f * STD::log10(bhc::max(a, 1e-37f));
+}
+
+/**
+ * LP: TL and phase of one element of the field, as written to the SHDFile
+ * (see WriteOutTL).
+ */
+inline void FieldToDB(const cpxf &u, float &tl, float &phase)
+{
+    tl    = PressureToDB(STD::abs(u));
+    phase = STD::arg(u);
+}
+inline void FieldToDB(float u, float &tl, float &phase)
+{
+    tl    = PressureToDB(STD::abs(u));
+    phase = STD::atan2(STD::copysign(0.0f, u), u);
+}
+
+/**
+ * LP: Scales rows [row0, row0 + nRows) of the field of one source and
+ * frequency, whose first element is at addr, and fills in the same elements
+ * of tlDB and tlPhase if they are used.
+ */
+template<bool O3D, bool R3D, typename FT> inline void PostProcessTLRows(
+    const bhcParams<O3D> &params, const TLScale &sc, FT *u, float *tlDB, float *tlPhase,
+    size_t addr, int32_t row0, int32_t nRows)
+{
+    int32_t Nr = params.Pos->NRr;
+    size_t a0  = addr + (size_t)row0 * Nr;
+    ScalePressure<O3D, R3D>(
+        params.Angles->alpha.d, params.Angles->beta.d, sc.c, sc.epsilon1, sc.epsilon2,
+        params.Pos->Rr, &u[a0], 1, nRows, Nr, sc.freq, params.Beam);
+    if(tlDB == nullptr) return;
+    size_t n = (size_t)nRows * Nr;
+    float phase;
+    for(size_t i = 0; i < n; ++i) {
+        FieldToDB(u[a0 + i], tlDB[a0 + i], tlPhase != nullptr ? tlPhase[a0 + i] : phase);
+    }
+}
+
+/**
+ * LP: Scales the field of every source and frequency (see ScalePressure), and
+ * computes TL in dB if enabled (see bhcInit::tlDB). The nominal SSP values are
+ * computed for all the sources first; then the rows of the field of all the
+ * sources and frequencies are divided into chunks, which are processed in
+ * parallel.
+ */
+template<bool O3D, bool R3D> void PostProcessTL(
+    const bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs)
+{
+    bhcInternal *internal = GetInternal(params);
+    const Position *Pos   = params.Pos;
+    int32_t Nfreq         = params.freqinfo->Nfreq;
+    size_t numSrcFreqs    = (size_t)Pos->NSx * Pos->NSy * Pos->NSz * Nfreq;
+    std::vector<TLScale> scales(numSrcFreqs);
+    ErrState errState;
+    ResetErrState(&errState);
+    char st = params.ssp->Type;
+    if(st == 'N') {
+        GetTLScales<'N', O3D, R3D>(params, scales, &errState);
+    } else if(st == 'C') {
+        GetTLScales<'C', O3D, R3D>(params, scales, &errState);
+    } else if(st == 'S') {
+        GetTLScales<'S', O3D, R3D>(params, scales, &errState);
+    } else if(st == 'P') {
+        GetTLScales<'P', O3D, R3D>(params, scales, &errState);
+    } else if(st == 'Q') {
+        GetTLScales<'Q', O3D, R3D>(params, scales, &errState);
+    } else if(st == 'H') {
+        GetTLScales<'H', O3D, R3D>(params, scales, &errState);
+    } else if(st == 'A') {
+        GetTLScales<'A', O3D, R3D>(params, scales, &errState);
+    } else {
+        EXTERR("Invalid ssp->Type %c!", st);
+    }
+    CheckReportErrors(internal, &errState);
+
+    // Chunks of whole rows (receiver ranges) of about ChunkElems elements.
+    constexpr int32_t ChunkElems = 16384;
+    int32_t rows         = Pos->Ntheta * Pos->NRz_per_range;
+    int32_t chunkRows    = bhc::max(ChunkElems / Pos->NRr, 1);
+    int32_t chunksPerSrc = (rows + chunkRows - 1) / chunkRows;
+    size_t numChunks     = numSrcFreqs * chunksPerSrc;
+    size_t fieldSize     = GetFieldSize(Pos);
+    int32_t numThreads   = (int32_t)bhc::min((size_t)internal->numThreads, numChunks);
+    std::atomic<size_t> nextChunk(0);
+    internal->threadPool->Run(numThreads, [&](int32_t) {
+        size_t i;
+        while((i = nextChunk++) < numChunks) {
+            size_t isf     = i / chunksPerSrc;
+            int32_t row0   = (int32_t)(i % chunksPerSrc) * chunkRows;
+            int32_t ifreq  = (int32_t)(isf % Nfreq);
+            size_t isrc    = isf / Nfreq;
+            int32_t isy    = (int32_t)(isrc % Pos->NSy);
+            int32_t isx    = (int32_t)(isrc / Pos->NSy % Pos->NSx);
+            int32_t isz    = (int32_t)(isrc / Pos->NSy / Pos->NSx);
+            int32_t nRows  = bhc::min(chunkRows, rows - row0);
+            size_t addr    = (size_t)ifreq * fieldSize
+                + GetFieldAddr(isx, isy, isz, 0, 0, 0, Pos);
+            if(UsesRealField(params)) {
+                PostProcessTLRows<O3D, R3D>(
+                    params, scales[isf], outputs.uAllSourcesReal, outputs.tlDB,
+                    outputs.tlPhase, addr, row0, nRows);
+            } else {
+                PostProcessTLRows<O3D, R3D>(
+                    params, scales[isf], outputs.uAllSources, outputs.tlDB,
+                    outputs.tlPhase, addr, row0, nRows);
+            }
+        }
+    });
 }
 
 #if BHC_ENABLE_2D
@@ -192,61 +288,248 @@ template void PostProcessTL<true, true>(
     const bhcParams<true> &params, bhcOutputs<true, true> &outputs);
 #endif
 
-template<bool O3D> inline size_t GetRecNum(
-    const bhcParams<O3D> &params, int32_t isx, int32_t isy, int32_t itheta, int32_t isz,
-    int32_t Irz1)
+/**
+ * Sums the thread-private field tiles (if any) into uAllSources, always in
+ * tile order so the result does not depend on the number of threads. Each
+ * thread reduces a contiguous slice of the field, in blocks small enough that
+ * the destination stays in cache while all the tiles are added to it.
+ */
+inline void ReduceFieldTilesWorker(
+    float *dst, const float *tiles, int32_t numOther, size_t tileFloats, size_t begin,
+    size_t end)
+{
+    constexpr size_t BlockFloats = 4096;
+    for(size_t b = begin; b < end; b += BlockFloats) {
+        size_t e = bhc::min(b + BlockFloats, end);
+        for(int32_t t = 0; t < numOther; ++t) {
+            const float *src = &tiles[(size_t)t * tileFloats];
+            for(size_t i = b; i < e; ++i) dst[i] += src[i];
+        }
+    }
+}
+
+template<bool O3D, bool R3D> void ReduceFieldTiles(
+    const bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs)
+{
+    bhcInternal *internal = GetInternal(params);
+    if(internal->numFieldTiles > 1) {
+        bool realField     = UsesRealField(params);
+        size_t tileFloats  = GetFieldSize(params.Pos) * params.freqinfo->Nfreq
+            * (realField ? 1 : 2);
+        float *dst         = realField ? outputs.uAllSourcesReal
+                                       : (float *)outputs.uAllSources;
+        int32_t numThreads = internal->numThreads;
+        internal->threadPool->Run(numThreads, [&](int32_t i) {
+            ReduceFieldTilesWorker(
+                dst, internal->fieldTiles, internal->numFieldTiles - 1, tileFloats,
+                tileFloats * i / numThreads, tileFloats * (i + 1) / numThreads);
+        });
+    }
+}
+
+#if BHC_ENABLE_2D
+template void ReduceFieldTiles<false, false>(
+    const bhcParams<false> &params, bhcOutputs<false, false> &outputs);
+#endif
+#if BHC_ENABLE_NX2D
+template void ReduceFieldTiles<true, false>(
+    const bhcParams<true> &params, bhcOutputs<true, false> &outputs);
+#endif
+#if BHC_ENABLE_3D
+template void ReduceFieldTiles<true, true>(
+    const bhcParams<true> &params, bhcOutputs<true, true> &outputs);
+#endif
+
+inline size_t GetRecNum(
+    const Position *Pos, int32_t Nfreq, int32_t isx, int32_t isy, int32_t ifreq,
+    int32_t itheta, int32_t isz, int32_t Irz1)
 {
     // clang-format off
-    return        10                     + ((((size_t)isx
-        * (size_t)params.Pos->NSy           + (size_t)isy)
-        * (size_t)params.Pos->Ntheta        + (size_t)itheta)
-        * (size_t)params.Pos->NSz           + (size_t)isz)
-        * (size_t)params.Pos->NRz_per_range + (size_t)Irz1;
+    return        10              + (((((size_t)isx
+        * (size_t)Pos->NSy           + (size_t)isy)
+        * (size_t)Nfreq              + (size_t)ifreq)
+        * (size_t)Pos->Ntheta        + (size_t)itheta)
+        * (size_t)Pos->NSz           + (size_t)isz)
+        * (size_t)Pos->NRz_per_range + (size_t)Irz1;
     // clang-format on
 }
 
+template<bool O3D> inline size_t GetRecNum(
+    const bhcParams<O3D> &params, int32_t isx, int32_t isy, int32_t ifreq, int32_t itheta,
+    int32_t isz, int32_t Irz1)
+{
+    return GetRecNum(
+        params.Pos, params.freqinfo->Nfreq, isx, isy, ifreq, itheta, isz, Irz1);
+}
+
 /**
- * LP: Write TL results
+ * LP: For each source and frequency, the SHDFile records of all the receiver
+ * bearings, source depths, and receiver depths are consecutive, and each
+ * record is a row of receiver ranges which is also contiguous in the field.
+ * So the field is moved to / from the file in large blocks of records, by
+ * several threads at once, each with its own file handle.
  */
-template<bool O3D, bool R3D> void WriteOutTL(
-    const bhcParams<O3D> &params, const bhcOutputs<O3D, R3D> &outputs)
+struct SHDBlock {
+    int32_t isx, isy, ifreq, itheta;
+    int32_t k0, n; // records [k0, k0 + n) of this isx, isy, ifreq, itheta
+};
+
+template<bool O3D> inline std::vector<SHDBlock> GetSHDBlocks(
+    const bhcParams<O3D> &params, size_t recl, int32_t &blockRecs)
+{
+    // Large enough that the per-write overhead is negligible, small enough
+    // that the per-thread buffers are not a significant amount of memory.
+    constexpr size_t BlockBytes = 4ull * 1024ull * 1024ull;
+    const Position *Pos         = params.Pos;
+    int32_t perPlane            = Pos->NSz * Pos->NRz_per_range;
+    blockRecs                   = (int32_t)bhc::max(
+        bhc::min((size_t)perPlane, BlockBytes / recl), (size_t)1);
+    std::vector<SHDBlock> blocks;
+    for(int32_t isx = 0; isx < Pos->NSx; ++isx) {
+        for(int32_t isy = 0; isy < Pos->NSy; ++isy) {
+            for(int32_t ifreq = 0; ifreq < params.freqinfo->Nfreq; ++ifreq) {
+                for(int32_t itheta = 0; itheta < Pos->Ntheta; ++itheta) {
+                    for(int32_t k0 = 0; k0 < perPlane; k0 += blockRecs) {
+                        blocks.push_back(
+                            {isx, isy, ifreq, itheta, k0,
+                             bhc::min(blockRecs, perPlane - k0)});
+                    }
+                }
+            }
+        }
+    }
+    return blocks;
+}
+
+/**
+ * Record number in the SHDFile of record k of block b.
+ */
+template<bool O3D> inline size_t GetSHDBlockRecNum(
+    const bhcParams<O3D> &params, const SHDBlock &b, int32_t k)
+{
+    return GetRecNum(params, b.isx, b.isy, b.ifreq, b.itheta, 0, 0) + (size_t)k;
+}
+
+/**
+ * Address in uAllSources of the first receiver range of record k of block b.
+ */
+template<bool O3D> inline size_t GetSHDBlockFieldAddr(
+    const bhcParams<O3D> &params, const SHDBlock &b, int32_t k)
+{
+    int32_t isz  = k / params.Pos->NRz_per_range;
+    int32_t Irz1 = k % params.Pos->NRz_per_range;
+    return (size_t)b.ifreq * GetFieldSize(params.Pos)
+        + GetFieldAddr(b.isx, b.isy, isz, b.itheta, Irz1, 0, params.Pos);
+}
+
+/**
+ * Calls f(worker, block) for every block, on numThreads threads of the pool.
+ */
+template<typename F> inline void ForEachSHDBlock(
+    bhcThreadPool *pool, const std::vector<SHDBlock> &blocks, int32_t numThreads,
+    const F &f)
+{
+    std::atomic<size_t> nextBlock(0);
+    auto worker = [&](int32_t w) {
+        size_t i;
+        while((i = nextBlock++) < blocks.size()) f(w, blocks[i]);
+    };
+    pool->Run(numThreads, worker);
+}
+
+/**
+ * LP: Writes a file with the header and records of the SHDFile, with extension
+ * Ext. fillRow(rec, addr) fills in record rec from the element addr of the
+ * field.
+ */
+template<bool O3D, typename F> inline void WriteTLFile(
+    const bhcParams<O3D> &params, const char *Ext, const F &fillRow)
 {
     real atten = FL(0.0);
     std::string PlotType;
-    DirectOFile SHDFile(GetInternal(params));
+    size_t recl;
+    {
+        DirectOFile SHDFile(GetInternal(params));
 
-    // following to set PlotType has already been done in READIN if that was used for
-    // input (LP: not anymore)
-    PlotType = IsIrregularGrid(params.Beam) ? "irregular " : "rectilin  ";
-    WriteHeader(params, SHDFile, atten, PlotType);
+        // following to set PlotType has already been done in READIN if that was used
+        // for input (LP: not anymore)
+        PlotType = IsIrregularGrid(params.Beam) ? "irregular " : "rectilin  ";
+        WriteHeader(params, SHDFile, atten, PlotType, Ext);
+        recl = SHDFile.reclen();
+    }
 
     // clang-format off
     // LP: There are three different orders of the data used here.
-    // Field: (largest) Z, X, Y, theta, depth, radius (smallest)
-    // File:  (largest) X, Y, theta, Z, depth, radius (smallest)
+    // Field: (largest) freq, Z, X, Y, theta, depth, radius (smallest)
+    // File:  (largest) X, Y, freq, theta, Z, depth, radius (smallest)
     // Write: (largest) Z, X, Y, depth, theta, radius (smallest)
-    // (XYZ are source; theta depth radius are receiver)
+    // (XYZ are source; theta depth radius are receiver; freq only for broadband)
     // clang-format on
     // Since the write order doesn't change the file contents, the write order
     // has been changed to match the file order, to hopefully speed up I/O.
-    for(int32_t isx = 0; isx < params.Pos->NSx; ++isx) {
-        for(int32_t isy = 0; isy < params.Pos->NSy; ++isy) {
-            for(int32_t itheta = 0; itheta < params.Pos->Ntheta; ++itheta) {
-                for(int32_t isz = 0; isz < params.Pos->NSz; ++isz) {
-                    for(int32_t Irz1 = 0; Irz1 < params.Pos->NRz_per_range; ++Irz1) {
-                        SHDFile.rec(GetRecNum(params, isx, isy, itheta, isz, Irz1));
-                        for(int32_t r = 0; r < params.Pos->NRr; ++r) {
-                            cpxf v = outputs.uAllSources[GetFieldAddr(
-                                isx, isy, isz, itheta, Irz1, r, params.Pos)];
-                            DOFWRITEV(SHDFile, v);
-                        }
-                    }
-                }
-            }
+    // Each record is written from a row of the field, see SHDBlock.
+    std::string FileName = GetInternal(params)->FileRoot + Ext;
+    int32_t blockRecs;
+    std::vector<SHDBlock> blocks = GetSHDBlocks(params, recl, blockRecs);
+    int32_t numThreads
+        = (int32_t)bhc::min((size_t)GetInternal(params)->numThreads, blocks.size());
+    std::vector<std::unique_ptr<DirectOFile>> files;
+    bhcThreadPool *pool = GetInternal(params)->threadPool;
+    std::vector<std::vector<char>> buffers(numThreads);
+    for(int32_t w = 0; w < numThreads; ++w) {
+        files.emplace_back(new DirectOFile(GetInternal(params)));
+        files[w]->openexisting(FileName, recl);
+        if(!files[w]->good()) { EXTERR("Could not open SHDFile: %s", FileName.c_str()); }
+    }
+    ForEachSHDBlock(pool, blocks, numThreads, [&](int32_t w, const SHDBlock &b) {
+        std::vector<char> &buf = buffers[w];
+        // LP: Zero once, the padding at the end of each record is never written.
+        if(buf.empty()) buf.resize((size_t)blockRecs * recl, 0);
+        for(int32_t k = 0; k < b.n; ++k) {
+            fillRow(&buf[(size_t)k * recl], GetSHDBlockFieldAddr(params, b, b.k0 + k));
         }
+        files[w]->writerecords(GetSHDBlockRecNum(params, b, b.k0), buf.data(), b.n);
+    });
+    for(int32_t w = 0; w < numThreads; ++w) {
+        if(!files[w]->good()) { EXTERR("Error writing SHDFile: %s", FileName.c_str()); }
     }
 }
 
+/**
+ * LP: Write TL results
+ */
+template<bool O3D, bool R3D> void WriteOutTL(
+    const bhcParams<O3D> &params, const bhcOutputs<O3D, R3D> &outputs)
+{
+    int32_t NRr    = params.Pos->NRr;
+    bool realField = UsesRealField(params);
+    WriteTLFile(params, ".shd", [&](char *rec, size_t addr) {
+        if(realField) {
+            // LP: The imaginary part has the same sign as the real part,
+            // like the 0 * factor of the complex version of ScalePressure,
+            // so the file is bit-identical.
+            cpxf *row = reinterpret_cast<cpxf *>(rec);
+            for(int32_t ir = 0; ir < NRr; ++ir) {
+                float p = outputs.uAllSourcesReal[addr + ir];
+                row[ir] = cpxf(p, STD::copysign(0.0f, p));
+            }
+        } else {
+            memcpy(rec, &outputs.uAllSources[addr], (size_t)NRr * sizeof(cpxf));
+        }
+    });
+    if(outputs.tlDB == nullptr) return;
+    // LP: The TL of the NRr receivers and then their phase take the space of
+    // the NRr complex pressures of the SHDFile record.
+    WriteTLFile(params, ".tl", [&](char *rec, size_t addr) {
+        memcpy(rec, &outputs.tlDB[addr], (size_t)NRr * sizeof(float));
+        if(outputs.tlPhase != nullptr) {
+            memcpy(
+                rec + (size_t)NRr * sizeof(float), &outputs.tlPhase[addr],
+                (size_t)NRr * sizeof(float));
+        }
+    });
+}
+
 #if BHC_ENABLE_2D
 template void WriteOutTL<false, false>(
     const bhcParams<false> &params, const bhcOutputs<false, false> &outputs);
@@ -260,6 +543,195 @@ template void WriteOutTL<true, true>(
     const bhcParams<true> &params, const bhcOutputs<true, true> &outputs);
 #endif
 
+/**
+ * LP: Writes the field of one source tile of a streamed TL run to its records
+ * in the SHDFile, from a separate thread while the next tile is traced (see
+ * RunStreamedTL). tile is the Position of the tile, whose sources start at
+ * isx0, isy0, isz0 of the sources of Pos. For each source x and y, frequency,
+ * and receiver bearing, the records of all the source and receiver depths of
+ * the tile are consecutive in the file, and are written in blocks as in
+ * WriteOutTL.
+ */
+inline void WriteSHDSourceTile(
+    DirectOFile &SHDFile, std::vector<char> &buf, const Position *Pos,
+    const Position *tile, int32_t Nfreq, int32_t isx0, int32_t isy0, int32_t isz0,
+    const float *field, bool realField)
+{
+    constexpr size_t BlockBytes = 4ull * 1024ull * 1024ull;
+    size_t recl                 = SHDFile.reclen();
+    int32_t perPlane            = tile->NSz * tile->NRz_per_range;
+    int32_t blockRecs           = (int32_t)bhc::max(
+        bhc::min((size_t)perPlane, BlockBytes / recl), (size_t)1);
+    // LP: Zero once, the padding at the end of each record is never written.
+    if(buf.empty()) buf.resize((size_t)blockRecs * recl, 0);
+    size_t fieldSize = GetFieldSize(tile);
+    size_t rowBytes  = (size_t)tile->NRr * sizeof(cpxf);
+    for(int32_t isx = 0; isx < tile->NSx; ++isx) {
+        for(int32_t isy = 0; isy < tile->NSy; ++isy) {
+            for(int32_t ifreq = 0; ifreq < Nfreq; ++ifreq) {
+                for(int32_t itheta = 0; itheta < tile->Ntheta; ++itheta) {
+                    for(int32_t k0 = 0; k0 < perPlane; k0 += blockRecs) {
+                        int32_t n = bhc::min(blockRecs, perPlane - k0);
+                        for(int32_t k = 0; k < n; ++k) {
+                            int32_t isz  = (k0 + k) / tile->NRz_per_range;
+                            int32_t Irz1 = (k0 + k) % tile->NRz_per_range;
+                            size_t addr  = (size_t)ifreq * fieldSize
+                                + GetFieldAddr(isx, isy, isz, itheta, Irz1, 0, tile);
+                            cpxf *row = reinterpret_cast<cpxf *>(&buf[(size_t)k * recl]);
+                            if(realField) {
+                                // LP: See WriteOutTL.
+                                for(int32_t ir = 0; ir < tile->NRr; ++ir) {
+                                    float p = field[addr + ir];
+                                    row[ir] = cpxf(p, STD::copysign(0.0f, p));
+                                }
+                            } else {
+                                memcpy(row, &field[2 * addr], rowBytes);
+                            }
+                        }
+                        SHDFile.writerecords(
+                            GetRecNum(
+                                Pos, Nfreq, isx0 + isx, isy0 + isy, ifreq, itheta, isz0,
+                                0)
+                                + (size_t)k0,
+                            buf.data(), n);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * LP: Streamed TL run (see bhcInit::streamTL). The sources are processed in
+ * tiles chosen by TL::SetSourceTileDims. Each tile is a Position whose source
+ * arrays point into those of the full Position, so the tracing and
+ * postprocessing code runs on it unchanged. The field holds two tiles: while
+ * one is being written to the shade file by a separate thread, the next one
+ * is traced into the other.
+ */
+template<bool O3D, bool R3D> void RunStreamedTL(
+    bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs)
+{
+    bhcInternal *internal = GetInternal(params);
+    Position *Pos         = params.Pos;
+    int32_t Nfreq         = params.freqinfo->Nfreq;
+    bool realField        = UsesRealField(params);
+    const int32_t *ns     = internal->streamTileNS;
+    size_t recl;
+    {
+        DirectOFile SHDFile(internal);
+        WriteHeader(
+            params, SHDFile, 0.0f,
+            IsIrregularGrid(params.Beam) ? "irregular " : "rectilin  ");
+        recl = SHDFile.reclen();
+    }
+    std::string FileName = internal->FileRoot + ".shd";
+    DirectOFile SHDFile(internal);
+    SHDFile.openexisting(FileName, recl);
+    if(!SHDFile.good()) { EXTERR("Could not open SHDFile: %s", FileName.c_str()); }
+
+    float *fieldBase  = realField ? outputs.uAllSourcesReal
+                                  : reinterpret_cast<float *>(outputs.uAllSources);
+    size_t tileFloats = GetFieldSize(Pos) / (size_t)(Pos->NSx * Pos->NSy * Pos->NSz)
+        * (size_t)(ns[0] * ns[1] * ns[2]) * Nfreq * (realField ? 1 : 2);
+    Position *tiles   = nullptr;
+    // LP: Restores params and outputs and frees the tiles also if there is an
+    // error. It is declared before the future of the pending write, which is
+    // therefore destroyed first and waits for the write to finish, so no tile
+    // is freed while it is being written.
+    struct Restore {
+        bhcParams<O3D> &params;
+        bhcOutputs<O3D, R3D> &outputs;
+        Position *Pos;
+        float *fieldBase;
+        bool realField;
+        Position *&tiles;
+        ~Restore()
+        {
+            Apply();
+            trackdeallocate(params, tiles);
+        }
+        void Apply()
+        {
+            params.Pos                     = Pos;
+            GetInternal(params)->streamPos = nullptr;
+            if(realField) {
+                outputs.uAllSourcesReal = fieldBase;
+            } else {
+                outputs.uAllSources = reinterpret_cast<cpxf *>(fieldBase);
+            }
+        }
+    } restore{params, outputs, Pos, fieldBase, realField, tiles};
+    // LP: Allocated like the other params structs, so they are also
+    // accessible from the GPU.
+    trackallocate(params, "source tiles", tiles, 2);
+    std::vector<char> buf;
+    std::future<void> pending;
+
+    int32_t itile = 0;
+    for(int32_t isx0 = 0; isx0 < Pos->NSx; isx0 += ns[0]) {
+        for(int32_t isy0 = 0; isy0 < Pos->NSy; isy0 += ns[1]) {
+            for(int32_t isz0 = 0; isz0 < Pos->NSz; isz0 += ns[2]) {
+                // LP: The write of the tile before last, which used this half
+                // of the field, was finished before the last one was started.
+                int32_t b      = (itile++) & 1;
+                Position *tile = &tiles[b];
+                *tile          = *Pos;
+                tile->NSx      = bhc::min(ns[0], Pos->NSx - isx0);
+                tile->NSy      = bhc::min(ns[1], Pos->NSy - isy0);
+                tile->NSz      = bhc::min(ns[2], Pos->NSz - isz0);
+                tile->Sx       = &Pos->Sx[isx0];
+                tile->Sy       = &Pos->Sy[isy0];
+                tile->Sz       = &Pos->Sz[isz0];
+                float *field   = &fieldBase[(size_t)b * tileFloats];
+                memset(field, 0, tileFloats * sizeof(float));
+                params.Pos                = tile;
+                internal->streamPos       = Pos;
+                internal->streamTileS0[0] = isx0;
+                internal->streamTileS0[1] = isy0;
+                internal->streamTileS0[2] = isz0;
+                if(realField) {
+                    outputs.uAllSourcesReal = field;
+                } else {
+                    outputs.uAllSources = reinterpret_cast<cpxf *>(field);
+                }
+                RunFieldModesSelInfl<O3D, R3D>(params, outputs);
+                ReduceFieldTiles<O3D, R3D>(params, outputs);
+                PostProcessTL<O3D, R3D>(params, outputs);
+                params.Pos          = Pos;
+                internal->streamPos = nullptr;
+                if(pending.valid()) pending.get();
+                pending = std::async(std::launch::async, [&, tile, field, isx0, isy0,
+                                                          isz0]() {
+                    WriteSHDSourceTile(
+                        SHDFile, buf, Pos, tile, Nfreq, isx0, isy0, isz0, field,
+                        realField);
+                });
+            }
+        }
+    }
+    if(pending.valid()) pending.get();
+    if(!SHDFile.good()) { EXTERR("Error writing SHDFile: %s", FileName.c_str()); }
+    restore.Apply();
+    // LP: The TL results are only in the file.
+    trackdeallocate(params, outputs.uAllSources);
+    trackdeallocate(params, outputs.uAllSourcesReal);
+    restore.fieldBase = nullptr;
+}
+
+#if BHC_ENABLE_2D
+template void RunStreamedTL<false, false>(
+    bhcParams<false> &params, bhcOutputs<false, false> &outputs);
+#endif
+#if BHC_ENABLE_NX2D
+template void RunStreamedTL<true, false>(
+    bhcParams<true> &params, bhcOutputs<true, false> &outputs);
+#endif
+#if BHC_ENABLE_3D
+template void RunStreamedTL<true, true>(
+    bhcParams<true> &params, bhcOutputs<true, true> &outputs);
+#endif
+
 template<bool O3D, bool R3D> void ReadOutTL(
     bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs, const char *FileRoot)
 {
@@ -296,7 +768,7 @@ template<bool O3D, bool R3D> void ReadOutTL(
     float atten;
     DIFREADV(SHDFile, atten);
 
-    if(freqinfo->Nfreq != 1) { EXTERR("Nfreq in SHDFile being loaded is not 1"); }
+    if(freqinfo->Nfreq < 1) { EXTERR("Nfreq in SHDFile being loaded is invalid"); }
     if constexpr(!O3D) {
         if(Pos->Ntheta != 1 || Pos->NSx != 1 || Pos->NSy != 1) {
             EXTERR(
@@ -340,26 +812,49 @@ template<bool O3D, bool R3D> void ReadOutTL(
     module::SzRz<O3D> szrz;
     szrz.Preprocess(params); // sets NRz_per_range
     TL<O3D, R3D> tl;
-    tl.Preprocess(params, outputs);
+    tl.AllocateField(params, outputs, false);
 
-    for(int32_t isx = 0; isx < Pos->NSx; ++isx) {
-        for(int32_t isy = 0; isy < Pos->NSy; ++isy) {
-            for(int32_t itheta = 0; itheta < Pos->Ntheta; ++itheta) {
-                for(int32_t isz = 0; isz < Pos->NSz; ++isz) {
-                    for(int32_t Irz1 = 0; Irz1 < Pos->NRz_per_range; ++Irz1) {
-                        DIFREC(SHDFile, GetRecNum(params, isx, isy, itheta, isz, Irz1));
-                        for(int32_t r = 0; r < Pos->NRr; ++r) {
-                            cpxf v;
-                            DIFREADV(SHDFile, v);
-                            outputs.uAllSources
-                                [GetFieldAddr(isx, isy, isz, itheta, Irz1, r, params.Pos)]
-                                = v;
-                        }
-                    }
+    // Each record is read into a row of the field, see SHDBlock.
+    size_t recl = SHDFile.reclen();
+    if((size_t)Pos->NRr * sizeof(cpxf) > recl
+       || SHDFile.numrecords()
+           < GetRecNum(params, Pos->NSx - 1, Pos->NSy - 1, freqinfo->Nfreq - 1,
+                       Pos->Ntheta - 1, Pos->NSz - 1, Pos->NRz_per_range - 1)
+               + 1) {
+        EXTERR("SHDFile being loaded is too short for its dimensions");
+    }
+    std::string FileName = std::string(FileRoot) + ".shd";
+    int32_t blockRecs;
+    std::vector<SHDBlock> blocks = GetSHDBlocks(params, recl, blockRecs);
+    int32_t numThreads
+        = (int32_t)bhc::min((size_t)GetInternal(params)->numThreads, blocks.size());
+    std::vector<std::unique_ptr<DirectIFile>> files;
+    bhcThreadPool *pool = GetInternal(params)->threadPool;
+    std::vector<std::vector<char>> buffers(numThreads);
+    for(int32_t w = 0; w < numThreads; ++w) {
+        files.emplace_back(new DirectIFile(GetInternal(params)));
+        files[w]->open(FileName);
+    }
+    size_t rowBytes = (size_t)Pos->NRr * sizeof(cpxf);
+    bool realField  = UsesRealField(params);
+    ForEachSHDBlock(pool, blocks, numThreads, [&](int32_t w, const SHDBlock &b) {
+        std::vector<char> &buf = buffers[w];
+        DirectIFile &file      = *files[w];
+        if(buf.empty()) buf.resize((size_t)blockRecs * recl);
+        DIFREADRECS(file, GetSHDBlockRecNum(params, b, b.k0), buf.data(), b.n);
+        for(int32_t k = 0; k < b.n; ++k) {
+            size_t addr = GetSHDBlockFieldAddr(params, b, b.k0 + k);
+            if(realField) {
+                const cpxf *row
+                    = reinterpret_cast<const cpxf *>(&buf[(size_t)k * recl]);
+                for(int32_t ir = 0; ir < Pos->NRr; ++ir) {
+                    outputs.uAllSourcesReal[addr + ir] = row[ir].real();
                 }
+            } else {
+                memcpy(&outputs.uAllSources[addr], &buf[(size_t)k * recl], rowBytes);
             }
         }
-    }
+    });
 }
 
 #if BHC_ENABLE_2D
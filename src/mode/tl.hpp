@@ -31,6 +31,24 @@ extern template void PostProcessTL<true, false>(
 extern template void PostProcessTL<true, true>(
     const bhcParams<true> &params, bhcOutputs<true, true> &outputs);
 
+template<bool O3D, bool R3D> void ReduceFieldTiles(
+    const bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs);
+extern template void ReduceFieldTiles<false, false>(
+    const bhcParams<false> &params, bhcOutputs<false, false> &outputs);
+extern template void ReduceFieldTiles<true, false>(
+    const bhcParams<true> &params, bhcOutputs<true, false> &outputs);
+extern template void ReduceFieldTiles<true, true>(
+    const bhcParams<true> &params, bhcOutputs<true, true> &outputs);
+
+template<bool O3D, bool R3D> void RunStreamedTL(
+    bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs);
+extern template void RunStreamedTL<false, false>(
+    bhcParams<false> &params, bhcOutputs<false, false> &outputs);
+extern template void RunStreamedTL<true, false>(
+    bhcParams<true> &params, bhcOutputs<true, false> &outputs);
+extern template void RunStreamedTL<true, true>(
+    bhcParams<true> &params, bhcOutputs<true, true> &outputs);
+
 template<bool O3D, bool R3D> void WriteOutTL(
     const bhcParams<O3D> &params, const bhcOutputs<O3D, R3D> &outputs);
 extern template void WriteOutTL<false, false>(
@@ -56,32 +74,158 @@ public:
 
     virtual void Init(bhcOutputs<O3D, R3D> &outputs) const override
     {
-        outputs.uAllSources = nullptr;
+        outputs.uAllSources     = nullptr;
+        outputs.uAllSourcesReal = nullptr;
+        outputs.tlDB            = nullptr;
+        outputs.tlPhase         = nullptr;
     }
 
     virtual void Preprocess(
         bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs) const override
     {
         Field<O3D, R3D>::Preprocess(params, outputs);
+        if(IsStreamed(params)) {
+            if(GetInternal(params)->noEnvFil) {
+                EXTERR("Cannot stream TL to a file without a FileRoot");
+            }
+            FreeRayCache<O3D>(params);
+        }
+        AllocateDB(params, outputs);
+        AllocateField(params, outputs, IsStreamed(params));
+    }
 
+    /**
+     * Allocates the field and the thread-private field tiles. When streamed
+     * (see bhcInit::streamTL), the field holds two tiles of sources instead of
+     * all of them; see RunStreamedTL.
+     */
+    void AllocateField(
+        bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs, bool streamed) const
+    {
+        bhcInternal *internal = GetInternal(params);
         trackdeallocate(params, outputs.uAllSources); // Free if previously run
+        trackdeallocate(params, outputs.uAllSourcesReal);
+        trackdeallocate(params, internal->fieldTiles);
+        internal->numFieldTiles = 0;
         // for a TL calculation, allocate space for the pressure matrix
-        const Position *Pos = params.Pos;
-        size_t n            = (size_t)Pos->NSz * (size_t)Pos->NSx * (size_t)Pos->NSy
-            * (size_t)Pos->Ntheta * (size_t)Pos->NRz_per_range * (size_t)Pos->NRr;
-        trackallocate(params, "sound field / transmission loss", outputs.uAllSources, n);
-        memset(outputs.uAllSources, 0, n * sizeof(cpxf));
+        // (one per frequency for broadband runs)
+        const FreqInfo *freqinfo = params.freqinfo;
+        for(int32_t f = 0; f < freqinfo->Nfreq && freqinfo->Nfreq > 1; ++f) {
+            if(!(freqinfo->freqVec[f] > RL(0.0))) {
+                EXTERR("Frequencies must be positive for a broadband TL run");
+            }
+        }
+        // Incoherent and semi-coherent runs only sum real intensities.
+        size_t n         = GetFieldSize(params.Pos) * freqinfo->Nfreq;
+        size_t elemBytes = UsesRealField(params) ? sizeof(float) : sizeof(cpxf);
+        size_t nAlloc    = n;
+        if(streamed) {
+            n      = SetSourceTileDims(params, n, elemBytes);
+            nAlloc = 2 * n;
+        }
+        MakeRoomInRayCache<O3D>(params, nAlloc * elemBytes);
+        if(UsesRealField(params)) {
+            trackallocate(
+                params, "sound field / transmission loss", outputs.uAllSourcesReal,
+                nAlloc);
+            memset(outputs.uAllSourcesReal, 0, nAlloc * sizeof(float));
+        } else {
+            trackallocate(
+                params, "sound field / transmission loss", outputs.uAllSources, nAlloc);
+            memset(outputs.uAllSources, 0, nAlloc * sizeof(cpxf));
+        }
+
+#ifndef BHC_BUILD_CUDA
+        // If there is room, give the CPU workers private copies of the field
+        // (tiles) to accumulate into, instead of atomically adding into one
+        // shared field. The tiles are summed in order after the run.
+        // In Auto and Deterministic mode, each tile gets every numFieldTiles'th
+        // ray, traced in order. The number of tiles is set by the user
+        // (bhcInit::deterministicTiles), not by the number of threads, so the
+        // results are the same for any number of threads. Auto uses fewer
+        // tiles if they do not fit in half of the free memory.
+        // In PerThread mode, each thread holds one tile for the whole run while
+        // the rays are scheduled as usual, if there is room for one per thread;
+        // otherwise, fall back to atomics.
+        if(internal->fieldAccumulation == FieldAccumulation::Atomic) return;
+        // LP: The memory of cached rays (bhcInit::cacheRays) is not counted, so
+        // that the number of tiles and therefore the results are the same as
+        // without them. The cached rays are freed if the tiles need the room.
+        size_t tileBytes = n * elemBytes + 16;
+        size_t avail     = AvailableMemory(internal) + internal->rayCache.memory;
+        int32_t numTiles;
+        if(HasFixedFieldTiles(internal)) {
+            if(internal->deterministicTiles < 1) {
+                EXTERR("deterministicTiles must be at least 1");
+            }
+            // LP: All the rays of the run, also if streamed, see FieldModesWorker.
+            int32_t numJobs = GetNumJobs<O3D>(params.Pos, params.Angles);
+            numTiles = bhc::min(internal->deterministicTiles, numJobs);
+            if(internal->fieldAccumulation == FieldAccumulation::Auto) {
+                int32_t fit = (int32_t)bhc::min(
+                    (size_t)numTiles, avail / 2 / tileBytes + (size_t)1);
+                if(fit < numTiles) {
+                    internal->PRTFile << "\nMemory for " << fit << " of " << numTiles
+                                      << " TL field tiles\n";
+                    numTiles = fit;
+                }
+            } else if((size_t)(numTiles - 1) > avail / tileBytes) {
+                EXTERR(
+                    "Insufficient memory for %d deterministic field tiles of %zu "
+                    "bytes, use fewer deterministicTiles or more memory",
+                    numTiles, tileBytes);
+            }
+            if(internal->fieldAccumulation == FieldAccumulation::Deterministic
+               && numTiles < internal->numThreads) {
+                EXTWARN(
+                    "Warning: deterministic field accumulation: %d tiles for %d "
+                    "threads, some threads will be idle",
+                    numTiles, internal->numThreads);
+            }
+        } else {
+            numTiles = internal->numThreads;
+            if((size_t)(numTiles - 1) > avail / 2 / tileBytes) return;
+        }
+        if(numTiles > 1) {
+            MakeRoomInRayCache<O3D>(params, (size_t)(numTiles - 1) * n * elemBytes);
+            trackallocate(
+                params, "thread-private field tiles", internal->fieldTiles,
+                (size_t)(numTiles - 1) * n * (elemBytes / sizeof(float)));
+        }
+        internal->numFieldTiles = bhc::max(numTiles, 1);
+#else
+        if(internal->fieldAccumulation == FieldAccumulation::Deterministic) {
+            EXTWARN("Warning: deterministic field accumulation is not supported in "
+                    "CUDA mode, using atomics");
+        }
+#endif
+    }
+
+    virtual void Run(bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs) const override
+    {
+        if(IsStreamed(params)) {
+            RunStreamedTL<O3D, R3D>(params, outputs);
+        } else {
+            Field<O3D, R3D>::Run(params, outputs);
+            ReduceFieldTiles<O3D, R3D>(params, outputs);
+        }
+        trackdeallocate(params, GetInternal(params)->fieldTiles);
+        GetInternal(params)->numFieldTiles = 0;
     }
 
     virtual void Postprocess(
         bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs) const override
     {
+        // LP: Streamed runs postprocess each tile in RunStreamedTL.
+        if(IsStreamed(params)) return;
         PostProcessTL<O3D, R3D>(params, outputs);
     }
 
     virtual void Writeout(
         const bhcParams<O3D> &params, const bhcOutputs<O3D, R3D> &outputs) const override
     {
+        // LP: Streamed runs have already written the shade file.
+        if(IsStreamed(params)) return;
         WriteOutTL<O3D, R3D>(params, outputs);
     }
 
@@ -96,6 +240,110 @@ public:
         bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs) const override
     {
         trackdeallocate(params, outputs.uAllSources);
+        trackdeallocate(params, outputs.uAllSourcesReal);
+        trackdeallocate(params, outputs.tlDB);
+        trackdeallocate(params, outputs.tlPhase);
+        trackdeallocate(params, GetInternal(params)->fieldTiles);
+        GetInternal(params)->numFieldTiles = 0;
+    }
+
+private:
+    bool IsStreamed(const bhcParams<O3D> &params) const
+    {
+        return GetInternal(params)->streamTL;
+    }
+
+    /**
+     * Allocates the TL in dB (and phase) outputs, see bhcInit::tlDB. This is
+     * done before the field, so that the number of field tiles accounts for
+     * them.
+     */
+    void AllocateDB(const bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs) const
+    {
+        bhcInternal *internal = GetInternal(params);
+        trackdeallocate(params, outputs.tlDB); // Free if previously run
+        trackdeallocate(params, outputs.tlPhase);
+        if(!internal->tlDB) return;
+        if(IsStreamed(params)) {
+            EXTERR("TL in dB output is not supported with streamTL");
+        }
+        size_t n = GetFieldSize(params.Pos) * params.freqinfo->Nfreq;
+        trackallocate(params, "transmission loss in dB", outputs.tlDB, n);
+        if(internal->tlPhase) {
+            trackallocate(params, "transmission loss phase", outputs.tlPhase, n);
+        }
+    }
+
+    /// Memory left under maxMemory, clamped at 0.
+    static size_t AvailableMemory(const bhcInternal *internal)
+    {
+        return internal->usedMemory < internal->maxMemory
+            ? internal->maxMemory - internal->usedMemory
+            : 0;
+    }
+
+    static int32_t NumSources(const Position *Pos)
+    {
+        return Pos->NSx * Pos->NSy * Pos->NSz;
+    }
+
+    static int32_t TileSources(const bhcParams<O3D> &params)
+    {
+        const int32_t *ns = GetInternal(params)->streamTileNS;
+        return ns[0] * ns[1] * ns[2];
+    }
+
+    /**
+     * LP: Chooses the source tiles of a streamed run (see RunStreamedTL): as
+     * many sources as fit, as whole planes of sources in x, else whole rows in
+     * y, else depths of one source column. The two tiles of the streamed field
+     * get at most half of the free memory, and the memory must also hold the
+     * field tiles AllocateField adds for them (deterministicTiles in
+     * Deterministic mode, or deterministicTiles in Auto mode or one per thread
+     * in PerThread mode within half of the memory left). n is the number of
+     * field elements of all the sources; returns the number of one tile.
+     */
+    size_t SetSourceTileDims(
+        const bhcParams<O3D> &params, size_t n, size_t elemBytes) const
+    {
+        bhcInternal *internal = GetInternal(params);
+        const Position *Pos   = params.Pos;
+        size_t srcElems       = n / (size_t)NumSources(Pos);
+        size_t avail          = AvailableMemory(internal);
+        size_t parts          = 4;
+#ifndef BHC_BUILD_CUDA
+        if(internal->fieldAccumulation == FieldAccumulation::Deterministic) {
+            parts = bhc::max(
+                parts, (size_t)bhc::max(internal->deterministicTiles, 1) + 1);
+        } else if(internal->fieldAccumulation == FieldAccumulation::Auto) {
+            parts = bhc::max(
+                parts, (size_t)bhc::max(internal->deterministicTiles, 1) * 2 + 2);
+        } else if(internal->fieldAccumulation == FieldAccumulation::PerThread) {
+            parts = bhc::max(parts, (size_t)2 * (size_t)internal->numThreads);
+        }
+#endif
+        // Padding of each tile, see AllocateField
+        avail      = avail > parts * 16 ? avail - parts * 16 : 0;
+        size_t fit = bhc::max(avail / parts / (srcElems * elemBytes), (size_t)1);
+        int32_t *ns           = internal->streamTileNS;
+        size_t plane          = (size_t)Pos->NSy * (size_t)Pos->NSz;
+        if(fit >= plane) {
+            ns[0] = (int32_t)bhc::min(fit / plane, (size_t)Pos->NSx);
+            ns[1] = Pos->NSy;
+            ns[2] = Pos->NSz;
+        } else if(fit >= (size_t)Pos->NSz) {
+            ns[0] = 1;
+            ns[1] = (int32_t)(fit / (size_t)Pos->NSz);
+            ns[2] = Pos->NSz;
+        } else {
+            ns[0] = ns[1] = 1;
+            ns[2]         = (int32_t)fit;
+        }
+        int32_t numTiles = ((Pos->NSx + ns[0] - 1) / ns[0])
+            * ((Pos->NSy + ns[1] - 1) / ns[1]) * ((Pos->NSz + ns[2] - 1) / ns[2]);
+        internal->PRTFile << "\nStreaming TL in " << numTiles << " tile(s) of " << ns[0]
+                          << " x " << ns[1] << " x " << ns[2] << " sources\n";
+        return srcElems * (size_t)TileSources(params);
     }
 };
 
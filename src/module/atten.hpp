@@ -36,12 +36,16 @@ public:
     Atten() {}
     virtual ~Atten() {}
 
+    virtual const char *Name() const override { return "Atten"; }
+    virtual uint32_t Inputs() const override { return 0; }
+
     virtual void SetupPre(bhcParams<O3D> &params) const override
     {
         params.atten->t        = FL(20.0);
         params.atten->Salinity = FL(35.0);
         params.atten->pH       = FL(8.0);
         params.atten->z_bar    = FL(0.0);
+        params.atten->dirty    = true;
     }
     virtual void Default(bhcParams<O3D> &) const override {}
 };
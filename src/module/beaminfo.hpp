@@ -30,6 +30,9 @@ public:
     BeamInfo() {}
     virtual ~BeamInfo() {}
 
+    virtual const char *Name() const override { return "BeamInfo"; }
+    virtual uint32_t Inputs() const override { return INPUT_BEAM | INPUT_BDRY; }
+
     virtual void SetupPre(bhcParams<O3D> &params) const override
     {
         BeamStructure<O3D> *Beam = params.Beam;
@@ -38,6 +41,7 @@ public:
 
         Beam->rangeInKm  = true;
         Beam->autoDeltas = false;
+        Beam->dirty      = true;
 
         Beam->deltas = RL(0.0);
         Beam->Box.x = Beam->Box.y = RL(-1.0);
@@ -28,6 +28,9 @@ public:
     BotOpt() {}
     virtual ~BotOpt() {}
 
+    virtual const char *Name() const override { return "BotOpt"; }
+    virtual uint32_t Inputs() const override { return INPUT_BDRY; }
+
     virtual void Default(bhcParams<O3D> &params) const override
     {
         memcpy(params.Bdry->Bot.hs.Opt, "R-    ", 6);
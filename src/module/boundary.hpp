@@ -31,10 +31,23 @@ public:
     Boundary() {}
     virtual ~Boundary() {}
 
+    virtual const char *Name() const override
+    {
+        return ISTOP ? "Altimetry" : "Bathymetry";
+    }
+    virtual uint32_t Inputs() const override
+    {
+        return (ISTOP ? INPUT_ALTIMETRY : INPUT_BATHYMETRY) | INPUT_BDRY | INPUT_ATTEN
+            | INPUT_FREQINFO;
+    }
+
     virtual void Init(bhcParams<O3D> &params) const override
     {
         BdryInfoTopBot<O3D> *bdinfotb = GetBdryInfoTopBot(params);
         bdinfotb->bd                  = nullptr;
+        bdinfotb->gridx               = nullptr;
+        bdinfotb->gridy               = nullptr;
+        bdinfotb->depth               = nullptr;
     }
 
     virtual void SetupPre(bhcParams<O3D> &params) const override
@@ -58,6 +71,7 @@ public:
         if constexpr(O3D) {
             bdinfotb->type[0] = 'R';
             bdinfotb->NPts    = int2(2, 2);
+            FreeCompact(params, bdinfotb);
             trackallocate(params, s_altimetrybathymetry, bdinfotb->bd, 2 * 2);
 
             bdinfotb->bd[0].x = vec3(-BDRYBIG, -BDRYBIG, BdryDepth(params));
@@ -127,17 +141,30 @@ public:
             SubTab(Globaly, bdinfotb->NPts.y);
 
             // z values
-            trackallocate(
-                params, s_altimetrybathymetry, bdinfotb->bd,
-                bdinfotb->NPts.x * bdinfotb->NPts.y);
+            AllocateGrid(params, bdinfotb);
 
-            for(int32_t iy = 0; iy < bdinfotb->NPts.y; ++iy) {
-                LIST(BDRYFile); // read a row of depths
-                for(int32_t ix = 0; ix < bdinfotb->NPts.x; ++ix) {
-                    vec3 &x = bdinfotb->bd[ix * bdinfotb->NPts.y + iy].x;
-                    BDRYFile.Read(x.z);
-                    x.x = Globalx[ix];
-                    x.y = Globaly[iy];
+            if(bdinfotb->bd == nullptr) {
+                for(int32_t ix = 0; ix < bdinfotb->NPts.x; ++ix)
+                    bdinfotb->gridx[ix] = Globalx[ix];
+                for(int32_t iy = 0; iy < bdinfotb->NPts.y; ++iy)
+                    bdinfotb->gridy[iy] = Globaly[iy];
+                for(int32_t iy = 0; iy < bdinfotb->NPts.y; ++iy) {
+                    LIST(BDRYFile); // read a row of depths
+                    for(int32_t ix = 0; ix < bdinfotb->NPts.x; ++ix) {
+                        real z;
+                        BDRYFile.Read(z);
+                        bdinfotb->depth[ix * bdinfotb->NPts.y + iy] = (float)z;
+                    }
+                }
+            } else {
+                for(int32_t iy = 0; iy < bdinfotb->NPts.y; ++iy) {
+                    LIST(BDRYFile); // read a row of depths
+                    for(int32_t ix = 0; ix < bdinfotb->NPts.x; ++ix) {
+                        vec3 &x = bdinfotb->bd[ix * bdinfotb->NPts.y + iy].x;
+                        BDRYFile.Read(x.z);
+                        x.x = Globalx[ix];
+                        x.y = Globaly[iy];
+                    }
                 }
             }
 
@@ -203,22 +230,34 @@ public:
         BDRYFile << '\n';
 
         if constexpr(O3D) {
-            // x values
-            UnSubTab(
-                BDRYFile, &bdinfotb->bd[0].x.x, bdinfotb->NPts.x, "NPts.x", nullptr,
-                RL(0.001),
-                bdinfotb->NPts.y * sizeof(bdinfotb->bd[0]) / sizeof(bdinfotb->bd[0].x.x));
-
-            // y values
-            UnSubTab(
-                BDRYFile, &bdinfotb->bd[0].x.y, bdinfotb->NPts.y, "NPts.y", nullptr,
-                RL(0.001), sizeof(bdinfotb->bd[0]) / sizeof(bdinfotb->bd[0].x.y));
+            if(bdinfotb->bd == nullptr) {
+                // x values
+                UnSubTab(
+                    BDRYFile, bdinfotb->gridx, bdinfotb->NPts.x, "NPts.x", nullptr,
+                    RL(0.001));
+
+                // y values
+                UnSubTab(
+                    BDRYFile, bdinfotb->gridy, bdinfotb->NPts.y, "NPts.y", nullptr,
+                    RL(0.001));
+            } else {
+                // x values
+                UnSubTab(
+                    BDRYFile, &bdinfotb->bd[0].x.x, bdinfotb->NPts.x, "NPts.x", nullptr,
+                    RL(0.001),
+                    bdinfotb->NPts.y * sizeof(bdinfotb->bd[0])
+                        / sizeof(bdinfotb->bd[0].x.x));
+
+                // y values
+                UnSubTab(
+                    BDRYFile, &bdinfotb->bd[0].x.y, bdinfotb->NPts.y, "NPts.y", nullptr,
+                    RL(0.001), sizeof(bdinfotb->bd[0]) / sizeof(bdinfotb->bd[0].x.y));
+            }
 
             // z values
             for(int32_t iy = 0; iy < bdinfotb->NPts.y; ++iy) {
                 for(int32_t ix = 0; ix < bdinfotb->NPts.x; ++ix) {
-                    vec3 &x = bdinfotb->bd[ix * bdinfotb->NPts.y + iy].x;
-                    BDRYFile << x.z;
+                    BDRYFile << BdryNodeX(bdinfotb, ix, iy).z;
                 }
                 BDRYFile << '\n';
             }
@@ -251,11 +290,10 @@ public:
         BdryInfoTopBot<O3D> *bdinfotb = GetBdryInfoTopBot(params);
         GetModeFlag(params)           = '~';
         bdinfotb->dirty               = true;
+        params.Bdry->dirty            = true;
         bdinfotb->NPts                = NPts;
         if constexpr(O3D) {
-            trackallocate(
-                params, s_altimetrybathymetry, bdinfotb->bd,
-                bdinfotb->NPts.x * bdinfotb->NPts.y);
+            AllocateGrid(params, bdinfotb);
         } else {
             trackallocate(params, s_altimetrybathymetry, bdinfotb->bd, bdinfotb->NPts);
         }
@@ -290,14 +328,17 @@ public:
                     "Read%s: %s option (type[1]) must be ' ' in Nx2D/3D mode\n", s_ATIBTY,
                     s_altimetrybathymetry);
             }
+            bool compact = bdinfotb->bd == nullptr;
             if(!monotonic(
-                   &bdinfotb->bd[0].x.x, bdinfotb->NPts.x,
-                   bdinfotb->NPts.y * BdryStride<O3D>, 0)) {
+                   compact ? bdinfotb->gridx : &bdinfotb->bd[0].x.x, bdinfotb->NPts.x,
+                   compact ? 1 : bdinfotb->NPts.y * BdryStride<O3D>, 0)) {
                 EXTERR(
                     "BELLHOP:Read%s: %s x-coordinates are not monotonically increasing",
                     s_ATIBTY, s_AltimetryBathymetry);
             }
-            if(!monotonic(&bdinfotb->bd[0].x.y, bdinfotb->NPts.y, BdryStride<O3D>, 0)) {
+            if(!monotonic(
+                   compact ? bdinfotb->gridy : &bdinfotb->bd[0].x.y, bdinfotb->NPts.y,
+                   compact ? 1 : BdryStride<O3D>, 0)) {
                 EXTERR(
                     "BELLHOP:Read%s: %s y-coordinates are not monotonically increasing",
                     s_ATIBTY, s_AltimetryBathymetry);
@@ -306,8 +347,7 @@ public:
             bool warnedNaN = false;
             for(int32_t iy = 0; iy < bdinfotb->NPts.y; ++iy) {
                 for(int32_t ix = 0; ix < bdinfotb->NPts.x; ++ix) {
-                    const vec3 &x = bdinfotb->bd[ix * bdinfotb->NPts.y + iy].x;
-                    if(!std::isfinite(x.z) && !warnedNaN) {
+                    if(!std::isfinite(BdryNodeX(bdinfotb, ix, iy).z) && !warnedNaN) {
                         PRTFile << "Warning in " BHC_PROGRAMNAME "3D - Read" << s_ATIBTY
                                 << "3D : The " << s_altimetrybathymetry
                                 << " file contains a NaN\n";
@@ -369,17 +409,20 @@ public:
         }
 
         if constexpr(O3D) {
+            bool compact = bdinfotb->bd == nullptr;
             PRTFile << "\nNumber of " << s_altimetrybathymetry << " points in x "
                     << bdinfotb->NPts.x << "\n";
             EchoVector(
-                &bdinfotb->bd[0].x.x, bdinfotb->NPts.x, PRTFile, Bdry_Number_to_Echo, "",
-                RL(0.001), bdinfotb->NPts.y * BdryStride<O3D>, 0);
+                compact ? bdinfotb->gridx : &bdinfotb->bd[0].x.x, bdinfotb->NPts.x,
+                PRTFile, Bdry_Number_to_Echo, "", RL(0.001),
+                compact ? 1 : bdinfotb->NPts.y * BdryStride<O3D>, 0);
 
             PRTFile << "\nNumber of " << s_altimetrybathymetry << " points in y "
                     << bdinfotb->NPts.y << "\n";
             EchoVector(
-                &bdinfotb->bd[0].x.y, bdinfotb->NPts.y, PRTFile, Bdry_Number_to_Echo, "",
-                RL(0.001), BdryStride<O3D>, 0);
+                compact ? bdinfotb->gridy : &bdinfotb->bd[0].x.y, bdinfotb->NPts.y,
+                PRTFile, Bdry_Number_to_Echo, "", RL(0.001),
+                compact ? 1 : BdryStride<O3D>, 0);
 
             PRTFile << "\n";
         } else {
@@ -433,11 +476,18 @@ public:
             bdinfotb->rangeInKm = false;
             // convert km to m
             if constexpr(O3D) {
-                for(int32_t iy = 0; iy < bdinfotb->NPts.y; ++iy) {
-                    for(int32_t ix = 0; ix < bdinfotb->NPts.x; ++ix) {
-                        vec3 &x = bdinfotb->bd[ix * bdinfotb->NPts.y + iy].x;
-                        x.x *= RL(1000.0);
-                        x.y *= RL(1000.0);
+                if(bdinfotb->bd == nullptr) {
+                    for(int32_t ix = 0; ix < bdinfotb->NPts.x; ++ix)
+                        bdinfotb->gridx[ix] *= RL(1000.0);
+                    for(int32_t iy = 0; iy < bdinfotb->NPts.y; ++iy)
+                        bdinfotb->gridy[iy] *= RL(1000.0);
+                } else {
+                    for(int32_t iy = 0; iy < bdinfotb->NPts.y; ++iy) {
+                        for(int32_t ix = 0; ix < bdinfotb->NPts.x; ++ix) {
+                            vec3 &x = bdinfotb->bd[ix * bdinfotb->NPts.y + iy].x;
+                            x.x *= RL(1000.0);
+                            x.y *= RL(1000.0);
+                        }
                     }
                 }
             } else {
@@ -472,6 +522,7 @@ public:
     {
         BdryInfoTopBot<O3D> *bdinfotb = GetBdryInfoTopBot(params);
         trackdeallocate(params, bdinfotb->bd);
+        FreeCompact(params, bdinfotb);
     }
 
 private:
@@ -504,6 +555,34 @@ private:
             return &params.bdinfo->bot;
     }
 
+    void FreeCompact(bhcParams<O3D> &params, BdryInfoTopBot<O3D> *bdinfotb) const
+    {
+        trackdeallocate(params, bdinfotb->gridx);
+        trackdeallocate(params, bdinfotb->gridy);
+        trackdeallocate(params, bdinfotb->depth);
+    }
+    /**
+     * Nx2D/3D: allocate the boundary for NPts, either compact (bhcInit::compactBdry)
+     * or as a BdryPtFull per point, and free the other representation.
+     */
+    void AllocateGrid(bhcParams<O3D> &params, BdryInfoTopBot<O3D> *bdinfotb) const
+    {
+        if constexpr(O3D) {
+            size_t n = (size_t)bdinfotb->NPts.x * (size_t)bdinfotb->NPts.y;
+            if(GetInternal(params)->compactBdry) {
+                trackdeallocate(params, bdinfotb->bd);
+                trackallocate(
+                    params, s_altimetrybathymetry, bdinfotb->gridx, bdinfotb->NPts.x);
+                trackallocate(
+                    params, s_altimetrybathymetry, bdinfotb->gridy, bdinfotb->NPts.y);
+                trackallocate(params, s_altimetrybathymetry, bdinfotb->depth, n);
+            } else {
+                FreeCompact(params, bdinfotb);
+                trackallocate(params, s_altimetrybathymetry, bdinfotb->bd, n);
+            }
+        }
+    }
+
     constexpr static const char *s_atibty              = ISTOP ? "ati" : "bty";
     constexpr static const char *s_ATIBTY              = ISTOP ? "ATI" : "BTY";
     constexpr static const char *s_altimetrybathymetry = ISTOP ? "altimetry"
@@ -528,6 +607,10 @@ private:
         vec3 tvec;
 
         if constexpr(O3D) {
+            // LP: Compact boundary: normals and curvatures are computed where they
+            // are needed, see BdryInfoTopBot.
+            if(bd->bd == nullptr) return;
+
             // normals on triangle faces
             for(int32_t ix = 0; ix < NPts.x - 1; ++ix) {
                 for(int32_t iy = 0; iy < NPts.y - 1; ++iy) {
@@ -538,29 +621,11 @@ private:
                     vec3 p3 = bd->bd[(ix + 1) * NPts.y + iy + 1].x;
                     vec3 p4 = bd->bd[(ix)*NPts.y + iy + 1].x;
 
-                    // edges for triangle 1
-                    vec3 u = p2 - p1; // tangent along one edge
-                    vec3 v = p3 - p1; // tangent along another edge
-
-                    // normal vector is the cross-product of the edge tangents
-                    vec3 n1 = glm::cross(u, v);
-                    if constexpr(ISTOP) n1 = -n1;
-
-                    bd->bd[ix * NPts.y + iy].n1 = n1 / glm::length(n1); // scale to make
-                                                                        // it a unit
-                                                                        // normal
-
-                    // edges for triangle 2
-                    u = p3 - p1; // tangent along one edge
-                    v = p4 - p1; // tangent along another edge
-
-                    // normal vector is the cross-product of the edge tangents
-                    vec3 n2 = glm::cross(u, v);
-                    if constexpr(ISTOP) n2 = -n2;
-
-                    bd->bd[ix * NPts.y + iy].n2 = n2 / glm::length(n2); // scale to make
-                                                                        // it a unit
-                                                                        // normal
+                    // normals for triangles 1 and 2
+                    bd->bd[ix * NPts.y + iy].n1
+                        = BdryTriNormal(p1, p2, p3, p4, false, ISTOP);
+                    bd->bd[ix * NPts.y + iy].n2
+                        = BdryTriNormal(p1, p2, p3, p4, true, ISTOP);
                 }
             }
 
@@ -568,42 +633,7 @@ private:
             // use forward, centered, or backward difference formulas
             for(int32_t ix = 0; ix < NPts.x; ++ix) {
                 for(int32_t iy = 0; iy < NPts.y; ++iy) {
-                    real mx, my;
-                    if(ix == 0) {
-                        mx = (bd->bd[(ix + 1) * NPts.y + iy].x.z
-                              - bd->bd[(ix)*NPts.y + iy].x.z)
-                            / (bd->bd[(ix + 1) * NPts.y + iy].x.x
-                               - bd->bd[(ix)*NPts.y + iy].x.x);
-                    } else if(ix == NPts.x - 1) {
-                        mx = (bd->bd[(ix)*NPts.y + iy].x.z
-                              - bd->bd[(ix - 1) * NPts.y + iy].x.z)
-                            / (bd->bd[(ix)*NPts.y + iy].x.x
-                               - bd->bd[(ix - 1) * NPts.y + iy].x.x);
-                    } else {
-                        mx = (bd->bd[(ix + 1) * NPts.y + iy].x.z
-                              - bd->bd[(ix - 1) * NPts.y + iy].x.z)
-                            / (bd->bd[(ix + 1) * NPts.y + iy].x.x
-                               - bd->bd[(ix - 1) * NPts.y + iy].x.x);
-                    }
-
-                    if(iy == 0) {
-                        my = (bd->bd[(ix)*NPts.y + iy + 1].x.z
-                              - bd->bd[(ix)*NPts.y + iy].x.z)
-                            / (bd->bd[(ix)*NPts.y + iy + 1].x.y
-                               - bd->bd[(ix)*NPts.y + iy].x.y);
-                    } else if(iy == NPts.y - 1) {
-                        my = (bd->bd[(ix)*NPts.y + iy].x.z
-                              - bd->bd[(ix)*NPts.y + iy - 1].x.z)
-                            / (bd->bd[(ix)*NPts.y + iy].x.y
-                               - bd->bd[(ix)*NPts.y + iy - 1].x.y);
-                    } else {
-                        my = (bd->bd[(ix)*NPts.y + iy + 1].x.z
-                              - bd->bd[(ix)*NPts.y + iy - 1].x.z)
-                            / (bd->bd[(ix)*NPts.y + iy + 1].x.y
-                               - bd->bd[(ix)*NPts.y + iy - 1].x.y);
-                    }
-
-                    vec3 n = vec3(-mx, -my, RL(1.0)); // this is a normal to the surface
+                    vec3 n = BdryNodeNormalUnscaled(bd, ix, iy);
 
                     if(ix < NPts.x - 1 && iy < NPts.y - 1) {
                         // xx term
@@ -32,11 +32,23 @@ public:
     BoundaryCond() {}
     virtual ~BoundaryCond() {}
 
+    virtual const char *Name() const override
+    {
+        return ISTOP ? "BoundaryCondTop" : "BoundaryCondBot";
+    }
+    virtual uint32_t Inputs() const override
+    {
+        return INPUT_BDRY | INPUT_SSP | INPUT_ATTEN | INPUT_FREQINFO;
+    }
+    /// Preprocess computes the halfspace properties in Bdry.
+    virtual uint32_t Outputs() const override { return INPUT_BDRY; }
+
     virtual void SetupPre(bhcParams<O3D> &params) const override
     {
         HSInfo &hs = GetBdry(params).hs;
         hs.cP = hs.cS = hs.rho = FL(0.0);
         params.fT              = RL(1.0e20);
+        params.Bdry->dirty     = true;
     }
 
     virtual void Default(bhcParams<O3D> &) const override {}
@@ -27,6 +27,9 @@ public:
     Freq0() {}
     virtual ~Freq0() {}
 
+    virtual const char *Name() const override { return "Freq0"; }
+    virtual uint32_t Inputs() const override { return 0; }
+
     virtual void Default(bhcParams<O3D> &params) const override
     {
         params.freqinfo->freq0 = RL(50.0);
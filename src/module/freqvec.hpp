@@ -30,13 +30,17 @@ namespace bhc { namespace module {
  * never be selected because that letter is used to select dev mode (single beam),
  * and putting 'B' there is considered invalid. Plus, freqVec is never read during
  * the beam trace or influence. However, this can't be removed, as the frequency
- * vector must be written out to the shade file.
+ * vector must be written out to the shade file. In bellhopcxx / bellhopcuda, a
+ * frequency vector set up with extsetup_freqvec is used for broadband TL runs.
  */
 template<bool O3D> class FreqVec : public ParamsModule<O3D> {
 public:
     FreqVec() {}
     virtual ~FreqVec() {}
 
+    virtual const char *Name() const override { return "FreqVec"; }
+    virtual uint32_t Inputs() const override { return INPUT_FREQINFO; }
+
     virtual void Init(bhcParams<O3D> &params) const override
     {
         params.freqinfo->freqVec = nullptr;
@@ -44,6 +48,7 @@ public:
     virtual void SetupPre(bhcParams<O3D> &params) const override
     {
         params.freqinfo->Nfreq = 1;
+        params.freqinfo->dirty = true;
     }
     virtual void Default(bhcParams<O3D> &params) const override
     {
@@ -72,6 +77,7 @@ public:
     void ExtSetup(bhcParams<O3D> &params, int32_t Nfreq) const
     {
         params.freqinfo->Nfreq = Nfreq;
+        params.freqinfo->dirty = true;
         trackallocate(
             params, Description, params.freqinfo->freqVec, params.freqinfo->Nfreq);
     }
@@ -0,0 +1,305 @@
+/*
+bellhopcxx / bellhopcuda - C++/CUDA port of BELLHOP(3D) underwater acoustics simulator
+Copyright (C) 2021-2023 The Regents of the University of California
+Marine Physical Lab at Scripps Oceanography, c/o Jules Jaffe, jjaffe@ucsd.edu
+Based on BELLHOP / BELLHOP3D, which is Copyright (C) 1983-2022 Michael B. Porter
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "../common_setup.hpp"
+#include "paramsmodule.hpp"
+#include "../reflect.hpp"
+
+namespace bhc { namespace module {
+
+/**
+ * LP: Optional tables of the acousto-elastic halfspace reflection coefficient
+ * (see bhcInit::hsReflTableRes and HSReflTable). The reflection coefficient
+ * depends on the sound speed of the water at the reflection point as well as on
+ * the angle, so the tables are of the factors which only depend on the
+ * halfspace and on the ray slowness along the boundary (see HalfspaceFactors).
+ */
+template<bool O3D> class HSRefl : public ParamsModule<O3D> {
+public:
+    HSRefl() {}
+    virtual ~HSRefl() {}
+
+    virtual const char *Name() const override { return "HSRefl"; }
+    virtual uint32_t Inputs() const override
+    {
+        return INPUT_BDRY | INPUT_ALTIMETRY | INPUT_BATHYMETRY | INPUT_SSP | INPUT_ATTEN
+            | INPUT_FREQINFO | INPUT_POS | INPUT_BEAM;
+    }
+
+    virtual void Init(bhcParams<O3D> &params) const override
+    {
+        HSReflTable &hst           = params.refl->hs;
+        hst.NTables                = 0;
+        hst.NPts                   = 0;
+        hst.f                      = nullptr;
+        hst.g                      = nullptr;
+        params.Bdry->Top.hs.iTable = -1;
+        params.Bdry->Bot.hs.iTable = -1;
+    }
+
+    virtual void Default(bhcParams<O3D> &) const override {}
+
+    virtual void Validate(bhcParams<O3D> &params) const override
+    {
+        double res = GetInternal(params)->hsReflTableRes;
+        if(!(res >= 0.0 && res <= 10.0)) {
+            EXTERR("Halfspace reflection table resolution must be between 0 and 10 "
+                   "degrees");
+        }
+    }
+
+    virtual void Echo(bhcParams<O3D> &params) const override
+    {
+        if(!IsEnabled(params)) return;
+        PrintFileEmu &PRTFile = GetInternal(params)->PRTFile;
+        PRTFile << "\nTabulating halfspace reflection coefficients with resolution "
+                << GetInternal(params)->hsReflTableRes << " degrees\n";
+    }
+
+    virtual void Preprocess(bhcParams<O3D> &params) const override
+    {
+        HSReflTable &hst = params.refl->hs;
+        trackdeallocate(params, hst.f);
+        trackdeallocate(params, hst.g);
+        hst.NTables = 0;
+
+        std::vector<HSInfo> tables;
+        bool enabled = IsEnabled(params);
+        AssignTable(tables, params.Bdry->Top.hs, params.Bdry->Top.hs.bc, enabled);
+        AssignTable(tables, params.Bdry->Bot.hs, params.Bdry->Bot.hs.bc, enabled);
+        // LP: Range-dependent geoacoustics, see CopyHSInfo. These are only
+        // supported in 2D (type[1] must be ' ' in Nx2D/3D, see Boundary), so
+        // there the top and bottom halfspaces above are the only ones.
+        if constexpr(!O3D) {
+            AssignBdryTables(tables, params.bdinfo->top, params.Bdry->Top.hs.bc, enabled);
+            AssignBdryTables(tables, params.bdinfo->bot, params.Bdry->Bot.hs.bc, enabled);
+        }
+        if(tables.empty()) return;
+
+        real cMin, cMax, rhoMin, rhoMax;
+        SoundSpeedRange(cMin, cMax, params);
+        DensityRange(rhoMin, rhoMax, params.ssp);
+        hst.cRef    = cMin;
+        hst.du      = DegRad * (real)GetInternal(params)->hsReflTableRes;
+        hst.NPts    = (int32_t)STD::ceil(RL(1.0) / hst.du) + 2;
+        hst.NTables = (int32_t)tables.size();
+        size_t n    = (size_t)hst.NTables * (size_t)hst.NPts;
+        trackallocate(params, "halfspace reflection tables", hst.f, n);
+        trackallocate(params, "halfspace reflection tables", hst.g, n);
+
+        real maxErr = RL(0.0), maxErrAngle = RL(0.0);
+        for(int32_t t = 0; t < hst.NTables; ++t) {
+            const HSInfo &hs = tables[t];
+            cpx *f           = &hst.f[(size_t)t * (size_t)hst.NPts];
+            cpx *g           = &hst.g[(size_t)t * (size_t)hst.NPts];
+            for(int32_t i = 0; i < hst.NPts; ++i) {
+                HalfspaceFactors<O3D>(f[i], g[i], (real)i * hst.du / hst.cRef, hs);
+            }
+            // Accuracy check: compare to the exact reflection coefficient
+            // halfway between the table points, for water at the lowest, middle,
+            // and highest sound speeds and the lowest and highest densities.
+            const real cs[3]   = {cMin, RL(0.5) * (cMin + cMax), cMax};
+            const real rhos[2] = {rhoMin, rhoMax};
+            for(int32_t i = 0; i < hst.NPts - 1; ++i) {
+                real Tg = ((real)i + RL(0.5)) * hst.du / hst.cRef;
+                cpx fe, ge, fi, gi;
+                HalfspaceFactors<O3D>(fe, ge, Tg, hs);
+                if(!InterpolateHalfspaceTable(fi, gi, Tg, t, hst)) break;
+                for(real c : cs) {
+                    real u = Tg * c; // cos(grazing angle)
+                    if(u > RL(1.0)) continue;
+                    for(real rho : rhos) {
+                        real err = STD::abs(
+                            ReflCoef(fi, gi, Tg, c, rho) - ReflCoef(fe, ge, Tg, c, rho));
+                        if(err > maxErr) {
+                            maxErr      = err;
+                            maxErrAngle = RadDeg * STD::acos(u);
+                        }
+                    }
+                }
+            }
+        }
+
+        PrintFileEmu &PRTFile = GetInternal(params)->PRTFile;
+        PRTFile << "\nTabulated reflection coefficients of " << hst.NTables
+                << " halfspace(s), " << hst.NPts << " points each, for sound speeds >= "
+                << hst.cRef << " m/s\n";
+        PRTFile << "Checked for water sound speeds " << cMin << " to " << cMax
+                << " m/s and densities " << rhoMin << " to " << rhoMax << " g/cm3\n";
+        PRTFile << "Maximum interpolation error |dR| = " << maxErr << " at grazing angle "
+                << maxErrAngle << " degrees\n";
+        if(maxErr > MaxTableErr) {
+            EXTWARN(
+                "Halfspace reflection table interpolation error up to %g (at grazing "
+                "angle %g degrees), consider a finer hsReflTableRes",
+                (double)maxErr, (double)maxErrAngle);
+        }
+    }
+
+    virtual void Finalize(bhcParams<O3D> &params) const override
+    {
+        trackdeallocate(params, params.refl->hs.f);
+        trackdeallocate(params, params.refl->hs.g);
+    }
+
+private:
+    constexpr static real MaxTableErr = RL(1.0e-2);
+
+    bool IsEnabled(bhcParams<O3D> &params) const
+    {
+        return GetInternal(params)->hsReflTableRes > 0.0;
+    }
+
+    /**
+     * Sets hs.iTable to the table of a halfspace with the same properties,
+     * adding one if there is none, or to -1 if the boundary condition bc is not
+     * a halfspace or tables are not enabled.
+     */
+    void AssignTable(std::vector<HSInfo> &tables, HSInfo &hs, char bc, bool enabled) const
+    {
+        hs.iTable = -1;
+        if(!enabled || (bc != 'A' && bc != 'G')) return;
+        for(size_t t = 0; t < tables.size(); ++t) {
+            if(tables[t].cP == hs.cP && tables[t].cS == hs.cS
+               && tables[t].rho == hs.rho) {
+                hs.iTable = (int32_t)t;
+                return;
+            }
+        }
+        hs.iTable = (int32_t)tables.size();
+        tables.push_back(hs);
+    }
+
+    void AssignBdryTables(
+        std::vector<HSInfo> &tables, BdryInfoTopBot<O3D> &bdinfotb, char bc,
+        bool enabled) const
+    {
+        if(bdinfotb.bd == nullptr) return;
+        for(int32_t i = 0; i < bdinfotb.NPts; ++i) {
+            AssignTable(
+                tables, bdinfotb.bd[i].hs, bdinfotb.type[1] == 'L' ? bc : ' ', enabled);
+        }
+    }
+
+    /**
+     * Reflection coefficient as in Reflect, from the factors f and g, for ray
+     * slowness Tg along the boundary in water of sound speed c and density rho.
+     */
+    cpx ReflCoef(const cpx &f, const cpx &g, real Tg, real c, real rho) const
+    {
+        if constexpr(O3D) {
+            cpx gamma1 = STD::sqrt(-(RL(1.0) / SQ(c) - SQ(Tg) - J * REAL_MINPOS));
+            return (g * gamma1 - rho * f) / (g * gamma1 + rho * f);
+        } else {
+            real Th = STD::sqrt(bhc::max(RL(1.0) / SQ(c) - SQ(Tg), RL(0.0)));
+            return -(rho * f - J * Th * g) / (rho * f + J * Th * g);
+        }
+    }
+
+    /**
+     * LP: Range of sound speeds in the SSP. The minimum is the lower limit of
+     * the tabulated range; reflections at lower sound speeds (e.g. between the
+     * SSP points of a spline) fall back to the exact computation.
+     */
+    void SoundSpeedRange(real &cMin, real &cMax, const bhcParams<O3D> &params) const
+    {
+        const SSPStructure *ssp = params.ssp;
+        cMin                    = REAL_MAX;
+        cMax                    = -REAL_MAX;
+        if(ssp->Type == 'A') {
+            AnalyticSoundSpeedRange(cMin, cMax, params);
+        } else if(ssp->Type == 'Q' || ssp->Type == 'H') {
+            size_t n = ssp->Type == 'Q' ? (size_t)ssp->NPts * (size_t)ssp->Nr
+                                        : (size_t)ssp->Nx * (size_t)ssp->Ny * ssp->Nz;
+            for(size_t i = 0; i < n; ++i) {
+                cMin = bhc::min(cMin, ssp->cMat[i]);
+                cMax = bhc::max(cMax, ssp->cMat[i]);
+            }
+        } else {
+            for(int32_t i = 0; i < ssp->NPts; ++i) {
+                cMin = bhc::min(cMin, ssp->c[i].real());
+                cMax = bhc::max(cMax, ssp->c[i].real());
+            }
+        }
+    }
+
+    /**
+     * LP: Range of the analytic profile (see Analytic) between the top and
+     * bottom depths of the environment file, within the beam box:
+     * c = c0 * (1 + eps * h(w)) with h(w) = w - 1 + exp(-w) and w linear in
+     * depth. h is convex with its minimum of 0 at z = unk1, and in Nx2D/3D eps
+     * is linear in y, so the extremes are at the corners of the ranges of eps
+     * and of h.
+     */
+    void AnalyticSoundSpeedRange(
+        real &cMin, real &cMax, const bhcParams<O3D> &params) const
+    {
+        const real c0    = FL(1500.0);
+        const float unk1 = FL(1300.0);
+        const float unk2 = FL(0.00737);
+        auto h           = [&](real z) {
+            real w = FL(2.0) * (z - unk1) / unk1;
+            return w - FL(1.0) + STD::exp(-w);
+        };
+        real zMax = bhc::min(DEP(params.Beam->Box), params.Bdry->Bot.hs.Depth);
+        real zMin = bhc::max(-DEP(params.Beam->Box), params.Bdry->Top.hs.Depth);
+        real hLo  = h(bhc::min(bhc::max((real)unk1, zMin), zMax));
+        real hHi  = bhc::max(h(zMin), h(zMax));
+        real eLo = unk2, eHi = unk2;
+        if constexpr(O3D) {
+            const float unk3    = FL(100000.0);
+            const float unk4    = FL(0.003);
+            const Position *Pos = params.Pos;
+            real yMin = REAL_MAX, yMax = -REAL_MAX;
+            for(int32_t i = 0; i < Pos->NSy; ++i) {
+                yMin = bhc::min(yMin, (real)Pos->Sy[i]);
+                yMax = bhc::max(yMax, (real)Pos->Sy[i]);
+            }
+            eLo = unk2 + (yMin - params.Beam->Box.y) / unk3 * unk4;
+            eHi = unk2 + (yMax + params.Beam->Box.y) / unk3 * unk4;
+        }
+        for(real e : {eLo, eHi}) {
+            for(real hv : {hLo, hHi}) {
+                real c = c0 * (FL(1.0) + e * hv);
+                cMin   = bhc::min(cMin, c);
+                cMax   = bhc::max(cMax, c);
+            }
+        }
+    }
+
+    /**
+     * LP: Range of the water density (see LinInterpDensity); the analytic
+     * profile has unit density.
+     */
+    void DensityRange(real &rhoMin, real &rhoMax, const SSPStructure *ssp) const
+    {
+        if(ssp->Type == 'A' || ssp->NPts <= 0) {
+            rhoMin = rhoMax = RL(1.0);
+            return;
+        }
+        rhoMin = REAL_MAX;
+        rhoMax = -REAL_MAX;
+        for(int32_t i = 0; i < ssp->NPts; ++i) {
+            rhoMin = bhc::min(rhoMin, ssp->rho[i]);
+            rhoMax = bhc::max(rhoMax, ssp->rho[i]);
+        }
+    }
+};
+
+}} // namespace bhc::module
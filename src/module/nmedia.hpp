@@ -27,6 +27,9 @@ public:
     NMedia() {}
     virtual ~NMedia() {}
 
+    virtual const char *Name() const override { return "NMedia"; }
+    virtual uint32_t Inputs() const override { return INPUT_ATTEN; }
+
     virtual void Default(bhcParams<O3D> &params) const override
     {
         params.atten->NMedia = 1;
@@ -21,6 +21,63 @@ this program. If not, see <https://www.gnu.org/licenses/>.
 
 namespace bhc { namespace module {
 
+/**
+ * Bit flags for the structures in params which carry a dirty flag. Each module
+ * declares which of these it reads (Inputs) and writes (Outputs), which forms
+ * the dependency graph run() uses to only validate and preprocess the modules
+ * whose inputs have changed.
+ */
+enum ParamsInput : uint32_t {
+    INPUT_BDRY       = 1u << 0,
+    INPUT_ALTIMETRY  = 1u << 1,
+    INPUT_BATHYMETRY = 1u << 2,
+    INPUT_TRC        = 1u << 3,
+    INPUT_BRC        = 1u << 4,
+    INPUT_SSP        = 1u << 5,
+    INPUT_ATTEN      = 1u << 6,
+    INPUT_POS        = 1u << 7,
+    INPUT_ANGLES     = 1u << 8,
+    INPUT_FREQINFO   = 1u << 9,
+    INPUT_BEAM       = 1u << 10,
+    INPUT_SBP        = 1u << 11,
+    INPUT_ALL        = (1u << 12) - 1u,
+};
+
+template<bool O3D> inline uint32_t GetDirtyInputs(const bhcParams<O3D> &params)
+{
+    uint32_t dirty = 0;
+    if(params.Bdry->dirty) dirty |= INPUT_BDRY;
+    if(params.bdinfo->top.dirty) dirty |= INPUT_ALTIMETRY;
+    if(params.bdinfo->bot.dirty) dirty |= INPUT_BATHYMETRY;
+    if(params.refl->top.dirty) dirty |= INPUT_TRC;
+    if(params.refl->bot.dirty) dirty |= INPUT_BRC;
+    if(params.ssp->dirty) dirty |= INPUT_SSP;
+    if(params.atten->dirty) dirty |= INPUT_ATTEN;
+    if(params.Pos->dirty) dirty |= INPUT_POS;
+    if(params.Angles->dirty) dirty |= INPUT_ANGLES;
+    if(params.freqinfo->dirty) dirty |= INPUT_FREQINFO;
+    if(params.Beam->dirty) dirty |= INPUT_BEAM;
+    if(params.sbp->dirty) dirty |= INPUT_SBP;
+    return dirty;
+}
+
+/**
+ * LP: The ssp and bdinfo flags are cleared by their own modules, as they were
+ * before the other structures had dirty flags.
+ */
+template<bool O3D> inline void ClearDirtyInputs(bhcParams<O3D> &params)
+{
+    params.Bdry->dirty     = false;
+    params.refl->top.dirty = false;
+    params.refl->bot.dirty = false;
+    params.atten->dirty    = false;
+    params.Pos->dirty      = false;
+    params.Angles->dirty   = false;
+    params.freqinfo->dirty = false;
+    params.Beam->dirty     = false;
+    params.sbp->dirty      = false;
+}
+
 /**
  * Child classes are responsible for the initialization, defaults, reading,
  * etc. of some set of parameters within params. In addition to the methods
@@ -57,6 +114,14 @@ public:
     virtual void Preprocess(bhcParams<O3D> &) const {}
     /// Deallocate memory.
     virtual void Finalize(bhcParams<O3D> &) const {}
+    /// Name of the module, for the list of recomputed modules in the print file.
+    virtual const char *Name() const = 0;
+    /// ParamsInput flags of everything Validate and Preprocess read. The module
+    /// is skipped in later runs if none of these are dirty.
+    virtual uint32_t Inputs() const { return INPUT_ALL; }
+    /// ParamsInput flags of anything Validate and Preprocess may modify which
+    /// later modules in the list read, so that those are redone too.
+    virtual uint32_t Outputs() const { return 0; }
 };
 
 }} // namespace bhc::module
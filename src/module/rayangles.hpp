@@ -27,6 +27,12 @@ public:
     RayAngles() {}
     virtual ~RayAngles() {}
 
+    virtual const char *Name() const override { return FuncName; }
+    virtual uint32_t Inputs() const override
+    {
+        return INPUT_ANGLES | INPUT_BEAM | INPUT_BDRY | (BEARING ? INPUT_POS : 0u);
+    }
+
     virtual void Init(bhcParams<O3D> &params) const override
     {
         AngleInfo &a = GetAngle(params);
@@ -44,8 +50,9 @@ public:
         // LP: not a typo; this is an index, one less than the start of the array,
         // which in Fortran (and in the env file!) is 0. This gets converted to 0-
         // indexed when it is used.
-        a.iSingle   = 0;
-        a.inDegrees = true;
+        a.iSingle            = 0;
+        a.inDegrees          = true;
+        params.Angles->dirty = true;
     }
 
     virtual void Default(bhcParams<O3D> &params) const override
@@ -111,8 +118,9 @@ public:
 
     void ExtSetup(bhcParams<O3D> &params, int32_t n) const
     {
-        AngleInfo &a = GetAngle(params);
-        a.n          = n;
+        AngleInfo &a         = GetAngle(params);
+        a.n                  = n;
+        params.Angles->dirty = true;
         trackallocate(params, FuncName, a.angles, a.n);
     }
 
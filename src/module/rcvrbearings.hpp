@@ -27,10 +27,15 @@ public:
     RcvrBearings() {}
     virtual ~RcvrBearings() {}
 
+    virtual const char *Name() const override { return "RcvrBearings"; }
+    virtual uint32_t Inputs() const override { return INPUT_POS; }
+
     virtual void Init(bhcParams<O3D> &params) const override
     {
-        params.Pos->theta  = nullptr;
-        params.Pos->t_rcvr = nullptr;
+        params.Pos->theta       = nullptr;
+        params.Pos->t_rcvr      = nullptr;
+        params.Pos->thetaIndex  = nullptr;
+        params.Pos->NthetaIndex = 0;
     }
     virtual void SetupPre(bhcParams<O3D> &params) const override
     {
@@ -68,6 +73,7 @@ public:
     void ExtSetup(bhcParams<O3D> &params, int32_t Ntheta) const
     {
         params.Pos->Ntheta = Ntheta;
+        params.Pos->dirty  = true;
         trackallocate(params, Description, params.Pos->theta, params.Pos->Ntheta);
     }
     virtual void Validate(bhcParams<O3D> &params) const override
@@ -109,14 +115,47 @@ public:
             real theta            = DegRad * params.Pos->theta[i];
             params.Pos->t_rcvr[i] = vec2(STD::cos(theta), STD::sin(theta));
         }
+        if constexpr(O3D) { BuildThetaIndex(params); }
     }
     virtual void Finalize(bhcParams<O3D> &params) const override
     {
         trackdeallocate(params, params.Pos->theta);
         trackdeallocate(params, params.Pos->t_rcvr);
+        trackdeallocate(params, params.Pos->thetaIndex);
     }
 
 private:
+    /**
+     * LP: With hundreds of bearings, most of them are far outside the footprint
+     * of any given ray step. This index lets the 3D geometric Cartesian
+     * influence function find the bearings in an angular interval directly
+     * (see BearingRanges and BearingsGeoCart for which beams are pruned).
+     */
+    void BuildThetaIndex(bhcParams<O3D> &params) const
+    {
+        Position *Pos    = params.Pos;
+        Pos->NthetaIndex = 0;
+        if(Pos->Ntheta < 2) return;
+        for(int32_t i = 1; i < Pos->Ntheta; ++i) {
+            if(Pos->theta[i] < Pos->theta[i - 1]) return;
+        }
+        if(Pos->theta[Pos->Ntheta - 1] - Pos->theta[0] >= FL(360.0)) return;
+        int32_t nIndex = 16;
+        while(nIndex < 4 * Pos->Ntheta && nIndex < 65536) nIndex <<= 1;
+        trackallocate(params, "receiver bearing index", Pos->thetaIndex, nIndex + 1);
+        Pos->NthetaIndex = nIndex;
+        int32_t itheta   = 0;
+        for(int32_t k = 0; k < nIndex; ++k) {
+            real start = (real)k * (RL(2.0) * REAL_PI / (real)nIndex);
+            while(itheta < Pos->Ntheta
+                  && DegRad * (real)(Pos->theta[itheta] - Pos->theta[0]) < start) {
+                ++itheta;
+            }
+            Pos->thetaIndex[k] = itheta;
+        }
+        Pos->thetaIndex[nIndex] = Pos->Ntheta;
+    }
+
     constexpr static const char *Description = "Receiver bearings, theta";
     constexpr static const char *Units       = "degrees";
 };
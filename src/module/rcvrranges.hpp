@@ -27,6 +27,9 @@ public:
     RcvrRanges() {}
     virtual ~RcvrRanges() {}
 
+    virtual const char *Name() const override { return "RcvrRanges"; }
+    virtual uint32_t Inputs() const override { return INPUT_POS; }
+
     virtual void Init(bhcParams<O3D> &params) const override { params.Pos->Rr = nullptr; }
     virtual void SetupPre(bhcParams<O3D> &params) const override
     {
@@ -58,7 +61,8 @@ public:
     }
     void ExtSetup(bhcParams<O3D> &params, int32_t NRr) const
     {
-        params.Pos->NRr = NRr;
+        params.Pos->NRr   = NRr;
+        params.Pos->dirty = true;
         trackallocate(params, Description2, params.Pos->Rr, params.Pos->NRr);
     }
     virtual void Validate(bhcParams<O3D> &params) const override
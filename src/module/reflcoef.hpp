@@ -32,10 +32,17 @@ public:
     ReflCoef() {}
     virtual ~ReflCoef() {}
 
+    virtual const char *Name() const override { return s_RC; }
+    virtual uint32_t Inputs() const override
+    {
+        return (ISTOP ? INPUT_TRC : INPUT_BRC) | INPUT_BDRY;
+    }
+
     virtual void Init(bhcParams<O3D> &params) const override
     {
         ReflectionInfoTopBot *refltb = GetReflTopBot(params);
         refltb->r                    = nullptr;
+        refltb->dirty                = true;
     }
 
     virtual void Default(bhcParams<O3D> &params) const override
@@ -116,6 +123,8 @@ public:
         ReflectionInfoTopBot *refltb = GetReflTopBot(params);
         GetModeFlag(params)          = 'F';
         refltb->NPts                 = NPts;
+        refltb->dirty                = true;
+        params.Bdry->dirty           = true;
         trackallocate(params, "reflection coefficients", refltb->r, refltb->NPts);
     }
 
@@ -30,6 +30,11 @@ public:
     RunType() {}
     virtual ~RunType() {}
 
+    virtual const char *Name() const override { return "RunType"; }
+    virtual uint32_t Inputs() const override { return INPUT_BEAM | INPUT_POS; }
+    /// Validate fills in the defaults of Beam->RunType.
+    virtual uint32_t Outputs() const override { return INPUT_BEAM; }
+
     virtual void Default(bhcParams<O3D> &params) const override
     {
         // RunType, infl/beam type, ignored, point source, rectilinear grid, dim, ignored
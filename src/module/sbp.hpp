@@ -29,6 +29,9 @@ public:
     SBP() {}
     virtual ~SBP() {}
 
+    virtual const char *Name() const override { return "SBP"; }
+    virtual uint32_t Inputs() const override { return INPUT_SBP; }
+
     virtual void Init(bhcParams<O3D> &params) const override
     {
         params.sbp->SrcBmPat = nullptr;
@@ -38,6 +41,7 @@ public:
     {
         params.sbp->SBPFlag = params.Beam->RunType[2];
         params.sbp->SBPIndB = true;
+        params.sbp->dirty   = true;
     }
 
     virtual void Default(bhcParams<O3D> &params) const override
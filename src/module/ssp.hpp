@@ -28,6 +28,12 @@ public:
     SSP() {}
     virtual ~SSP() {}
 
+    virtual const char *Name() const override { return "SSP"; }
+    virtual uint32_t Inputs() const override
+    {
+        return INPUT_SSP | INPUT_BDRY | INPUT_ATTEN | INPUT_FREQINFO;
+    }
+
     virtual void Init(bhcParams<O3D> &params) const override
     {
         SSPStructure *ssp = params.ssp;
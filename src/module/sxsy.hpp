@@ -30,6 +30,9 @@ public:
     SxSy() {}
     virtual ~SxSy() {}
 
+    virtual const char *Name() const override { return "SxSy"; }
+    virtual uint32_t Inputs() const override { return INPUT_POS; }
+
     virtual void Init(bhcParams<O3D> &params) const override
     {
         params.Pos->Sx = nullptr;
@@ -40,6 +43,7 @@ public:
         params.Pos->SxSyInKm = true;
         params.Pos->NSx      = 1;
         params.Pos->NSy      = 1;
+        params.Pos->dirty    = true;
     }
     virtual void Default(bhcParams<O3D> &params) const override
     {
@@ -70,8 +74,9 @@ public:
     }
     void ExtSetup(bhcParams<O3D> &params, int32_t NSx, int32_t NSy) const
     {
-        params.Pos->NSx = NSx;
-        params.Pos->NSy = NSy;
+        params.Pos->NSx   = NSx;
+        params.Pos->NSy   = NSy;
+        params.Pos->dirty = true;
         trackallocate(params, DescriptionX, params.Pos->Sx, params.Pos->NSx);
         trackallocate(params, DescriptionY, params.Pos->Sy, params.Pos->NSy);
     }
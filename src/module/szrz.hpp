@@ -30,6 +30,12 @@ public:
     SzRz() {}
     virtual ~SzRz() {}
 
+    virtual const char *Name() const override { return "SzRz"; }
+    virtual uint32_t Inputs() const override
+    {
+        return INPUT_POS | INPUT_BDRY | INPUT_BEAM;
+    }
+
     virtual void Init(bhcParams<O3D> &params) const override
     {
         params.Pos->Sz = nullptr;
@@ -64,12 +70,14 @@ public:
     }
     void ExtSetupSz(bhcParams<O3D> &params, int32_t NSz) const
     {
-        params.Pos->NSz = NSz;
+        params.Pos->NSz   = NSz;
+        params.Pos->dirty = true;
         trackallocate(params, DescriptionS, params.Pos->Sz, params.Pos->NSz);
     }
     void ExtSetupRz(bhcParams<O3D> &params, int32_t NRz) const
     {
-        params.Pos->NRz = NRz;
+        params.Pos->NRz   = NRz;
+        params.Pos->dirty = true;
         trackallocate(params, DescriptionR, params.Pos->Rz, params.Pos->NRz);
     }
     virtual void Validate(bhcParams<O3D> &params) const override
@@ -138,7 +146,12 @@ public:
     virtual void Preprocess(bhcParams<O3D> &params) const override
     {
         // irregular or rectilinear grid
-        params.Pos->NRz_per_range = IsIrregularGrid(params.Beam) ? 1 : params.Pos->NRz;
+        Position *Pos      = params.Pos;
+        Pos->NRz_per_range = IsIrregularGrid(params.Beam) ? 1 : Pos->NRz;
+        Pos->RzSorted      = true;
+        for(int32_t iz = 1; iz < Pos->NRz_per_range; ++iz) {
+            if(Pos->Rz[iz] < Pos->Rz[iz - 1]) Pos->RzSorted = false;
+        }
     }
     virtual void Finalize(bhcParams<O3D> &params) const override
     {
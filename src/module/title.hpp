@@ -27,6 +27,9 @@ public:
     Title() {}
     virtual ~Title() {}
 
+    virtual const char *Name() const override { return "Title"; }
+    virtual uint32_t Inputs() const override { return 0; }
+
     virtual void Default(bhcParams<O3D> &params) const override
     {
         SetTitle(params, "no env file");
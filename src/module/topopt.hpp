@@ -32,6 +32,10 @@ public:
     TopOpt() {}
     virtual ~TopOpt() {}
 
+    virtual const char *Name() const override { return "TopOpt"; }
+    virtual uint32_t Inputs() const override { return INPUT_BDRY | INPUT_SSP; }
+    virtual uint32_t Outputs() const override { return INPUT_BDRY; }
+
     virtual void Default(bhcParams<O3D> &params) const override
     {
         // SSP (clinear), top bc (vacuum), atten units (dB/wavelength),
@@ -0,0 +1,423 @@
+/*
+bellhopcxx / bellhopcuda - C++/CUDA port of BELLHOP(3D) underwater acoustics simulator
+Copyright (C) 2021-2023 The Regents of the University of California
+Marine Physical Lab at Scripps Oceanography, c/o Jules Jaffe, jjaffe@ucsd.edu
+Based on BELLHOP / BELLHOP3D, which is Copyright (C) 1983-2022 Michael B. Porter
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "trace.hpp"
+
+/*
+Packet ray tracing (CPU, 2D, 1D SSPs only; see bhcInit::rayPackets).
+
+RayPacketWidth rays take each step together: Step() is split into the parts
+which are the same arithmetic for every ray (partials, updating x / t / p / q),
+which are done in structure-of-arrays form over all the rays of the packet so
+that the compiler vectorizes them, and the parts which index the SSP, branch on
+the ray's position (ReduceStep and StepToBdry), or are complex-valued, which
+are done one ray at a time with the normal functions. Everything after the
+step (boundaries, reflection, influence, termination) is the normal per-ray
+code, and when a ray terminates, the next ray is started in its lane.
+
+The operations and their order are exactly those of Step(), so each ray takes
+exactly the same path as when traced alone. Only the order in which the
+contributions of different rays reach the results changes.
+*/
+
+namespace bhc {
+
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__ELF__)
+// LP: Compile the packet step for several instruction sets; the version for the
+// CPU is chosen when the library is loaded. The results are the same for all of
+// them because -ffp-contract=off keeps FMA out (see GenTemplates.cmake).
+#define BHC_PACKET_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define BHC_PACKET_CLONES
+#endif
+
+/**
+ * Number of rays per packet. This is the same for every CPU, so that the order
+ * of the contributions to the results does not depend on the instruction set.
+ * 8 doubles are one AVX-512 or two AVX2 vectors.
+ */
+constexpr int32_t RayPacketWidth = 8;
+
+/**
+ * State of the ray in one lane of a packet; the local variables of
+ * MainFieldModes.
+ */
+struct PacketLane {
+    RayInitInfo rinit;
+    real DistBegTop, DistEndTop, DistBegBot, DistEndBot;
+    SSPSegState iSeg;
+    vec2 xs, gradc;
+    BdryState<false> bds;
+    BdryType Bdry;
+    Origin<false, false> org;
+    rayPt<false> point0, point1, point2;
+    InfluenceRayInfo<false> inflray;
+    int32_t iSmallStepCtr, nSmall, is, Nsteps;
+    bool topRefl, botRefl;
+};
+
+/**
+ * ReduceStep<false> for each ray of a packet. The crossing functions branch on
+ * where each ray is, so this part is done one ray at a time with the normal
+ * functions. The lanes after nAct repeat the last ray and do not report
+ * warnings.
+ */
+inline void ReduceStepPacket(
+    PacketLane *lanes, const int32_t *act, int32_t nAct, const real *x0r,
+    const real *x0z, const real *ur, const real *uz, const SSPSegState *iSeg0,
+    const BeamStructure<false> *Beam, const SSPStructure *ssp, real *h,
+    int32_t *iSmallStepCtr, ErrState *errState)
+{
+    ErrState padErrState;
+    ResetErrState(&padErrState);
+    for(int32_t l = 0; l < RayPacketWidth; ++l) {
+        PacketLane &ln = lanes[act[l < nAct ? l : nAct - 1]];
+        ReduceStep<false>(
+            vec2(x0r[l], x0z[l]), vec2(ur[l], uz[l]), iSeg0[l], ln.bds, Beam, ln.xs,
+            ssp, l < nAct ? errState : &padErrState, h[l], iSmallStepCtr[l]);
+    }
+}
+
+/**
+ * StepToBdry<false> for each ray of a packet, like ReduceStepPacket.
+ */
+inline void StepToBdryPacket(
+    PacketLane *lanes, const int32_t *act, int32_t nAct, const real *x0r,
+    const real *x0z, const real *ur, const real *uz, const SSPSegState *iSeg0,
+    const BeamStructure<false> *Beam, const SSPStructure *ssp, real *x2r, real *x2z,
+    real *h, bool *topRefl, bool *botRefl, ErrState *errState)
+{
+    ErrState padErrState;
+    ResetErrState(&padErrState);
+    for(int32_t l = 0; l < RayPacketWidth; ++l) {
+        PacketLane &ln = lanes[act[l < nAct ? l : nAct - 1]];
+        vec2 x2;
+        int32_t snapDim;
+        StepToBdry<false>(
+            vec2(x0r[l], x0z[l]), x2, vec2(ur[l], uz[l]), h[l], topRefl[l], botRefl[l],
+            snapDim, iSeg0[l], ln.bds, Beam, ln.xs, ssp,
+            l < nAct ? errState : &padErrState);
+        x2r[l] = x2.x;
+        x2z[l] = x2.y;
+    }
+}
+
+/**
+ * Step<CFG, false, false> for the rays in lanes act[0] through act[nAct - 1]:
+ * takes a step from point0 to point1 of each and sets topRefl and botRefl.
+ * If the packet is not full, the remaining lanes of the vectors repeat the
+ * last ray and their results and warnings are discarded.
+ */
+template<typename CFG> BHC_PACKET_CLONES void StepPacket(
+    PacketLane *lanes, const int32_t *act, int32_t nAct,
+    const BeamStructure<false> *Beam, const SSPStructure *ssp, ErrState *errState)
+{
+    constexpr int32_t W = RayPacketWidth;
+    SSPOutputs<false> o0[W], o1[W], o2;
+    SSPSegState iSeg[W], iSeg0[W];
+    int32_t iSmallStepCtr[W];
+    real x0r[W], x0z[W], t0r[W], t0z[W], p0x[W], p0y[W], q0x[W], q0y[W];
+    real c0[W], g0r[W], g0z[W], csq0[W], u0r[W], u0z[W];
+    real pq0px[W], pq0py[W], pq0qx[W], pq0qy[W];
+    real x1r[W], x1z[W], t1r[W], t1z[W], p1x[W], p1y[W], q1x[W], q1y[W];
+    real c1[W], g1r[W], g1z[W], csq1[W], u1r[W], u1z[W];
+    real pq1px[W], pq1py[W], pq1qx[W], pq1qy[W];
+    real x2r[W], x2z[W], t2r[W], t2z[W], p2x[W], p2y[W], q2x[W], q2y[W];
+    real crr[W], crz[W], czz[W];
+    real h[W], halfh[W], w0[W], w1[W], u2r[W], u2z[W], hw0[W], hw1[W];
+    bool topRefl[W], botRefl[W];
+    real deltas = Beam->deltas;
+    ErrState padErrState;
+    ResetErrState(&padErrState);
+
+    // *** Phase 1 (an Euler step)
+
+    for(int32_t l = 0; l < W; ++l) {
+        PacketLane &ln = lanes[act[l < nAct ? l : nAct - 1]];
+        iSeg[l]        = ln.iSeg;
+        EvaluateSSP<CFG, false, false>(
+            ln.point0.x, ln.point0.t, o0[l], ln.org, ssp, iSeg[l],
+            l < nAct ? errState : &padErrState);
+        iSeg0[l]         = iSeg[l]; // make note of current layer
+        iSmallStepCtr[l] = ln.iSmallStepCtr;
+
+        x0r[l] = ln.point0.x.x;
+        x0z[l] = ln.point0.x.y;
+        t0r[l] = ln.point0.t.x;
+        t0z[l] = ln.point0.t.y;
+        p0x[l] = ln.point0.p.x;
+        p0y[l] = ln.point0.p.y;
+        q0x[l] = ln.point0.q.x;
+        q0y[l] = ln.point0.q.y;
+        c0[l]  = o0[l].ccpx.real();
+        g0r[l] = o0[l].gradc.x;
+        g0z[l] = o0[l].gradc.y;
+        crr[l] = o0[l].crr;
+        crz[l] = o0[l].crz;
+        czz[l] = o0[l].czz;
+    }
+
+    for(int32_t l = 0; l < W; ++l) {
+        // Get_c_partials, ComputeDeltaPQ
+        real cnn_csq = crr[l] * SQ(t0z[l]) - FL(2.0) * crz[l] * t0r[l] * t0z[l]
+            + czz[l] * SQ(t0r[l]);
+        pq0px[l] = -cnn_csq * q0x[l];
+        pq0py[l] = -cnn_csq * q0y[l];
+        pq0qx[l] = c0[l] * p0x[l];
+        pq0qy[l] = c0[l] * p0y[l];
+
+        csq0[l] = SQ(c0[l]);
+        u0r[l]  = c0[l] * t0r[l]; // unit tangent
+        u0z[l]  = c0[l] * t0z[l];
+        h[l]    = deltas; // initially set the step h, to the basic one, deltas
+    }
+
+    // reduce h to land on boundary
+    ReduceStepPacket(
+        lanes, act, nAct, x0r, x0z, u0r, u0z, iSeg0, Beam, ssp, h, iSmallStepCtr,
+        errState);
+
+    for(int32_t l = 0; l < W; ++l) {
+        // first step of the modified polygon method is a half step
+        halfh[l] = FL(0.5) * h[l];
+
+        x1r[l] = x0r[l] + halfh[l] * u0r[l];
+        x1z[l] = x0z[l] + halfh[l] * u0z[l];
+        t1r[l] = t0r[l] - halfh[l] * g0r[l] / csq0[l];
+        t1z[l] = t0z[l] - halfh[l] * g0z[l] / csq0[l];
+        p1x[l] = p0x[l] + halfh[l] * pq0px[l];
+        p1y[l] = p0y[l] + halfh[l] * pq0py[l];
+        q1x[l] = q0x[l] + halfh[l] * pq0qx[l];
+        q1y[l] = q0y[l] + halfh[l] * pq0qy[l];
+    }
+
+    // *** Phase 2
+
+    for(int32_t l = 0; l < W; ++l) {
+        PacketLane &ln = lanes[act[l < nAct ? l : nAct - 1]];
+        EvaluateSSP<CFG, false, false>(
+            vec2(x1r[l], x1z[l]), vec2(t1r[l], t1z[l]), o1[l], ln.org, ssp, iSeg[l],
+            l < nAct ? errState : &padErrState);
+        c1[l]  = o1[l].ccpx.real();
+        g1r[l] = o1[l].gradc.x;
+        g1z[l] = o1[l].gradc.y;
+        crr[l] = o1[l].crr;
+        crz[l] = o1[l].crz;
+        czz[l] = o1[l].czz;
+    }
+
+    for(int32_t l = 0; l < W; ++l) {
+        real cnn_csq = crr[l] * SQ(t1z[l]) - FL(2.0) * crz[l] * t1r[l] * t1z[l]
+            + czz[l] * SQ(t1r[l]);
+        pq1px[l] = -cnn_csq * q1x[l];
+        pq1py[l] = -cnn_csq * q1y[l];
+        pq1qx[l] = c1[l] * p1x[l];
+        pq1qy[l] = c1[l] * p1y[l];
+
+        csq1[l] = SQ(c1[l]);
+        u1r[l]  = c1[l] * t1r[l]; // unit tangent
+        u1z[l]  = c1[l] * t1z[l];
+    }
+
+    // reduce h to land on boundary
+    ReduceStepPacket(
+        lanes, act, nAct, x0r, x0z, u1r, u1z, iSeg0, Beam, ssp, h, iSmallStepCtr,
+        errState);
+
+    for(int32_t l = 0; l < W; ++l) {
+        // use blend of f' based on proportion of a full step used.
+        w1[l]  = h[l] / (RL(2.0) * halfh[l]);
+        w0[l]  = RL(1.0) - w1[l];
+        u2r[l] = w0[l] * u0r[l] + w1[l] * u1r[l];
+        u2z[l] = w0[l] * u0z[l] + w1[l] * u1z[l];
+    }
+
+    StepToBdryPacket(
+        lanes, act, nAct, x0r, x0z, u2r, u2z, iSeg0, Beam, ssp, x2r, x2z, h, topRefl,
+        botRefl, errState);
+
+    for(int32_t l = 0; l < W; ++l) {
+        // Update other variables with this new h
+        hw0[l] = h[l] * w0[l];
+        hw1[l] = h[l] * w1[l];
+        t2r[l] = t0r[l] - hw0[l] * g0r[l] / csq0[l] - hw1[l] * g1r[l] / csq1[l];
+        t2z[l] = t0z[l] - hw0[l] * g0z[l] / csq0[l] - hw1[l] * g1z[l] / csq1[l];
+        p2x[l] = p0x[l] + hw0[l] * pq0px[l];
+        p2y[l] = p0y[l] + hw0[l] * pq0py[l];
+        q2x[l] = q0x[l] + hw0[l] * pq0qx[l];
+        q2y[l] = q0y[l] + hw0[l] * pq0qy[l];
+        p2x[l] = p2x[l] + hw1[l] * pq1px[l];
+        p2y[l] = p2y[l] + hw1[l] * pq1py[l];
+        q2x[l] = q2x[l] + hw1[l] * pq1qx[l];
+        q2y[l] = q2y[l] + hw1[l] * pq1qy[l];
+    }
+
+    for(int32_t l = 0; l < nAct; ++l) {
+        PacketLane &ln            = lanes[act[l]];
+        const rayPt<false> &ray0 = ln.point0;
+        rayPt<false> &ray2       = ln.point1;
+        ray2.x                   = vec2(x2r[l], x2z[l]);
+        ray2.t                   = vec2(t2r[l], t2z[l]);
+        ray2.tau                 = ray0.tau + hw0[l] / o0[l].ccpx + hw1[l] / o1[l].ccpx;
+        ray2.p                   = vec2(p2x[l], p2y[l]);
+        ray2.q                   = vec2(q2x[l], q2y[l]);
+
+        ray2.Amp       = ray0.Amp;
+        ray2.Phase     = ray0.Phase;
+        ray2.NumTopBnc = ray0.NumTopBnc;
+        ray2.NumBotBnc = ray0.NumBotBnc;
+
+        // If we crossed an interface, apply jump condition
+
+        EvaluateSSP<CFG, false, false>(ray2.x, ray2.t, o2, ln.org, ssp, iSeg[l], errState);
+        ray2.c = o2.ccpx.real();
+
+        if(iSeg[l].z != iSeg0[l].z || iSeg[l].r != iSeg0[l].r) {
+            vec2 gradcjump = o2.gradc - o0[l].gradc;
+            CurvatureCorrection<false>(ray2, gradcjump, iSeg[l], iSeg0[l]);
+        }
+
+        ln.iSeg          = iSeg[l];
+        ln.iSmallStepCtr = iSmallStepCtr[l];
+        ln.topRefl       = topRefl[l];
+        ln.botRefl       = botRefl[l];
+    }
+}
+
+/**
+ * MainFieldModes for 2D with a 1D SSP, tracing RayPacketWidth rays at a time.
+ * nextRay(rinit) sets rinit to the next ray to trace and returns true, or
+ * returns false when there are no more rays.
+ */
+template<typename CFG, typename NEXTRAY> inline void MainFieldModesPacket(
+    NEXTRAY nextRay, typename CFG::run::FieldT *uAllSources, bool privateField,
+    bool mixedPrecision, const BdryType *ConstBdry, const BdryInfo<false> *bdinfo,
+    const ReflectionInfo *refl, const SSPStructure *ssp, const Position *Pos,
+    const AnglesStructure *Angles, const FreqInfo *freqinfo,
+    const BeamStructure<false> *Beam, const SBPInfo *sbp, EigenInfo *eigen,
+    const ArrInfo *arrinfo, ErrState *errState, RayCounters *counters)
+{
+    static_assert(CFG::ssp::Is1D(), "Packet tracing is only for 1D SSPs");
+    PacketLane lanes[RayPacketWidth];
+    int32_t act[RayPacketWidth]; // lanes with a ray in progress
+    int32_t nAct  = 0;
+    bool moreRays = true;
+
+    // Start the next ray (which is inside the medium) in lane l.
+    auto startRay = [&](PacketLane &ln) {
+        while(moreRays) {
+            if(!nextRay(ln.rinit)) {
+                moreRays = false;
+                break;
+            }
+            if(!RayInit<CFG, false, false>(
+                   ln.rinit, ln.xs, ln.point0, ln.gradc, ln.DistBegTop, ln.DistBegBot,
+                   ln.org, ln.iSeg, ln.bds, ln.Bdry, ConstBdry, bdinfo, ssp, Pos, Angles,
+                   freqinfo, Beam, sbp, true, errState)) {
+                continue;
+            }
+            Init_Influence<CFG, false, false>(
+                ln.inflray, ln.point0, ln.rinit, ln.gradc, Pos, ln.org, ssp, ln.iSeg,
+                Angles, freqinfo->freq0, Beam, errState);
+            ln.inflray.privateField   = privateField;
+            ln.inflray.mixedPrecision = mixedPrecision;
+            ln.point2.c               = NAN;
+            ln.iSmallStepCtr          = 0;
+            ln.nSmall                 = 0;
+            ln.is                     = 0; // index for a step along the ray
+            ln.Nsteps                 = 0;
+            return true;
+        }
+        return false;
+    };
+
+    for(int32_t l = 0; l < RayPacketWidth; ++l) {
+        if(startRay(lanes[l])) act[nAct++] = l;
+    }
+
+    while(nAct > 0) {
+        if(HasErrored(errState)) break;
+        StepPacket<CFG>(lanes, act, nAct, Beam, ssp, errState);
+        for(int32_t a = 0; a < nAct;) {
+            PacketLane &ln = lanes[act[a]];
+            bool twoSteps  = RayUpdateBdry<CFG, false, false>(
+                ln.point1, ln.point2, ln.topRefl, ln.botRefl, ln.DistEndTop,
+                ln.DistEndBot, ln.org, ln.iSeg, ln.bds, ln.Bdry, bdinfo, refl, ssp,
+                freqinfo, Beam, errState);
+            ln.nSmall += ln.iSmallStepCtr > 0 ? 1 : 0;
+            bool done = !Step_Influence<CFG, false, false>(
+                ln.point0, ln.point1, ln.inflray, ln.is, uAllSources, ConstBdry, ln.org,
+                ssp, ln.iSeg, Pos, Beam, eigen, arrinfo, errState);
+            if(!done) {
+                ++ln.is;
+                if(twoSteps) {
+                    done = !Step_Influence<CFG, false, false>(
+                        ln.point1, ln.point2, ln.inflray, ln.is, uAllSources, ConstBdry,
+                        ln.org, ssp, ln.iSeg, Pos, Beam, eigen, arrinfo, errState);
+                    ln.point0 = ln.point2;
+                    ++ln.is;
+                } else {
+                    ln.point0 = ln.point1;
+                }
+            }
+            done = done
+                || RayTerminate<false, false>(
+                       ln.point0, ln.Nsteps, ln.is, ln.xs, ln.iSmallStepCtr,
+                       ln.DistBegTop, ln.DistBegBot, ln.DistEndTop, ln.DistEndBot, MaxN,
+                       ln.org, bdinfo, Beam, errState);
+            if(!done) {
+                ++a;
+                continue;
+            }
+            CountRay<false>(
+                counters, ln.is, ln.nSmall, ln.point0, ln.inflray.numEvals,
+                ln.inflray.numHits);
+            if(startRay(ln)) {
+                ++a;
+            } else {
+                act[a] = act[--nAct];
+            }
+        }
+    }
+}
+
+/**
+ * If packet tracing supports this configuration (2D, 1D SSP), traces the rays
+ * given by nextRay (see MainFieldModesPacket) and returns true; otherwise
+ * returns false without calling nextRay.
+ */
+template<typename CFG, bool O3D, bool R3D, typename NEXTRAY> inline bool TraceFieldPackets(
+    NEXTRAY nextRay, typename CFG::run::FieldT *uAllSources, bool privateField,
+    const bhcParams<O3D> &params, bhcOutputs<O3D, R3D> &outputs, ErrState *errState,
+    RayCounters *counters)
+{
+    if constexpr(!O3D && CFG::ssp::Is1D()) {
+        MainFieldModesPacket<CFG>(
+            nextRay, uAllSources, privateField,
+            GetInternal(params)->precision == Precision::Mixed, params.Bdry,
+            params.bdinfo, params.refl, params.ssp, params.Pos, params.Angles,
+            params.freqinfo, params.Beam, params.sbp, outputs.eigen, outputs.arrinfo,
+            errState, counters);
+        return true;
+    } else {
+        return false;
+    }
+}
+
+} // namespace bhc
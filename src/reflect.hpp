@@ -91,6 +91,56 @@ HOST_DEVICE inline void InterpolateReflectionCoefficient(
     }
 }
 
+/**
+ * LP: The factors of the acousto-elastic halfspace reflection coefficient
+ * which depend only on the halfspace and on the ray slowness along the
+ * boundary Tg. They are scaled by powers of omega so that they do not depend
+ * on the frequency: in 2D, R = -(rho f - i Th g) / (rho f + i Th g), and in
+ * Nx2D/3D, f is gamma2 / omega and g is the halfspace density. These are the
+ * quantities tabulated in HSReflTable.
+ */
+template<bool O3D> HOST_DEVICE inline void HalfspaceFactors(
+    cpx &f, cpx &g, real Tg, const HSInfo &hs)
+{
+    real Tg2 = SQ(Tg);
+    if constexpr(O3D) {
+        f = STD::sqrt(-(RL(1.0) / SQ(hs.cP) - Tg2 - J * REAL_MINPOS));
+        g = hs.rho;
+    } else if(hs.cS.real() > FL(0.0)) {
+        cpx kzS2 = Tg2 - RL(1.0) / SQ(hs.cS);
+        cpx kzP2 = Tg2 - RL(1.0) / SQ(hs.cP);
+        cpx kzS  = STD::sqrt(kzS2);
+        cpx kzP  = STD::sqrt(kzP2);
+        cpx mu   = hs.rho * SQ(hs.cS);
+
+        g = (SQ(kzS2 + Tg2) - RL(4.0) * kzS * kzP * Tg2) * mu;
+        f = kzP * (Tg2 - kzS2);
+    } else {
+        cpx kzP = STD::sqrt(Tg2 - RL(1.0) / SQ(hs.cP));
+        if(kzP.real() == RL(0.0) && kzP.imag() < RL(0.0)) kzP = -kzP;
+        f = kzP;
+        g = hs.rho;
+    }
+}
+
+/**
+ * LP: Linear interpolation of the halfspace reflection coefficient factors
+ * (see HalfspaceFactors) in table iTable. Returns false if Tg is outside the
+ * tabulated range, in which case they must be computed exactly.
+ */
+HOST_DEVICE inline bool InterpolateHalfspaceTable(
+    cpx &f, cpx &g, real Tg, int32_t iTable, const HSReflTable &hst)
+{
+    real x = hst.cRef * STD::abs(Tg) / hst.du;
+    if(!(x < (real)(hst.NPts - 1))) return false;
+    int32_t i  = (int32_t)x;
+    real alpha = x - (real)i;
+    size_t i0  = (size_t)iTable * (size_t)hst.NPts + (size_t)i;
+    f          = hst.f[i0] + alpha * (hst.f[i0 + 1] - hst.f[i0]);
+    g          = hst.g[i0] + alpha * (hst.g[i0 + 1] - hst.g[i0]);
+    return true;
+}
+
 template<bool O3D, bool R3D> HOST_DEVICE inline ReflCurvature<R3D> OceanToRayCurvature(
     const ReflCurvature<O3D> &rcurv, const Origin<O3D, R3D> &org,
     [[maybe_unused]] bool isTop)
@@ -121,11 +171,13 @@ template<bool O3D, bool R3D> HOST_DEVICE inline ReflCurvature<R3D> OceanToRayCur
  * tBdry, nBdry: Tangent and normal to the boundary
  * rcurv: Boundary curvature
  * rtb: Reflection coefficient table
+ * hst: Tabulated halfspace reflection coefficients (if hs.iTable >= 0)
  */
 template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline void Reflect(
     const rayPt<R3D> &oldPoint, rayPt<R3D> &newPoint, const HSInfo &hs, bool isTop,
     VEC23<R3D> tBdry, const VEC23<O3D> &nBdry, const ReflCurvature<O3D> &rcurv, real freq,
-    const ReflectionInfoTopBot &rtb, [[maybe_unused]] const BeamStructure<O3D> *Beam,
+    const ReflectionInfoTopBot &rtb, const HSReflTable &hst,
+    [[maybe_unused]] const BeamStructure<O3D> *Beam,
     const Origin<O3D, R3D> &org, const SSPStructure *ssp, SSPSegState &iSeg,
     ErrState *errState)
 {
@@ -285,7 +337,17 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline void Reflect(
     } else if(hs.bc == 'A' || hs.bc == 'G') { // half-space
         real omega = FL(2.0) * REAL_PI * freq;
         cpx Refl;
-        if constexpr(O3D) {
+        cpx hsf, hsg;
+        if(hs.iTable >= 0 && InterpolateHalfspaceTable(hsf, hsg, Tg, hs.iTable, hst)) {
+            // LP: The tabulated factors are scaled so that omega cancels out.
+            if constexpr(O3D) {
+                cpx gamma1 = STD::sqrt(
+                    -(RL(1.0) / SQ(o.ccpx.real()) - SQ(Tg) - J * REAL_MINPOS));
+                Refl = (hsg * gamma1 - o.rho * hsf) / (hsg * gamma1 + o.rho * hsf);
+            } else {
+                Refl = -(o.rho * hsf - J * Th * hsg) / (o.rho * hsf + J * Th * hsg);
+            }
+        } else if constexpr(O3D) {
             cpx gk = omega * Tg; // wavenumber in direction parallel to bathymetry
             // MINPOS prevents g95 [LP: gfortran] giving -zero, and wrong branch cut
             cpx gamma1Sq = SQ(omega / o.ccpx.real()) - SQ(gk) - J * REAL_MINPOS;
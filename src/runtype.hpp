@@ -24,9 +24,15 @@ this program. If not, see <https://www.gnu.org/licenses/>.
 
 namespace bhc {
 
+/**
+ * LP: 'C' is used for all TL runs, except that incoherent and semi-coherent runs
+ * with bhcInit::realTLField use 'I', whose field holds real intensities (float,
+ * bhcOutputs::uAllSourcesReal) instead of complex pressure.
+ */
 template<char RT> struct RunType {
     static constexpr bool IsRay() { return RT == 'R'; }
-    static constexpr bool IsTL() { return RT == 'C' /*|| RT == 'S' || RT == 'I'*/; }
+    static constexpr bool IsTL() { return RT == 'C' || RT == 'I'; }
+    static constexpr bool IsRealFieldTL() { return RT == 'I'; }
     static constexpr bool IsEigenrays() { return RT == 'E'; }
     static constexpr bool IsArrivals() { return RT == 'A' /*|| RT == 'a'*/; }
     /*
@@ -38,6 +44,9 @@ template<char RT> struct RunType {
     static_assert(
         IsRay() || IsTL() || IsEigenrays() || IsArrivals(),
         "RunType templated with invalid character!");
+
+    // Element type of the TL field the influence functions add into
+    using FieldT = typename std::conditional<IsRealFieldTL(), float, cpxf>::type;
 };
 
 template<char IT> struct InflType {
@@ -126,6 +135,17 @@ template<bool O3D> HOST_DEVICE inline bool IsSemiCoherentRun(
     return r == 'S';
 }
 
+/**
+ * LP: Incoherent and semi-coherent TL runs sum real intensities, so with
+ * bhcInit::realTLField their field is stored as float
+ * (bhcOutputs::uAllSourcesReal) instead of cpxf; see UsesRealField.
+ */
+template<bool O3D> HOST_DEVICE inline bool IsRealFieldRun(const BeamStructure<O3D> *Beam)
+{
+    char r = Beam->RunType[0];
+    return r == 'S' || r == 'I';
+}
+
 // Beam->Type[0] is
 //   'G', '^', or ' ' Geometric hat beams in Cartesian coordinates
 //   'g' Geometric hat beams in ray-centered coordinates
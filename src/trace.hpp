@@ -66,6 +66,43 @@ template<typename CFG, bool O3D> HOST_DEVICE inline SSPOutputs<O3D> RayStartNomi
     return o;
 }
 
+/**
+ * Lloyd mirror pattern for the semi-coherent option: amplitude factor for the
+ * interference of the source with its image in the surface.
+ */
+template<bool O3D> HOST_DEVICE inline real LloydMirrorFactor(
+    real freq, real c, const VEC23<O3D> &xs, real alpha)
+{
+    float omega = FL(2.0) * REAL_PI * freq;
+    return STD::sqrt(FL(2.0)) * STD::abs(STD::sin(omega / c * DEP(xs) * STD::sin(alpha)));
+}
+
+/**
+ * Are there enough beams? (2D only.) c is the sound speed at the source.
+ * LP: Pulled out of RayInit, as this is the only part of it which depends on
+ * the receivers (see RayCache).
+ */
+template<bool O3D> HOST_DEVICE inline void CheckEnoughBeams(
+    const RayInitInfo &rinit, real c, const Position *Pos, const AnglesStructure *Angles,
+    const FreqInfo *freqinfo, const BeamStructure<O3D> *Beam, ErrState *errState)
+{
+    if constexpr(!O3D) {
+        real DalphaOpt
+            = STD::sqrt(c / (FL(6.0) * freqinfo->freq0 * Pos->Rr[Pos->NRr - 1]));
+        int32_t NalphaOpt = 2
+            + (int)((Angles->alpha.angles[Angles->alpha.n - 1] - Angles->alpha.angles[0])
+                    / DalphaOpt);
+
+        if(IsCoherentRun(Beam) && Angles->alpha.n < NalphaOpt && rinit.ialpha == 0) {
+            RunWarning(errState, BHC_WARN_TOO_FEW_BEAMS);
+            // printf(
+            //     "Warning in " BHC_PROGRAMNAME
+            //     " : Too few beams\nNalpha should be at least = %d\n",
+            //     NalphaOpt);
+        }
+    }
+}
+
 /**
  * LP: Pulled out ray update loop initialization. Returns whether to continue
  * with the ray trace. Only call for valid ialpha w.r.t. Angles->iSingleAlpha.
@@ -79,7 +116,8 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline bool RayInit(
     BdryState<O3D> &bds, BdryType &Bdry, const BdryType *ConstBdry,
     const BdryInfo<O3D> *bdinfo, const SSPStructure *ssp, const Position *Pos,
     const AnglesStructure *Angles, const FreqInfo *freqinfo,
-    const BeamStructure<O3D> *Beam, const SBPInfo *sbp, ErrState *errState)
+    const BeamStructure<O3D> *Beam, const SBPInfo *sbp, bool lloydMirror,
+    ErrState *errState)
 {
     if(rinit.isz < 0 || rinit.isz >= Pos->NSz || rinit.ialpha < 0
        || rinit.ialpha >= Angles->alpha.n
@@ -116,22 +154,7 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline bool RayInit(
         org.tradial = vec2(STD::cos(rinit.beta), STD::sin(rinit.beta));
     }
 
-    if constexpr(!O3D) {
-        // Are there enough beams?
-        real DalphaOpt = STD::sqrt(
-            o.ccpx.real() / (FL(6.0) * freqinfo->freq0 * Pos->Rr[Pos->NRr - 1]));
-        int32_t NalphaOpt = 2
-            + (int)((Angles->alpha.angles[Angles->alpha.n - 1] - Angles->alpha.angles[0])
-                    / DalphaOpt);
-
-        if(IsCoherentRun(Beam) && Angles->alpha.n < NalphaOpt && rinit.ialpha == 0) {
-            RunWarning(errState, BHC_WARN_TOO_FEW_BEAMS);
-            // printf(
-            //     "Warning in " BHC_PROGRAMNAME
-            //     " : Too few beams\nNalpha should be at least = %d\n",
-            //     NalphaOpt);
-        }
-    }
+    CheckEnoughBeams<O3D>(rinit, o.ccpx.real(), Pos, Angles, freqinfo, Beam, errState);
 
     int32_t ibp = BinarySearchLEQ(sbp->SrcBmPat, sbp->NSBPPts, 2, 0, rinit.SrcDeclAngle);
     // LP: Our function won't ever go outside the table, but we need to limit it
@@ -145,10 +168,9 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline bool RayInit(
         + s * sbp->SrcBmPat[2 * (ibp + 1) + 1]; // initial amplitude
 
     // Lloyd mirror pattern for semi-coherent option
-    if(IsSemiCoherentRun(Beam)) {
-        float omega = FL(2.0) * REAL_PI * freqinfo->freq0;
-        Amp0 *= STD::sqrt(FL(2.0))
-            * STD::abs(STD::sin(omega / o.ccpx.real() * DEP(xs) * STD::sin(rinit.alpha)));
+    // LP: Frequency dependent, so broadband runs apply it per frequency instead.
+    if(IsSemiCoherentRun(Beam) && lloydMirror) {
+        Amp0 *= LloydMirrorFactor<O3D>(freqinfo->freq0, o.ccpx.real(), xs, rinit.alpha);
     }
 
     // LP: This part from TraceRay
@@ -266,29 +288,19 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline bool RayInit(
 }
 
 /**
- * LP: Pulled out contents of ray update loop. Returns the number of ray steps
- * taken (i.e. normally 1, or 2 if reflected).
+ * Second half of RayUpdate, after the step to point1: updates the boundary
+ * segments and distances, and reflects the ray into point2 if the step ended
+ * on the top or bottom (topRefl / botRefl from Step).
  *
  * Returns whether reflection happened and therefore a second step was taken.
  */
-template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline bool RayUpdate(
-    const rayPt<R3D> &point0, rayPt<R3D> &point1, rayPt<R3D> &point2, real &DistEndTop,
-    real &DistEndBot, int32_t &iSmallStepCtr, const Origin<O3D, R3D> &org,
-    SSPSegState &iSeg, BdryState<O3D> &bds, BdryType &Bdry, const BdryInfo<O3D> *bdinfo,
+template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline bool RayUpdateBdry(
+    rayPt<R3D> &point1, rayPt<R3D> &point2, bool topRefl, bool botRefl,
+    real &DistEndTop, real &DistEndBot, const Origin<O3D, R3D> &org, SSPSegState &iSeg,
+    BdryState<O3D> &bds, BdryType &Bdry, const BdryInfo<O3D> *bdinfo,
     const ReflectionInfo *refl, const SSPStructure *ssp, const FreqInfo *freqinfo,
-    const BeamStructure<O3D> *Beam, const VEC23<O3D> &xs, ErrState *errState)
+    const BeamStructure<O3D> *Beam, ErrState *errState)
 {
-    bool topRefl, botRefl;
-    Step<CFG, O3D, R3D>(
-        point0, point1, bds, Beam, xs, org, ssp, iSeg, errState, iSmallStepCtr, topRefl,
-        botRefl);
-    /*
-    if(point0.x == point1.x){
-        printf("Ray did not move from (%g,%g), bailing\n", point0.x.x, point0.x.y);
-        bail();
-    }
-    */
-
     VEC23<O3D> x_o = RayToOceanX(point1.x, org);
     VEC23<O3D> t_o = RayToOceanT(point1.t, org);
     GetBdrySeg<O3D>(x_o, t_o, bds.top, &bdinfo->top, Bdry.Top, true, false, errState);
@@ -324,24 +336,40 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline bool RayUpdate(
                 real m1 = FL(1.0) - s1;
                 real m2 = FL(1.0) - s2;
 
-                BdryPtFull<true> *bd00
-                    = &bdi.bd[(bdstb.Iseg.x) * bdi.NPts.y + bdstb.Iseg.y];
-                BdryPtFull<true> *bd01
-                    = &bdi.bd[(bdstb.Iseg.x) * bdi.NPts.y + bdstb.Iseg.y + 1];
-                BdryPtFull<true> *bd10
-                    = &bdi.bd[(bdstb.Iseg.x + 1) * bdi.NPts.y + bdstb.Iseg.y];
-                BdryPtFull<true> *bd11
-                    = &bdi.bd[(bdstb.Iseg.x + 1) * bdi.NPts.y + bdstb.Iseg.y + 1];
-
-                nInt = bd00->Noden * m1 * m2 + bd10->Noden * s1 * m2
-                    + bd11->Noden * s1 * s2 + bd01->Noden * m1 * s2;
-                rcurv.z_xx = bd00->z_xx;
-                rcurv.z_xy = bd00->z_xy;
-                rcurv.z_yy = bd00->z_yy;
-
-                rcurv.kappa_xx = bd00->kappa_xx;
-                rcurv.kappa_xy = bd00->kappa_xy;
-                rcurv.kappa_yy = bd00->kappa_yy;
+                if(bdi.bd == nullptr) {
+                    // LP: Compact boundary, compute the node normals and the
+                    // curvature of this rectangle here.
+                    int32_t ix  = bdstb.Iseg.x;
+                    int32_t iy  = bdstb.Iseg.y;
+                    vec3 n00    = BdryNodeNormalUnscaled(&bdi, ix, iy);
+                    vec3 n01    = BdryNodeNormalUnscaled(&bdi, ix, iy + 1);
+                    vec3 n10    = BdryNodeNormalUnscaled(&bdi, ix + 1, iy);
+                    vec3 n11    = BdryNodeNormalUnscaled(&bdi, ix + 1, iy + 1);
+                    nInt        = (n00 / glm::length(n00)) * m1 * m2
+                        + (n10 / glm::length(n10)) * s1 * m2
+                        + (n11 / glm::length(n11)) * s1 * s2
+                        + (n01 / glm::length(n01)) * m1 * s2;
+                    BdryCellCurvature(&bdi, ix, iy, rcurv);
+                } else {
+                    BdryPtFull<true> *bd00
+                        = &bdi.bd[(bdstb.Iseg.x) * bdi.NPts.y + bdstb.Iseg.y];
+                    BdryPtFull<true> *bd01
+                        = &bdi.bd[(bdstb.Iseg.x) * bdi.NPts.y + bdstb.Iseg.y + 1];
+                    BdryPtFull<true> *bd10
+                        = &bdi.bd[(bdstb.Iseg.x + 1) * bdi.NPts.y + bdstb.Iseg.y];
+                    BdryPtFull<true> *bd11
+                        = &bdi.bd[(bdstb.Iseg.x + 1) * bdi.NPts.y + bdstb.Iseg.y + 1];
+
+                    nInt = bd00->Noden * m1 * m2 + bd10->Noden * s1 * m2
+                        + bd11->Noden * s1 * s2 + bd01->Noden * m1 * s2;
+                    rcurv.z_xx = bd00->z_xx;
+                    rcurv.z_xy = bd00->z_xy;
+                    rcurv.z_yy = bd00->z_yy;
+
+                    rcurv.kappa_xx = bd00->kappa_xx;
+                    rcurv.kappa_xy = bd00->kappa_xy;
+                    rcurv.kappa_yy = bd00->kappa_yy;
+                }
             } else {
                 nInt       = bdstb.n;
                 rcurv.z_xx = rcurv.z_xy = rcurv.z_yy = FL(0.0);
@@ -368,8 +396,8 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline bool RayUpdate(
         }
 
         Reflect<CFG, O3D, R3D>(
-            point1, point2, hs, topRefl, tInt, nInt, rcurv, freqinfo->freq0, refltb, Beam,
-            org, ssp, iSeg, errState);
+            point1, point2, hs, topRefl, tInt, nInt, rcurv, freqinfo->freq0, refltb,
+            refl->hs, Beam, org, ssp, iSeg, errState);
         // Incrementing bounce count moved to Reflect
         x_o = RayToOceanX(point2.x, org);
         Distances<O3D>(
@@ -380,6 +408,34 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline bool RayUpdate(
     return false;
 }
 
+/**
+ * LP: Pulled out contents of ray update loop. Returns the number of ray steps
+ * taken (i.e. normally 1, or 2 if reflected).
+ *
+ * Returns whether reflection happened and therefore a second step was taken.
+ */
+template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline bool RayUpdate(
+    const rayPt<R3D> &point0, rayPt<R3D> &point1, rayPt<R3D> &point2, real &DistEndTop,
+    real &DistEndBot, int32_t &iSmallStepCtr, const Origin<O3D, R3D> &org,
+    SSPSegState &iSeg, BdryState<O3D> &bds, BdryType &Bdry, const BdryInfo<O3D> *bdinfo,
+    const ReflectionInfo *refl, const SSPStructure *ssp, const FreqInfo *freqinfo,
+    const BeamStructure<O3D> *Beam, const VEC23<O3D> &xs, ErrState *errState)
+{
+    bool topRefl, botRefl;
+    Step<CFG, O3D, R3D>(
+        point0, point1, bds, Beam, xs, org, ssp, iSeg, errState, iSmallStepCtr, topRefl,
+        botRefl);
+    /*
+    if(point0.x == point1.x){
+        printf("Ray did not move from (%g,%g), bailing\n", point0.x.x, point0.x.y);
+        bail();
+    }
+    */
+    return RayUpdateBdry<CFG, O3D, R3D>(
+        point1, point2, topRefl, botRefl, DistEndTop, DistEndBot, org, iSeg, bds, Bdry,
+        bdinfo, refl, ssp, freqinfo, Beam, errState);
+}
+
 /**
  * Has the ray left the box, lost its energy, escaped the boundaries, or
  * exceeded storage limit?
@@ -404,14 +460,14 @@ template<bool O3D, bool R3D> HOST_DEVICE inline bool RayTerminate(
         leftbox = IsOutsideBeamBoxDim<true, 0>(x_o, Beam, xs)
             || IsOutsideBeamBoxDim<true, 1>(x_o, Beam, xs)
             || IsOutsideBeamBoxDim<true, 2>(x_o, Beam, xs);
-        real minx = bhc::max(bdinfo->bot.bd[0].x.x, bdinfo->top.bd[0].x.x);
-        real miny = bhc::max(bdinfo->bot.bd[0].x.y, bdinfo->top.bd[0].x.y);
+        real minx = bhc::max(BdryGridX(&bdinfo->bot, 0), BdryGridX(&bdinfo->top, 0));
+        real miny = bhc::max(BdryGridY(&bdinfo->bot, 0), BdryGridY(&bdinfo->top, 0));
         real maxx = bhc::min(
-            bdinfo->bot.bd[(bdinfo->bot.NPts.x - 1) * bdinfo->bot.NPts.y].x.x,
-            bdinfo->top.bd[(bdinfo->top.NPts.x - 1) * bdinfo->top.NPts.y].x.x);
+            BdryGridX(&bdinfo->bot, bdinfo->bot.NPts.x - 1),
+            BdryGridX(&bdinfo->top, bdinfo->top.NPts.x - 1));
         real maxy = bhc::min(
-            bdinfo->bot.bd[bdinfo->bot.NPts.y - 1].x.y,
-            bdinfo->top.bd[bdinfo->top.NPts.y - 1].x.y);
+            BdryGridY(&bdinfo->bot, bdinfo->bot.NPts.y - 1),
+            BdryGridY(&bdinfo->top, bdinfo->top.NPts.y - 1));
         bool escaped0bdry, escapedNbdry;
         escaped0bdry = x_o.x < minx || x_o.y < miny;
         escapedNbdry = x_o.x > maxx || x_o.y > maxy;
@@ -476,6 +532,24 @@ template<bool O3D, bool R3D> HOST_DEVICE inline bool RayTerminate(
     return false;
 }
 
+/**
+ * Adds the work done for one ray to the worker's counters for RunMetrics, if
+ * counters is not null. nSmall is the number of steps for which the small step
+ * counter was incremented.
+ */
+template<bool R3D> HOST_DEVICE inline void CountRay(
+    RayCounters *counters, int32_t Nsteps, int32_t nSmall, const rayPt<R3D> &point,
+    int64_t numEvals, int64_t numHits)
+{
+    if(counters == nullptr) return;
+    ++counters->rays;
+    counters->steps += Nsteps;
+    counters->reflections += point.NumTopBnc + point.NumBotBnc;
+    counters->smallSteps += nSmall;
+    counters->influenceEvals += numEvals;
+    counters->receiverHits += numHits;
+}
+
 /**
  * Main ray tracing function for ray path output mode.
  */
@@ -484,7 +558,8 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline void MainRayMode(
     Origin<O3D, R3D> &org, const BdryType *ConstBdry, const BdryInfo<O3D> *bdinfo,
     const ReflectionInfo *refl, const SSPStructure *ssp, const Position *Pos,
     const AnglesStructure *Angles, const FreqInfo *freqinfo,
-    const BeamStructure<O3D> *Beam, const SBPInfo *sbp, ErrState *errState)
+    const BeamStructure<O3D> *Beam, const SBPInfo *sbp, ErrState *errState,
+    RayCounters *counters = nullptr)
 {
     real DistBegTop, DistEndTop, DistBegBot, DistEndBot;
     SSPSegState iSeg;
@@ -494,12 +569,13 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline void MainRayMode(
 
     if(!RayInit<CFG, O3D, R3D>(
            rinit, xs, ray[0], gradc, DistBegTop, DistBegBot, org, iSeg, bds, Bdry,
-           ConstBdry, bdinfo, ssp, Pos, Angles, freqinfo, Beam, sbp, errState)) {
+           ConstBdry, bdinfo, ssp, Pos, Angles, freqinfo, Beam, sbp, true, errState)) {
         Nsteps = 1;
         return;
     }
 
     int32_t iSmallStepCtr = 0;
+    int32_t nSmall        = 0;
     int32_t is            = 0; // index for a step along the ray
 
     while(true) {
@@ -507,6 +583,7 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline void MainRayMode(
         bool twoSteps = RayUpdate<CFG, O3D, R3D>(
             ray[is], ray[is + 1], ray[is + 2], DistEndTop, DistEndBot, iSmallStepCtr, org,
             iSeg, bds, Bdry, bdinfo, refl, ssp, freqinfo, Beam, xs, errState);
+        nSmall += iSmallStepCtr > 0 ? 1 : 0;
         if(Nsteps >= 0 && is >= Nsteps) {
             Nsteps = is + 2;
             break;
@@ -517,17 +594,19 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline void MainRayMode(
                DistEndBot, MaxPointsPerRay, org, bdinfo, Beam, errState))
             break;
     }
+    CountRay<R3D>(counters, is, nSmall, ray[is], 0, 0);
 }
 
 /**
  * Main ray tracing function for TL, eigen, and arrivals runs.
  */
 template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline void MainFieldModes(
-    RayInitInfo &rinit, cpxf *uAllSources, const BdryType *ConstBdry,
-    const BdryInfo<O3D> *bdinfo, const ReflectionInfo *refl, const SSPStructure *ssp,
-    const Position *Pos, const AnglesStructure *Angles, const FreqInfo *freqinfo,
+    RayInitInfo &rinit, typename CFG::run::FieldT *uAllSources, bool privateField,
+    bool mixedPrecision, const BdryType *ConstBdry, const BdryInfo<O3D> *bdinfo,
+    const ReflectionInfo *refl, const SSPStructure *ssp, const Position *Pos,
+    const AnglesStructure *Angles, const FreqInfo *freqinfo,
     const BeamStructure<O3D> *Beam, const SBPInfo *sbp, EigenInfo *eigen,
-    const ArrInfo *arrinfo, ErrState *errState)
+    const ArrInfo *arrinfo, ErrState *errState, RayCounters *counters = nullptr)
 {
     real DistBegTop, DistEndTop, DistBegBot, DistEndBot;
     SSPSegState iSeg;
@@ -543,15 +622,18 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline void MainFieldMode
 
     if(!RayInit<CFG, O3D, R3D>(
            rinit, xs, point0, gradc, DistBegTop, DistBegBot, org, iSeg, bds, Bdry,
-           ConstBdry, bdinfo, ssp, Pos, Angles, freqinfo, Beam, sbp, errState)) {
+           ConstBdry, bdinfo, ssp, Pos, Angles, freqinfo, Beam, sbp, true, errState)) {
         return;
     }
 
     Init_Influence<CFG, O3D, R3D>(
-        inflray, point0, rinit, gradc, Pos, org, ssp, iSeg, Angles, freqinfo, Beam,
+        inflray, point0, rinit, gradc, Pos, org, ssp, iSeg, Angles, freqinfo->freq0, Beam,
         errState);
+    inflray.privateField   = privateField;
+    inflray.mixedPrecision = mixedPrecision;
 
     int32_t iSmallStepCtr = 0;
+    int32_t nSmall        = 0;
     int32_t is            = 0; // index for a step along the ray
     int32_t Nsteps        = 0; // not actually needed in TL mode, debugging only
 
@@ -560,6 +642,7 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline void MainFieldMode
         bool twoSteps = RayUpdate<CFG, O3D, R3D>(
             point0, point1, point2, DistEndTop, DistEndBot, iSmallStepCtr, org, iSeg, bds,
             Bdry, bdinfo, refl, ssp, freqinfo, Beam, xs, errState);
+        nSmall += iSmallStepCtr > 0 ? 1 : 0;
         if(!Step_Influence<CFG, O3D, R3D>(
                point0, point1, inflray, is, uAllSources, ConstBdry, org, ssp, iSeg, Pos,
                Beam, eigen, arrinfo, errState)) {
@@ -586,6 +669,103 @@ template<typename CFG, bool O3D, bool R3D> HOST_DEVICE inline void MainFieldMode
     }
 
     // printf("Nsteps %d\n", Nsteps);
+    CountRay<R3D>(counters, is, nSmall, point0, inflray.numEvals, inflray.numHits);
+}
+
+/**
+ * Ray tracing function for broadband TL runs. The ray path does not depend on
+ * frequency, so each ray is traced once and every step is applied through the
+ * influence functions for frequencies ifreq0 .. ifreq0 + nfreq - 1, each with
+ * its own beam state inflrays[f] and field uAllSources + ifreq * fieldSize.
+ * Frequency-dependent boundary reflection and volume attenuation along the
+ * path are evaluated at freq0, as for arrivals runs.
+ */
+template<typename CFG, bool O3D, bool R3D>
+HOST_DEVICE inline void MainFieldModesBroadband(
+    RayInitInfo &rinit, typename CFG::run::FieldT *uAllSources, size_t fieldSize,
+    bool privateField, bool mixedPrecision, int32_t ifreq0, int32_t nfreq,
+    InfluenceRayInfo<R3D> *inflrays, const BdryType *ConstBdry,
+    const BdryInfo<O3D> *bdinfo, const ReflectionInfo *refl, const SSPStructure *ssp,
+    const Position *Pos, const AnglesStructure *Angles, const FreqInfo *freqinfo,
+    const BeamStructure<O3D> *Beam, const SBPInfo *sbp, ErrState *errState,
+    RayCounters *counters = nullptr)
+{
+    real DistBegTop, DistEndTop, DistBegBot, DistEndBot;
+    SSPSegState iSeg;
+    VEC23<O3D> xs, gradc;
+    BdryState<O3D> bds;
+    BdryType Bdry;
+    Origin<O3D, R3D> org;
+
+    rayPt<R3D> point0, point1, point2;
+    point2.c = NAN; // Silence incorrect g++ warning about maybe uninitialized
+
+    if(!RayInit<CFG, O3D, R3D>(
+           rinit, xs, point0, gradc, DistBegTop, DistBegBot, org, iSeg, bds, Bdry,
+           ConstBdry, bdinfo, ssp, Pos, Angles, freqinfo, Beam, sbp, false, errState)) {
+        return;
+    }
+
+    for(int32_t f = 0; f < nfreq; ++f) {
+        real freq = freqinfo->freqVec[ifreq0 + f];
+        Init_Influence<CFG, O3D, R3D>(
+            inflrays[f], point0, rinit, gradc, Pos, org, ssp, iSeg, Angles, freq, Beam,
+            errState);
+        inflrays[f].privateField   = privateField;
+        inflrays[f].mixedPrecision = mixedPrecision;
+        if(IsSemiCoherentRun(Beam)) {
+            inflrays[f].Ratio1 *= LloydMirrorFactor<O3D>(
+                freq, point0.c, xs, rinit.alpha);
+        }
+    }
+
+    int32_t iSmallStepCtr = 0;
+    int32_t nSmall        = 0;
+    int32_t is            = 0; // index for a step along the ray
+    int32_t Nsteps        = 0; // not actually needed in TL mode, debugging only
+
+    // The conditions under which Step_Influence terminates the ray depend only
+    // on the ray path and receivers, so they are the same for all frequencies.
+    while(true) {
+        if(HasErrored(errState)) break;
+        bool twoSteps = RayUpdate<CFG, O3D, R3D>(
+            point0, point1, point2, DistEndTop, DistEndBot, iSmallStepCtr, org, iSeg, bds,
+            Bdry, bdinfo, refl, ssp, freqinfo, Beam, xs, errState);
+        nSmall += iSmallStepCtr > 0 ? 1 : 0;
+        bool cont = true;
+        for(int32_t f = 0; f < nfreq; ++f) {
+            cont &= Step_Influence<CFG, O3D, R3D>(
+                point0, point1, inflrays[f], is,
+                uAllSources + (size_t)(ifreq0 + f) * fieldSize, ConstBdry, org, ssp, iSeg,
+                Pos, Beam, nullptr, nullptr, errState);
+        }
+        if(!cont) break;
+        ++is;
+        if(twoSteps) {
+            for(int32_t f = 0; f < nfreq; ++f) {
+                cont &= Step_Influence<CFG, O3D, R3D>(
+                    point1, point2, inflrays[f], is,
+                    uAllSources + (size_t)(ifreq0 + f) * fieldSize, ConstBdry, org, ssp,
+                    iSeg, Pos, Beam, nullptr, nullptr, errState);
+            }
+            if(!cont) break;
+            point0 = point2;
+            ++is;
+        } else {
+            point0 = point1;
+        }
+        if(RayTerminate<O3D, R3D>(
+               point0, Nsteps, is, xs, iSmallStepCtr, DistBegTop, DistBegBot, DistEndTop,
+               DistEndBot, MaxN, org, bdinfo, Beam, errState))
+            break;
+    }
+
+    int64_t numEvals = 0, numHits = 0;
+    for(int32_t f = 0; f < nfreq; ++f) {
+        numEvals += inflrays[f].numEvals;
+        numHits += inflrays[f].numHits;
+    }
+    CountRay<R3D>(counters, is, nSmall, point0, numEvals, numHits);
 }
 
 } // namespace bhc
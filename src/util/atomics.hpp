@@ -158,4 +158,17 @@ template<typename INT> HOST_DEVICE inline INT AtomicFetchAdd(INT *ptr, INT val)
 #endif
 }
 
+template<typename INT> HOST_DEVICE inline INT AtomicExchange(INT *ptr, INT val)
+{
+#ifdef __CUDA_ARCH__
+    return atomicExch(ptr, val);
+#elif defined(__GNUC__)
+    return __atomic_exchange_n(ptr, val, __ATOMIC_RELAXED);
+#elif defined(_MSC_VER)
+    return InterlockedExchange((LONG *)ptr, (LONG)val);
+#else
+#error "Unrecognized compiler for atomic intrinsics!"
+#endif
+}
+
 } // namespace bhc
@@ -57,8 +57,23 @@ public:
         ostr.open(path, std::ios::binary);
     }
 
+    /**
+     * Opens an existing file to overwrite some of its records, without
+     * truncating it. Several DirectOFiles may do this at once for the same
+     * file, e.g. from different threads, if they write different records.
+     */
+    void openexisting(const std::string &path, size_t LRecl)
+    {
+        recl = LRecl;
+        // Nothing to pad at the end
+        bytesWrittenHighestRecord = recl;
+        ostr.open(path, std::ios::binary | std::ios::in | std::ios::out);
+    }
+
     bool good() { return ostr.good() && ostr.is_open(); }
 
+    size_t reclen() const { return recl; }
+
     void rec(size_t r)
     {
         if(r >= highestRecord) {
@@ -88,6 +103,23 @@ public:
         write(file, fline, &v, sizeof(T));
     }
 
+    /**
+     * Writes n whole records starting at record r in one operation. data must
+     * be n * recl bytes.
+     */
+    void writerecords(size_t r, const void *data, size_t n)
+    {
+        if(n == 0) return;
+        ostr.seekp(r * recl);
+        ostr.write((const char *)data, n * recl);
+        record                 = r + n - 1;
+        bytesWrittenThisRecord = recl;
+        if(record >= highestRecord) {
+            highestRecord             = record;
+            bytesWrittenHighestRecord = recl;
+        }
+    }
+
 private:
     bhcInternal *_internal;
     std::ofstream ostr;
@@ -182,6 +214,29 @@ public:
         read(file, fline, &v, sizeof(T));
     }
 
+    size_t reclen() const { return recl; }
+    size_t numrecords() const { return fileLen / recl; }
+
+#define DIFREADRECS(d, r, data, n) d.readrecords(__FILE__, __LINE__, r, data, n)
+    /**
+     * Reads n whole records starting at record r in one operation. data must
+     * have room for n * recl bytes.
+     */
+    void readrecords(const char *file, int fline, size_t r, void *data, size_t n)
+    {
+        if((r + n) * recl > fileLen) {
+            ExternalError(
+                _internal,
+                "%s:%d: DirectIFile records %" PRIuMAX " to %" PRIuMAX
+                " out of bounds, record length is %" PRIuMAX ", file length is %" PRIuMAX,
+                file, fline, r, r + n, recl, fileLen);
+        }
+        record = r + n - 1;
+        istr.seekg(r * recl);
+        istr.read((char *)data, n * recl);
+        bytesReadThisRecord = recl;
+    }
+
 #define DIFSKIP(d, bytes) d.skip(__FILE__, __LINE__, bytes)
     void skip(const char *file, int fline, size_t bytes)
     {
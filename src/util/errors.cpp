@@ -71,8 +71,8 @@ static const char *const errorDescriptions[BHC_ERR_MAX] = {
 };
 
 static const char *const warningDescriptions[BHC_WARN_MAX] = {
-    "BHC_WARN_RAYS_OUTOFMEMORY: Ran out of memory for rays (in ray copy mode); "
-    "subsequent rays will be discarded",
+    "BHC_WARN_RAYS_OUTOFMEMORY: Ran out of memory for rays (in ray copy or compact "
+    "mode); subsequent rays will be discarded",
     "BHC_WARN_ONERAY_OUTOFMEMORY: Ran out of memory for individual ray(s), "
     "those rays have been truncated",
     "BHC_WARN_UNBOUNDED_BEAM: Cerveny beam has imaginary component of gamma > 0",
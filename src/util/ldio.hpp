@@ -410,6 +410,61 @@ private:
     static constexpr const char *const nullitem = "\"'";
 };
 
+/**
+ * Formats a real the way FORTRAN list-directed output does (see LDOFile,
+ * FORTRAN_OUTPUT style), appending to s. width is 15 for float and 24 for
+ * double (exp3). This uses snprintf instead of stream manipulators, so it is
+ * much faster and can be used from any thread to format output in parallel.
+ */
+inline void AppendFortranReal(std::string &s, double r, int32_t width, bool exp3)
+{
+    char buf[64];
+    char *p = buf;
+    *p++    = ' ';
+    *p++    = ' ';
+    size_t remain = sizeof(buf) - 2;
+    if(!std::isfinite(r)) {
+        p += snprintf(p, remain, "%-*g", width, r);
+        s.append(buf, p - buf);
+        return;
+    }
+    bool sci = r != RL(0.0) && (std::abs(r) < RL(0.1) || std::abs(r) >= RL(1.0e6));
+    int32_t w = width;
+    if(r < RL(0.0)) {
+        *p++ = '-';
+        r    = -r;
+    } else if(sci || r >= RL(1.0) || r == RL(0.0)) {
+        *p++ = ' ';
+    }
+    --w;
+    if(sci) --w;
+    int32_t prec = exp3 ? (w - 6) : (w - 5); // 5/4 for exp, 1 for decimal point
+    remain       = sizeof(buf) - (p - buf);
+    if(sci) {
+        p += snprintf(p, remain, "%-*.*E", exp3 ? (w + 1) : w, prec, r);
+    } else {
+        p += snprintf(p, remain, "%#*.*g%s", w - 5, prec, r, exp3 ? "     " : "    ");
+    }
+    s.append(buf, p - buf);
+}
+
+/**
+ * Formats an integer the way FORTRAN list-directed output does, appending to s.
+ */
+inline void AppendFortranInt(std::string &s, int32_t i, int32_t width = 12)
+{
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), "%*d", width, i);
+    s.append(buf, n);
+}
+
+/**
+ * Same as LDOFile::operator<< with the default widths.
+ */
+inline void AppendFortran(std::string &s, int32_t i) { AppendFortranInt(s, i); }
+inline void AppendFortran(std::string &s, float r) { AppendFortranReal(s, r, 15, false); }
+inline void AppendFortran(std::string &s, double r) { AppendFortranReal(s, r, 24, true); }
+
 class LDOFile {
 public:
     enum class Style : uint8_t { FORTRAN_OUTPUT, WRITTEN_BY_HAND, MATLAB_OUTPUT };
@@ -509,6 +564,7 @@ public:
     }
 
     void write(const char *s) { ostr << s; }
+    void write(const std::string &s) { ostr.write(s.data(), s.size()); }
 
 private:
     std::ofstream ostr;
@@ -556,31 +612,9 @@ private:
             ostr << r;
             return;
         }
-        ostr << "  ";
-        if(!std::isfinite(r)) {
-            ostr << std::setw(width) << std::left << r;
-            return;
-        }
-        bool sci  = r != RL(0.0) && (std::abs(r) < RL(0.1) || std::abs(r) >= RL(1.0e6));
-        int32_t w = width;
-        if(r < RL(0.0)) {
-            ostr << "-";
-            r = -r;
-        } else if(sci || r >= RL(1.0) || r == RL(0.0)) {
-            ostr << " ";
-        }
-        --w;
-        if(sci) --w;
-        ostr << std::setprecision(exp3 ? (w - 6) : (w - 5)); // 5/4 for exp, 1 for decimal
-                                                             // point
-        if(sci) {
-            ostr << std::setiosflags(std::ios_base::uppercase | std::ios_base::scientific)
-                 << std::setw(exp3 ? (w + 1) : w) << std::left << r;
-        } else {
-            ostr << std::setiosflags(std::ios_base::showpoint) << std::defaultfloat
-                 << std::setw(w - 5) << r;
-            ostr << (exp3 ? "     " : "    ");
-        }
+        std::string s;
+        AppendFortranReal(s, r, width, exp3);
+        ostr << s;
     }
 };
 
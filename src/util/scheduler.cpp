@@ -0,0 +1,164 @@
+/*
+bellhopcxx / bellhopcuda - C++/CUDA port of BELLHOP(3D) underwater acoustics simulator
+Copyright (C) 2021-2023 The Regents of the University of California
+Marine Physical Lab at Scripps Oceanography, c/o Jules Jaffe, jjaffe@ucsd.edu
+Based on BELLHOP / BELLHOP3D, which is Copyright (C) 1983-2022 Michael B. Porter
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "../common_setup.hpp"
+
+namespace bhc {
+
+void JobScheduler::Reset(int32_t numJobs_, int32_t numThreads, bool inOrder_)
+{
+    numJobs = bhc::max(numJobs_, 0);
+    inOrder = inOrder_;
+    workers = std::vector<WorkerState>(numThreads);
+    for(int32_t t = 0; t < numThreads; ++t) {
+        WorkerState &w = workers[t];
+        // LP: Initial slices are contiguous so that each thread starts on rays
+        // from the same source with neighboring angles. In order mode, worker
+        // 0's slice is shared by everyone.
+        uint32_t begin = inOrder ? (t == 0 ? 0u : (uint32_t)numJobs)
+                                 : (uint32_t)((int64_t)numJobs * t / numThreads);
+        uint32_t end   = inOrder ? (uint32_t)numJobs
+                                 : (uint32_t)((int64_t)numJobs * (t + 1) / numThreads);
+        w.range.store(Pack(begin, end), std::memory_order_relaxed);
+        w.cur = w.curEnd = w.lastChunkJobs = 0;
+        w.chunkSize                        = 1;
+        w.costPerJob     = -1.0;
+        w.inChunk        = false;
+        w.jobs = w.chunks = w.steals = 0;
+        w.busy = w.finish = 0.0;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    runStart = clock::now();
+}
+
+bool JobScheduler::NextChunk(WorkerState &w)
+{
+    clock::time_point now = clock::now();
+    if(w.inChunk) {
+        double dt = std::chrono::duration<double>(now - w.chunkStart).count();
+        w.busy += dt;
+        double c = dt / (double)w.lastChunkJobs;
+        // Exponential moving average, so the chunk size follows the cost of the
+        // rays currently being traced (e.g. steep vs. shallow angles).
+        w.costPerJob = w.costPerJob < 0.0 ? c : 0.5 * (w.costPerJob + c);
+        double target = TargetChunkTime / bhc::max(w.costPerJob, 1.0e-9);
+        w.chunkSize   = (uint32_t)bhc::max(bhc::min(target, (double)MaxChunkSize), 1.0);
+        w.inChunk     = false;
+    }
+    if(!TakeOwn(w)) {
+        while(true) {
+            if(inOrder) {
+                w.finish = std::chrono::duration<double>(clock::now() - runStart).count();
+                return false;
+            }
+            if(!Steal(w)) {
+                w.finish = std::chrono::duration<double>(clock::now() - runStart).count();
+                return false;
+            }
+            if(TakeOwn(w)) break;
+        }
+    }
+    w.lastChunkJobs = w.curEnd - w.cur;
+    w.jobs += (int32_t)w.lastChunkJobs;
+    ++w.chunks;
+    w.inChunk    = true;
+    w.chunkStart = clock::now();
+    return true;
+}
+
+bool JobScheduler::TakeOwn(WorkerState &w)
+{
+    std::atomic<uint64_t> &range = inOrder ? workers[0].range : w.range;
+    uint64_t r                   = range.load(std::memory_order_acquire);
+    while(true) {
+        uint32_t b = Begin(r), e = End(r);
+        if(b >= e) return false;
+        // Never take more than half of what is left, so that other workers can
+        // still steal from this slice.
+        uint32_t n = inOrder ? 1u : bhc::min(w.chunkSize, bhc::max((e - b) / 2u, 1u));
+        if(range.compare_exchange_weak(
+               r, Pack(b + n, e), std::memory_order_acq_rel,
+               std::memory_order_acquire)) {
+            w.cur    = b;
+            w.curEnd = b + n;
+            return true;
+        }
+    }
+}
+
+bool JobScheduler::Steal(WorkerState &w)
+{
+    while(true) {
+        WorkerState *victim = nullptr;
+        uint64_t vr         = 0;
+        uint32_t mostLeft   = 0;
+        for(WorkerState &v : workers) {
+            if(&v == &w) continue;
+            uint64_t r = v.range.load(std::memory_order_acquire);
+            uint32_t b = Begin(r), e = End(r);
+            if(b < e && e - b > mostLeft) {
+                mostLeft = e - b;
+                victim   = &v;
+                vr       = r;
+            }
+        }
+        if(victim == nullptr) return false;
+        uint32_t b = Begin(vr), e = End(vr);
+        uint32_t mid = e - (e - b + 1u) / 2u;
+        if(victim->range.compare_exchange_strong(
+               vr, Pack(b, mid), std::memory_order_acq_rel, std::memory_order_acquire)) {
+            // LP: Our own slice is empty and thieves never write to an empty
+            // slice, so a plain store is safe here.
+            w.range.store(Pack(mid, e), std::memory_order_release);
+            ++w.steals;
+            return true;
+        }
+        // Lost the race with the owner or another thief, rescan.
+    }
+}
+
+void JobScheduler::Report(
+    bhcInternal *internal, const char *label, RunMetrics *metrics) const
+{
+    if(workers.empty()) return;
+    double end = 0.0;
+    int32_t chunks = 0, steals = 0;
+    for(const WorkerState &w : workers) {
+        end = bhc::max(end, w.finish);
+        chunks += w.chunks;
+        steals += w.steals;
+    }
+    std::stringstream ss;
+    ss << label << " scheduler: " << numJobs << " jobs, " << workers.size()
+       << " threads, " << chunks << " chunks, " << steals
+       << " steals; per thread (jobs/idle ms):";
+    ss << std::fixed << std::setprecision(3);
+    for(size_t t = 0; t < workers.size(); ++t) {
+        const WorkerState &w = workers[t];
+        double idle          = bhc::max((end - w.busy) * 1000.0, 0.0);
+        ss << " " << t << "=" << w.jobs << "/" << idle;
+        if((int32_t)t < metrics->numThreads) {
+            metrics->threads[t].jobs += w.jobs;
+            metrics->threads[t].busyTime += w.busy * 1000.0;
+            metrics->threads[t].idleTime += idle;
+        }
+    }
+    ExternalWarning(internal, "%s", ss.str().c_str());
+}
+
+} // namespace bhc
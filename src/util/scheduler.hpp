@@ -0,0 +1,121 @@
+/*
+bellhopcxx / bellhopcuda - C++/CUDA port of BELLHOP(3D) underwater acoustics simulator
+Copyright (C) 2021-2023 The Regents of the University of California
+Marine Physical Lab at Scripps Oceanography, c/o Jules Jaffe, jjaffe@ucsd.edu
+Based on BELLHOP / BELLHOP3D, which is Copyright (C) 1983-2022 Michael B. Porter
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef _BHC_INCLUDING_COMPONENTS_
+#error "Must be included from common.hpp!"
+#endif
+
+#include <vector>
+
+namespace bhc {
+
+struct bhcInternal;
+
+/**
+ * Hands out ray jobs to the CPU worker threads in chunks, replacing a single
+ * shared job counter which every thread had to increment once per ray.
+ *
+ * Each worker starts out owning a contiguous slice of the job indices. It takes
+ * chunks off the front of its own slice, and when that is empty, steals the
+ * back half of the slice of whichever worker has the most jobs left. The chunk
+ * size is adapted per worker from the measured cost per job, so that cheap rays
+ * are handed out many at a time while expensive (e.g. near-grazing) rays are
+ * handed out one at a time and the tail stays even.
+ *
+ * Each slice is a [begin, end) pair packed into one 64-bit atomic, so taking
+ * and stealing are both a single compare-exchange on a cache line which is
+ * normally only touched by its owner. A given [begin, end) can never reappear
+ * in a slot once jobs have been taken from it, so there is no ABA problem.
+ *
+ * In order mode, all workers instead take single jobs in increasing order from
+ * one shared slice, like a shared job counter. This is for consumers which
+ * need the results roughly in job order, e.g. the streaming ray writer.
+ *
+ * GetNextJob() may only be called by the thread which was given that worker
+ * index.
+ */
+class JobScheduler {
+public:
+    JobScheduler() : numJobs(0), inOrder(false) {}
+
+    /**
+     * Must be called before the worker threads are started.
+     */
+    void Reset(int32_t numJobs_, int32_t numThreads, bool inOrder_ = false);
+
+    /**
+     * Returns false when there are no jobs left to hand out to any worker.
+     */
+    inline bool GetNextJob(int32_t worker, int32_t &job)
+    {
+        WorkerState &w = workers[worker];
+        if(w.cur >= w.curEnd && !NextChunk(w)) return false;
+        job = (int32_t)w.cur++;
+        return true;
+    }
+
+    /**
+     * Prints jobs, chunks, steals, and idle time per thread for the last run,
+     * and adds the jobs and busy and idle times of each thread to metrics.
+     */
+    void Report(bhcInternal *internal, const char *label, RunMetrics *metrics) const;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    // Target wall time for one chunk. Long enough that the overhead of getting
+    // the next chunk is negligible, short enough that the chunk in flight when
+    // the queues run dry does not make the tail ragged.
+    static constexpr double TargetChunkTime = 0.5e-3;
+    static constexpr uint32_t MaxChunkSize  = 4096;
+
+    static inline uint64_t Pack(uint32_t begin, uint32_t end)
+    {
+        return ((uint64_t)begin << 32) | (uint64_t)end;
+    }
+    static inline uint32_t Begin(uint64_t r) { return (uint32_t)(r >> 32); }
+    static inline uint32_t End(uint64_t r) { return (uint32_t)(r & 0xFFFFFFFFu); }
+
+    struct alignas(64) WorkerState {
+        std::atomic<uint64_t> range;
+        // Below only used by the owning thread
+        uint32_t cur, curEnd;
+        uint32_t chunkSize, lastChunkJobs;
+        double costPerJob; // seconds; negative if not yet measured
+        clock::time_point chunkStart;
+        bool inChunk;
+        // Statistics
+        int32_t jobs, chunks, steals;
+        double busy, finish; // seconds since Reset
+
+        WorkerState() : range(0) {}
+    };
+
+    bool NextChunk(WorkerState &w);
+    bool TakeOwn(WorkerState &w);
+    bool Steal(WorkerState &w);
+
+    int32_t numJobs;
+    bool inOrder;
+    clock::time_point runStart;
+    std::vector<WorkerState> workers;
+};
+
+} // namespace bhc
@@ -0,0 +1,102 @@
+/*
+bellhopcxx / bellhopcuda - C++/CUDA port of BELLHOP(3D) underwater acoustics simulator
+Copyright (C) 2021-2023 The Regents of the University of California
+Marine Physical Lab at Scripps Oceanography, c/o Jules Jaffe, jjaffe@ucsd.edu
+Based on BELLHOP / BELLHOP3D, which is Copyright (C) 1983-2022 Michael B. Porter
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "../common_setup.hpp"
+
+namespace bhc {
+
+bool OrderedStreamWriter::Open(const std::string &path, int32_t window_)
+{
+    Close();
+    ostr.open(path, std::ios_base::out | std::ios_base::app | std::ios_base::binary);
+    if(!ostr.good()) return false;
+    next    = 0;
+    window  = bhc::max(window_, 1);
+    closing = aborted = false;
+    writer            = std::thread(&OrderedStreamWriter::WriterThread, this);
+    return true;
+}
+
+void OrderedStreamWriter::Submit(int32_t index, std::string &&text)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    spaceFree.wait(lock, [&] { return aborted || index < next + window; });
+    if(aborted || index < next) return;
+    pending.emplace(index, std::move(text));
+    if(index == next) blockReady.notify_one();
+}
+
+void OrderedStreamWriter::Abort()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        aborted = true;
+        pending.clear();
+    }
+    blockReady.notify_one();
+    spaceFree.notify_all();
+}
+
+bool OrderedStreamWriter::Close()
+{
+    if(!writer.joinable()) return true;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    blockReady.notify_one();
+    writer.join();
+    bool ok = ostr.good() && !aborted;
+    ostr.close();
+    return ok;
+}
+
+void OrderedStreamWriter::WriterThread()
+{
+    std::vector<std::string> blocks;
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            blockReady.wait(lock, [&] {
+                return aborted || closing
+                    || (!pending.empty() && pending.begin()->first == next);
+            });
+            if(aborted) return;
+            if(closing && !pending.empty() && pending.begin()->first != next) {
+                // Nobody is left to fill the gap
+                next = pending.begin()->first;
+            }
+            if(pending.empty()) {
+                if(closing) return;
+                continue;
+            }
+            // LP: Take every block which is ready, so that the lock is not held
+            // during the (slow) file writes.
+            while(!pending.empty() && pending.begin()->first == next) {
+                blocks.push_back(std::move(pending.begin()->second));
+                pending.erase(pending.begin());
+                ++next;
+            }
+        }
+        spaceFree.notify_all();
+        for(const std::string &b : blocks) ostr.write(b.data(), b.size());
+        blocks.clear();
+    }
+}
+
+} // namespace bhc
@@ -0,0 +1,86 @@
+/*
+bellhopcxx / bellhopcuda - C++/CUDA port of BELLHOP(3D) underwater acoustics simulator
+Copyright (C) 2021-2023 The Regents of the University of California
+Marine Physical Lab at Scripps Oceanography, c/o Jules Jaffe, jjaffe@ucsd.edu
+Based on BELLHOP / BELLHOP3D, which is Copyright (C) 1983-2022 Michael B. Porter
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef _BHC_INCLUDING_COMPONENTS_
+#error "Must be included from common_setup.hpp!"
+#endif
+
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace bhc {
+
+/**
+ * Writes blocks of text, produced out of order by the worker threads, to a file
+ * in order of their index, on a dedicated writer thread. This lets the output
+ * be formatted in parallel and written while the run continues.
+ *
+ * At most window blocks are held at once: Submit() blocks while its index is
+ * window or more ahead of the next block to be written. Indices must be handed
+ * out to the producers in increasing order (see JobScheduler in order mode),
+ * otherwise the producer of the next block could be waiting for space itself.
+ * Each index may be submitted at most once; if a producer fails and will never
+ * submit an index, call Abort().
+ */
+class OrderedStreamWriter {
+public:
+    OrderedStreamWriter() : next(0), window(1), closing(false), aborted(false) {}
+    ~OrderedStreamWriter() { Close(); }
+
+    /**
+     * Opens path for appending and starts the writer thread. Returns false if
+     * the file could not be opened.
+     */
+    bool Open(const std::string &path, int32_t window_);
+
+    /**
+     * Queues text as block index. Thread-safe.
+     */
+    void Submit(int32_t index, std::string &&text);
+
+    /**
+     * Discards everything not yet written and stops blocking Submit(). Any
+     * later submissions are discarded.
+     */
+    void Abort();
+
+    /**
+     * Writes all remaining blocks in order, skipping indices which were never
+     * submitted, then closes the file. Returns false if there was a write error
+     * or the writer was aborted, i.e. if the file is incomplete.
+     */
+    bool Close();
+
+private:
+    void WriterThread();
+
+    std::ofstream ostr;
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable blockReady, spaceFree;
+    std::map<int32_t, std::string> pending;
+    int32_t next, window;
+    bool closing, aborted;
+};
+
+} // namespace bhc
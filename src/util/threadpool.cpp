@@ -0,0 +1,125 @@
+/*
+bellhopcxx / bellhopcuda - C++/CUDA port of BELLHOP(3D) underwater acoustics simulator
+Copyright (C) 2021-2023 The Regents of the University of California
+Marine Physical Lab at Scripps Oceanography, c/o Jules Jaffe, jjaffe@ucsd.edu
+Based on BELLHOP / BELLHOP3D, which is Copyright (C) 1983-2022 Michael B. Porter
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "../common_setup.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace bhc {
+
+// LP: The pool the current thread is a worker of, if any.
+static thread_local const bhcThreadPool *currentPool = nullptr;
+
+void bhcThreadPool::Start(int32_t numThreads_, bool pinThreads)
+{
+    Stop();
+    numThreads = bhc::max(numThreads_, 1);
+    stopping   = false;
+    for(int32_t i = 0; i < numThreads; ++i) {
+        threads.push_back(std::thread(&bhcThreadPool::WorkerThread, this, i, pinThreads));
+    }
+}
+
+void bhcThreadPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskReady.notify_all();
+    for(auto &t : threads) t.join();
+    threads.clear();
+    numThreads = 0;
+}
+
+void bhcThreadPool::Run(int32_t n, const std::function<void(int32_t)> &func)
+{
+    n = bhc::min(n, numThreads);
+    if(n <= 0) return;
+    if(n == 1 || currentPool == this) {
+        // LP: No need to wake a worker for one function. And if this is a
+        // function already running on this pool (e.g. a batch scenario),
+        // waiting for the other workers could deadlock, so run the workers'
+        // functions one after the other instead. All users hand out their
+        // work dynamically or in fixed ranges, so this is still correct.
+        for(int32_t i = 0; i < n; ++i) func(i);
+        return;
+    }
+    std::lock_guard<std::mutex> runLock(runMutex);
+    std::exception_ptr err;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        task        = &func;
+        taskThreads = n;
+        remaining   = n;
+        error       = nullptr;
+        ++generation;
+        taskReady.notify_all();
+        taskDone.wait(lock, [this] { return remaining == 0; });
+        task = nullptr;
+        err  = error;
+    }
+    if(err) std::rethrow_exception(err);
+}
+
+void bhcThreadPool::WorkerThread(int32_t worker, bool pin)
+{
+    if(pin) {
+        uint32_t ncores = bhc::max(std::thread::hardware_concurrency(), 1u);
+#ifdef __linux__
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(worker % ncores, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus);
+#elif defined(_MSC_VER)
+        SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << (worker % ncores % 64));
+#else
+        (void)ncores; // LP: Not supported on this platform, ignored.
+#endif
+    }
+    SetupThread();
+    currentPool   = this;
+    uint64_t seen = 0;
+    while(true) {
+        const std::function<void(int32_t)> *func;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskReady.wait(lock, [&] { return stopping || generation != seen; });
+            if(stopping) return;
+            seen = generation;
+            if(worker >= taskThreads) continue;
+            func = task;
+        }
+        std::exception_ptr err;
+        try {
+            (*func)(worker);
+        } catch(...) {
+            err = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(err && !error) error = err;
+            if(--remaining == 0) taskDone.notify_one();
+        }
+    }
+}
+
+} // namespace bhc
@@ -0,0 +1,87 @@
+/*
+bellhopcxx / bellhopcuda - C++/CUDA port of BELLHOP(3D) underwater acoustics simulator
+Copyright (C) 2021-2023 The Regents of the University of California
+Marine Physical Lab at Scripps Oceanography, c/o Jules Jaffe, jjaffe@ucsd.edu
+Based on BELLHOP / BELLHOP3D, which is Copyright (C) 1983-2022 Michael B. Porter
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef _BHC_INCLUDING_COMPONENTS_
+#error "Must be included from common.hpp!"
+#endif
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bhc {
+
+/**
+ * Persistent worker threads which are parked between runs, so that a run does
+ * not pay for creating and joining its threads (and SetupThread()) every time.
+ * Owned by bhcInternal (created in setup(), destroyed in finalize()), or
+ * created with create_thread_pool() and shared by several instances.
+ *
+ * Run() hands one function to the first n workers and blocks until all of them
+ * have returned. Calls to Run() from different threads (e.g. instances sharing
+ * the pool) are serialized. With n == 1, or when called from a function which
+ * is itself running on this pool, the function is simply called for each
+ * worker index in turn on the calling thread.
+ */
+struct bhcThreadPool {
+public:
+    bhcThreadPool() : numThreads(0), generation(0), taskThreads(0), remaining(0),
+        stopping(false), task(nullptr) {}
+    ~bhcThreadPool() { Stop(); }
+
+    /**
+     * Starts numThreads_ workers. If pinThreads, worker i is bound to logical
+     * core i (modulo the number of cores), where the platform supports this.
+     */
+    void Start(int32_t numThreads_, bool pinThreads);
+
+    /**
+     * Joins all workers. Must not be called while a Run() is in progress.
+     */
+    void Stop();
+
+    int32_t NumThreads() const { return numThreads; }
+
+    /**
+     * Calls func(worker) for worker = 0 to n-1 on the pool threads and waits
+     * for all of them. n is limited to NumThreads(). An exception thrown by
+     * func is rethrown here (the first one, if several workers throw).
+     */
+    void Run(int32_t n, const std::function<void(int32_t)> &func);
+
+private:
+    void WorkerThread(int32_t worker, bool pin);
+
+    int32_t numThreads;
+    std::vector<std::thread> threads;
+    std::mutex runMutex; // Held for the duration of Run()
+    std::mutex mutex;    // Protects everything below
+    std::condition_variable taskReady, taskDone;
+    uint64_t generation;
+    int32_t taskThreads, remaining;
+    bool stopping;
+    const std::function<void(int32_t)> *task;
+    std::exception_ptr error;
+};
+
+} // namespace bhc
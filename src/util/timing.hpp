@@ -43,13 +43,17 @@ class Stopwatch {
 public:
     Stopwatch(bhcInternal *internal_) : internal(internal_) {}
     inline void tick() { tstart = std::chrono::high_resolution_clock::now(); }
-    inline void tock(const char *label)
+    /**
+     * Prints and returns the time in ms since tick().
+     */
+    inline double tock(const char *label)
     {
         using namespace std::chrono;
         high_resolution_clock::time_point tend = high_resolution_clock::now();
         double dt = (duration_cast<duration<double>>(tend - tstart)).count();
         dt *= 1000.0;
         ExternalWarning(internal, "%s: %f ms", label, dt);
+        return dt;
     }
 
 private: